@@ -0,0 +1,29 @@
+import express from 'express';
+import { decode } from '@msgpack/msgpack';
+
+const rawMsgPack = express.raw({ type: 'application/msgpack', limit: '1mb' });
+
+// Decode MessagePack request bodies (ESP32 built with UPLINK_MSGPACK) into req.body,
+// so routes see the same object they would get from the JSON encoding
+export const msgpackBody = (req, res, next) => {
+  if (!req.is('application/msgpack')) {
+    return next();
+  }
+
+  rawMsgPack(req, res, (err) => {
+    if (err) {
+      return next(err);
+    }
+
+    try {
+      req.body = Buffer.isBuffer(req.body) && req.body.length > 0 ? decode(req.body) : {};
+      next();
+    } catch (error) {
+      return res.status(400).json({
+        success: false,
+        message: 'Invalid MessagePack body',
+        error: error.message
+      });
+    }
+  });
+};
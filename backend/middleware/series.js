@@ -0,0 +1,174 @@
+import express from 'express';
+
+// Columnar reading batches from ESP32 firmware built with UPLINK_SERIES.
+// JavaScript port of the decoder in esp32-storage/lib/series_codec (see series_codec.h for the layout)
+export const SERIES_CONTENT_TYPE = 'application/x-harvesthub-series';
+
+const SERIES_VERSION = 1;
+const SERIES_STATUS_ONLY = 0x02;
+const TIME_NONE = 0;
+const TIME_EPOCH = 1;
+const TIME_AGE = 2;
+const CHANNEL_KEYS = ['temperature', 'humidity', 'CO2', 'ammonia', 'methane', 'ethylene', 'H2S'];
+const STATUS_NAMES = [undefined, 'normal', 'warning', 'critical'];
+
+const rawSeries = express.raw({ type: SERIES_CONTENT_TYPE, limit: '1mb' });
+
+class BitReader {
+  constructor(buffer, offset) {
+    this.buffer = buffer;
+    this.position = offset * 8;
+    this.length = buffer.length * 8;
+  }
+
+  // Up to 32 bits as a Number
+  read(bits) {
+    if (this.position + bits > this.length) {
+      throw new Error('Series batch is truncated');
+    }
+    let value = 0;
+    while (bits > 0) {
+      const left = 8 - (this.position & 7);
+      const take = Math.min(bits, left);
+      const chunk = (this.buffer[this.position >> 3] >> (left - take)) & ((1 << take) - 1);
+      value = value * (1 << take) + chunk;
+      this.position += take;
+      bits -= take;
+    }
+    return value;
+  }
+
+  read64() {
+    const high = BigInt(this.read(32));
+    return (high << 32n) | BigInt(this.read(32));
+  }
+}
+
+const unzigzag = (value) => BigInt.asIntN(64, (value >> 1n) ^ -(value & 1n));
+
+const deltaColumn = () => ({ previous: 0n, previousDelta: 0n });
+
+// Delta-of-delta, bucketed: '0', '10'+7, '110'+10, '1110'+13, '1111'+64
+const readDelta = (bits, column, first) => {
+  if (first) {
+    column.previous = BigInt.asIntN(64, bits.read64());
+    column.previousDelta = 0n;
+    return column.previous;
+  }
+  let encoded = 0n;
+  if (bits.read(1)) {
+    if (!bits.read(1)) encoded = BigInt(bits.read(7));
+    else if (!bits.read(1)) encoded = BigInt(bits.read(10));
+    else if (!bits.read(1)) encoded = BigInt(bits.read(13));
+    else encoded = bits.read64();
+  }
+  column.previousDelta = BigInt.asIntN(64, column.previousDelta + unzigzag(encoded));
+  column.previous = BigInt.asIntN(64, column.previous + column.previousDelta);
+  return column.previous;
+};
+
+const readSmall = (bits, column, width) => {
+  if (bits.read(1)) {
+    column.previous = bits.read(width);
+  }
+  return column.previous;
+};
+
+// XOR with the previous value: '0' same, '10' previous window, '11' + leading:5 + (length - 1):5
+const floatView = new DataView(new ArrayBuffer(4));
+const readFloat = (bits, column) => {
+  if (bits.read(1)) {
+    if (bits.read(1)) {
+      const leading = bits.read(5);
+      const length = bits.read(5) + 1;
+      if (leading + length > 32) {
+        throw new Error('Series batch is corrupt');
+      }
+      column.leading = leading;
+      column.trailing = 32 - leading - length;
+    }
+    const length = 32 - column.leading - column.trailing;
+    column.previous = (column.previous ^ (bits.read(length) << column.trailing)) >>> 0;
+  }
+  floatView.setUint32(0, column.previous);
+  const value = floatView.getFloat32(0);
+  // float32 carries ~7 significant digits; NaN becomes null as in the JSON encoding
+  return Number.isNaN(value) ? null : Number(value.toPrecision(7));
+};
+
+// Decodes a batch into the object the JSON encoding would have produced
+export const decodeSeries = (buffer) => {
+  if (buffer.length < 8 || buffer[0] !== 0x48 || buffer[1] !== 0x53 || buffer[2] !== SERIES_VERSION || buffer[3] > TIME_AGE) {
+    throw new Error('Not a series batch');
+  }
+  const timeMode = buffer[3];
+  const count = buffer.readUInt16LE(4);
+
+  let offset = 6;
+  const ids = [];
+  for (let i = 0; i < 2; i++) {
+    const length = buffer[offset];
+    if (length === undefined || offset + 1 + length > buffer.length) {
+      throw new Error('Series batch is truncated');
+    }
+    ids.push(buffer.toString('utf8', offset + 1, offset + 1 + length));
+    offset += 1 + length;
+  }
+
+  const bits = new BitReader(buffer, offset);
+  const time = deltaColumn();
+  const sequence = deltaColumn();
+  const suppressed = { previous: 0 };
+  const state = { previous: 0 };
+  const channels = CHANNEL_KEYS.map(() => ({ previous: 0, leading: 0, trailing: 0 }));
+
+  const readings = [];
+  for (let row = 0; row < count; row++) {
+    const item = {};
+    if (timeMode !== TIME_NONE) {
+      const timeMs = Number(readDelta(bits, time, row === 0));
+      if (timeMode === TIME_EPOCH && timeMs !== 0) item.ts = timeMs;
+      if (timeMode === TIME_AGE) item.ageMs = timeMs;
+    }
+    item.seq = Number(readDelta(bits, sequence, row === 0));
+
+    const held = readSmall(bits, suppressed, 16);
+    if (held > 0) item.suppressed = held;
+    const both = readSmall(bits, state, 16);
+    const status = STATUS_NAMES[both & 0xFF];
+    if (status) item.status = status;
+
+    if (!((both >> 8) & SERIES_STATUS_ONLY)) {
+      CHANNEL_KEYS.forEach((key, i) => {
+        item[key] = readFloat(bits, channels[i]);
+      });
+    }
+    readings.push(item);
+  }
+
+  return { farmerId: ids[0] || undefined, deviceId: ids[1] || undefined, readings };
+};
+
+// Decode series request bodies into req.body, like msgpackBody does for MessagePack
+export const seriesBody = (req, res, next) => {
+  if (!req.is(SERIES_CONTENT_TYPE)) {
+    return next();
+  }
+
+  rawSeries(req, res, (err) => {
+    if (err) {
+      return next(err);
+    }
+
+    try {
+      req.body = Buffer.isBuffer(req.body) && req.body.length > 0 ? decodeSeries(req.body) : {};
+      next();
+    } catch (error) {
+      return res.status(400).json({
+        success: false,
+        message: 'Invalid series body',
+        error: error.message
+      });
+    }
+  });
+};
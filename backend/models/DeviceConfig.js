@@ -0,0 +1,74 @@
+import mongoose from 'mongoose';
+
+// Runtime tuning pulled by ESP32 storage monitors; deviceId '*' holds the fleet-wide defaults
+// Unset fields fall back to the fleet document, then to the values compiled into the firmware
+const deviceConfigSchema = new mongoose.Schema({
+  deviceId: {
+    type: String,
+    required: true,
+    unique: true
+  },
+  // Farmer the device belongs to, the only one besides an admin who may tune it
+  farmerId: {
+    type: mongoose.Schema.Types.ObjectId,
+    ref: 'User'
+  },
+  minIntervalMs: {
+    type: Number,
+    min: 1000,
+    max: 3600000
+  },
+  maxIntervalMs: {
+    type: Number,
+    min: 1000,
+    max: 3600000
+  },
+  uplinkSamples: {
+    type: Number,
+    min: 1,
+    max: 100
+  },
+  pollIntervalMs: {
+    type: Number,
+    min: 60000,
+    max: 86400000
+  },
+  cropProfile: {
+    type: String,
+    enum: ['default', 'potato', 'onion', 'tomato', 'grain']
+  },
+  // MQ135 resistance in clean air, kOhm
+  r0: {
+    type: Number,
+    min: 0.1,
+    max: 9999
+  },
+  backendHost: {
+    type: String,
+    match: /^[A-Za-z0-9.-]{1,63}$/
+  },
+  backendPort: {
+    type: Number,
+    min: 1,
+    max: 65535
+  },
+  // Release the device should run; it fetches /api/storage/firmware/<its version>/<this> when they differ
+  firmwareVersion: {
+    type: String,
+    match: /^[A-Za-z0-9._-]{1,23}$/
+  }
+}, {
+  timestamps: true
+});
+
+export const DEVICE_CONFIG_FIELDS = [
+  'minIntervalMs', 'maxIntervalMs', 'uplinkSamples', 'pollIntervalMs',
+  'cropProfile', 'r0', 'backendHost', 'backendPort', 'firmwareVersion'
+];
+
+// Point devices at another server or into an update, so only an admin may set them
+export const ADMIN_CONFIG_FIELDS = ['backendHost', 'backendPort', 'firmwareVersion'];
+
+export const FLEET_CONFIG_ID = '*';
+
+export default mongoose.model('DeviceConfig', deviceConfigSchema);
@@ -0,0 +1,53 @@
+import mongoose from 'mongoose';
+
+// min/max/mean/stddev of one sensor channel over a window
+const channelSummarySchema = new mongoose.Schema({
+  min: Number,
+  max: Number,
+  mean: Number,
+  stddev: Number
+}, { _id: false });
+
+// One device-side aggregation window: replaces the raw readings it covers
+const storageAggregateSchema = new mongoose.Schema({
+  farmerId: {
+    type: mongoose.Schema.Types.ObjectId,
+    ref: 'User',
+    required: false
+  },
+  deviceId: {
+    type: String,
+    required: true
+  },
+  windowStart: {
+    type: Date,
+    required: true
+  },
+  durationMs: {
+    type: Number,
+    required: true,
+    min: 1
+  },
+  sampleCount: {
+    type: Number,
+    required: true,
+    min: 1
+  },
+  temperature: channelSummarySchema,
+  humidity: channelSummarySchema,
+  co2: channelSummarySchema,
+  ammonia: channelSummarySchema,
+  methane: channelSummarySchema,
+  ethylene: channelSummarySchema,
+  h2s: channelSummarySchema
+}, {
+  timestamps: true
+});
+
+// History queries are per device and window length, newest first
+storageAggregateSchema.index({ deviceId: 1, durationMs: 1, windowStart: -1 });
+
+// Aggregates are the long-term history: kept for a year, raw readings for 90 days
+storageAggregateSchema.index({ createdAt: 1 }, { expireAfterSeconds: 31536000 });
+
+export default mongoose.model('StorageAggregate', storageAggregateSchema);
@@ -9,7 +9,11 @@ const storageAlertSchema = new mongoose.Schema({
   cropId: {
     type: mongoose.Schema.Types.ObjectId,
     ref: 'Crop',
-    required: true
+    required: false  // Alerts raised by a device do not know the crop
+  },
+  deviceId: {
+    type: String,
+    index: true
   },
   farmerId: {
     type: mongoose.Schema.Types.ObjectId,
@@ -40,6 +44,13 @@ const storageAlertSchema = new mongoose.Schema({
     humidity: Number,
     gasLevels: Object
   },
+  // Device alerts: the gas channels that tripped and the readings leading up to it
+  channels: [String],
+  window: [{
+    _id: false,
+    timestamp: Date,
+    gasLevels: Object
+  }],
   recommendedAction: {
     type: String,
     default: ''
@@ -55,6 +55,32 @@ const storageReadingSchema = new mongoose.Schema({
     enum: ['normal', 'warning', 'critical', 'offline'],
     default: 'normal'
   },
+  // Samples the device held back since the previous stored reading
+  // because nothing needed sending (covered by its aggregates)
+  suppressedSamples: {
+    type: Number,
+    default: 0,
+    min: 0
+  },
+  // Latest status-only heartbeat confirming this reading's status still holds
+  lastSeenAt: {
+    type: Date,
+    default: null
+  },
+  // Every probe of a room with several sensors, kept on the device's newest reading;
+  // temperature/humidity above are their mean and the gas levels the worst probe
+  probes: {
+    type: [{
+      _id: false,
+      name: String,
+      temperature: Number,
+      humidity: Number,
+      co2: Number,
+      ethylene: Number,
+      readAt: Date
+    }],
+    default: undefined
+  },
   timestamp: {
     type: Date,
     default: Date.now
@@ -63,6 +89,9 @@ const storageReadingSchema = new mongoose.Schema({
   timestamps: true
 });
 
+// Heartbeats update the latest reading of a device
+storageReadingSchema.index({ deviceId: 1, timestamp: -1 });
+
 // Auto-delete readings older than 90 days
 storageReadingSchema.index({ createdAt: 1 }, { expireAfterSeconds: 7776000 });
 
@@ -22,6 +22,8 @@ import CropQuality from './models/CropQuality.js';
 import PricePrediction from './models/PricePrediction.js';
 import StorageReading from './models/StorageReading.js';
 import StorageAlert from './models/StorageAlert.js';
+import StorageAggregate from './models/StorageAggregate.js';
+import DeviceConfig, { DEVICE_CONFIG_FIELDS, ADMIN_CONFIG_FIELDS, FLEET_CONFIG_ID } from './models/DeviceConfig.js';
 import Notification from './models/Notification.js';
 import ApiLog from './models/ApiLog.js';
 import Analytics from './models/Analytics.js';
@@ -30,6 +32,8 @@ import fs from 'fs';
 // Import Routes
 import authRoutes from './routes/auth.js';
 import { authenticate, authorize, optionalAuth, optionalAuthorize } from './middleware/auth.js';
+import { msgpackBody } from './middleware/msgpack.js';
+import { seriesBody } from './middleware/series.js';
 import buyerRoutes from './routes/buyer.js';
 import messagesRoutes from './routes/messages.js';
 import wishlistRoutes from './routes/wishlist.js';
@@ -82,6 +86,8 @@ mongoose.connect(MONGODB_URI, {
 // Middleware
 app.use(cors());
 app.use(express.json());
+app.use(msgpackBody);
+app.use(seriesBody);
 app.use('/uploads', express.static('uploads'));
 
 // Create uploads directory if it doesn't exist
@@ -516,20 +522,49 @@ app.get('/api/farmers/by-crop/:cropName', async (req, res) => {
 
 // ==================== ESP32 STORAGE MONITORING ROUTES ====================
 
+const DEVICE_STATUSES = ['normal', 'warning', 'critical'];
+
+// Builds a StorageReading from the fields an ESP32 sends for one sample
+const buildEsp32Reading = ({ farmerId, temperature, humidity, CO2, ethylene, deviceId, suppressed, status }, timestamp) => {
+  const reading = new StorageReading({
+    farmerId: farmerId || '507f1f77bcf86cd799439011',
+    cropId: null, // Can be updated later when linked to specific crop
+    batchId: `batch_${Date.now()}`,
+    deviceId: deviceId || 'ESP32_001',
+    temperature,
+    humidity,
+    gasLevel: {
+      co2: CO2 || 0,
+      ethylene: ethylene || 0,
+      o2: 21.0 // Default atmospheric oxygen
+    },
+    location: 'Storage Unit',
+    status: 'normal',
+    suppressedSamples: Number(suppressed) || 0,
+    timestamp
+  });
+
+  // The device classifies with its crop profile and hysteresis; only older firmware leaves it to us
+  if (DEVICE_STATUSES.includes(status)) {
+    reading.status = status;
+    return reading;
+  }
+
+  // Determine status based on thresholds
+  if (temperature > 30 || temperature < 0) reading.status = 'critical';
+  else if (temperature > 25 || temperature < 5) reading.status = 'warning';
+  
+  if (humidity > 85 || humidity < 30) {
+    reading.status = reading.status === 'critical' ? 'critical' : 'warning';
+  }
+
+  return reading;
+};
+
 // API Endpoint: Receive sensor data from ESP32
 app.post('/api/storage/readings', async (req, res) => {
   try {
-    const { 
-      farmerId, 
-      temperature, 
-      humidity, 
-      CO2, 
-      ammonia, 
-      methane, 
-      ethylene, 
-      H2S,
-      deviceId 
-    } = req.body;
+    const { temperature, humidity, CO2 } = req.body;
 
     console.log('📡 Received ESP32 data:', { temperature, humidity, CO2 });
 
@@ -542,30 +577,7 @@ app.post('/api/storage/readings', async (req, res) => {
     }
 
     // Create storage reading
-    const reading = new StorageReading({
-      farmerId: farmerId || '507f1f77bcf86cd799439011',
-      cropId: null, // Can be updated later when linked to specific crop
-      batchId: `batch_${Date.now()}`,
-      deviceId: deviceId || 'ESP32_001',
-      temperature,
-      humidity,
-      gasLevel: {
-        co2: CO2 || 0,
-        ethylene: ethylene || 0,
-        o2: 21.0 // Default atmospheric oxygen
-      },
-      location: 'Storage Unit',
-      status: 'normal',
-      timestamp: new Date()
-    });
-
-    // Determine status based on thresholds
-    if (temperature > 30 || temperature < 0) reading.status = 'critical';
-    else if (temperature > 25 || temperature < 5) reading.status = 'warning';
-    
-    if (humidity > 85 || humidity < 30) {
-      reading.status = reading.status === 'critical' ? 'critical' : 'warning';
-    }
+    const reading = buildEsp32Reading(req.body, new Date());
 
     await reading.save();
 
@@ -601,6 +613,229 @@ app.post('/api/storage/readings', async (req, res) => {
   }
 });
 
+// Device timestamps outside this window come from an unsynced or broken clock
+const MIN_DEVICE_EPOCH_MS = Date.UTC(2024, 0, 1);
+const MAX_DEVICE_CLOCK_AHEAD_MS = 60 * 1000;
+
+// Probe columns as sent by a device with several sensors: one array per field, null where a probe has no value
+const MAX_PROBES = 16;
+const buildProbes = (columns, receivedAt) => {
+  if (!columns || !Array.isArray(columns.name)) {
+    return [];
+  }
+  const at = (column, i) => (Array.isArray(column) && typeof column[i] === 'number' ? column[i] : undefined);
+  return columns.name.slice(0, MAX_PROBES).map((name, i) => {
+    const age = at(columns.ageMs, i);
+    return {
+      name: String(name),
+      temperature: at(columns.temperature, i),
+      humidity: at(columns.humidity, i),
+      co2: at(columns.CO2, i),
+      ethylene: at(columns.ethylene, i),
+      readAt: age !== undefined ? new Date(receivedAt - age) : null
+    };
+  });
+};
+
+// API Endpoint: Receive a batch of buffered sensor readings from ESP32
+// Body: { farmerId, deviceId, readings: [{ seq, ts, ageMs, suppressed, status, temperature, humidity, CO2, ... }],
+//         probes: { name: [...], ageMs: [...], temperature: [...], humidity: [...], CO2: [...], ... } }
+// Items with a status but no values are heartbeats: nothing changed since the last full reading
+app.post('/api/storage/readings/batch', async (req, res) => {
+  try {
+    const { farmerId, deviceId, readings } = req.body;
+
+    if (!Array.isArray(readings) || readings.length === 0) {
+      return res.status(400).json({
+        success: false,
+        message: 'readings must be a non-empty array'
+      });
+    }
+
+    if (readings.length > 500) {
+      return res.status(413).json({
+        success: false,
+        message: 'A batch may contain at most 500 readings'
+      });
+    }
+
+    // ts is the SNTP-disciplined capture time; without it (clock not synced yet)
+    // ageMs is how long the device held the reading, so the capture time survives buffering
+    const receivedAt = Date.now();
+    const capturedAt = (item) => {
+      const ts = Number(item.ts);
+      if (ts > MIN_DEVICE_EPOCH_MS && ts < receivedAt + MAX_DEVICE_CLOCK_AHEAD_MS) {
+        return new Date(ts);
+      }
+      return new Date(receivedAt - (Number(item.ageMs) || 0));
+    };
+    const docs = readings
+      .filter(item => item && item.temperature !== undefined && item.humidity !== undefined)
+      .map(item => buildEsp32Reading({ ...item, farmerId, deviceId }, capturedAt(item)));
+    const heartbeats = readings
+      .filter(item => item && item.temperature === undefined && DEVICE_STATUSES.includes(item.status));
+
+    // One round trip for the whole batch; invalid readings are skipped, not fatal
+    const inserted = docs.length > 0
+      ? await StorageReading.insertMany(docs, { ordered: false })
+      : [];
+
+    // Heartbeats only touch the device's latest reading: when it was last confirmed and how many samples it stands for
+    if (heartbeats.length > 0) {
+      const lastSeen = heartbeats.map(capturedAt).reduce((a, b) => (a > b ? a : b));
+      const represented = heartbeats.reduce((sum, item) => sum + (Number(item.suppressed) || 0) + 1, 0);
+      await StorageReading.findOneAndUpdate(
+        { deviceId: deviceId || 'ESP32_001' },
+        { $max: { lastSeenAt: lastSeen }, $inc: { suppressedSamples: represented } },
+        { sort: { timestamp: -1 } }
+      );
+    }
+
+    // The probe columns come once per batch and describe the room now, whatever the batch holds
+    const probes = buildProbes(req.body.probes, receivedAt);
+    if (probes.length > 0) {
+      await StorageReading.findOneAndUpdate(
+        { deviceId: deviceId || 'ESP32_001' },
+        { $set: { probes } },
+        { sort: { timestamp: -1 } }
+      );
+    }
+
+    console.log(`📡 Received ESP32 batch from ${deviceId}: ${inserted.length}/${readings.length} stored, ${heartbeats.length} heartbeats`);
+
+    res.status(201).json({
+      success: true,
+      message: 'Sensor batch received',
+      data: {
+        received: readings.length,
+        stored: inserted.length,
+        heartbeats: heartbeats.length,
+        rejected: readings.length - inserted.length - heartbeats.length
+      }
+    });
+  } catch (error) {
+    console.error('❌ Error saving storage batch:', error);
+    res.status(500).json({
+      success: false,
+      message: 'Failed to save sensor batch'
+    });
+  }
+});
+
+// Channel names as sent by the ESP32 (same keys as a reading) -> StorageAggregate fields
+const AGGREGATE_CHANNELS = {
+  temperature: 'temperature',
+  humidity: 'humidity',
+  CO2: 'co2',
+  ammonia: 'ammonia',
+  methane: 'methane',
+  ethylene: 'ethylene',
+  H2S: 'h2s'
+};
+
+// [min, max, mean, stddev] -> { min, max, mean, stddev }, anything else is dropped
+const parseChannelSummary = (value) => {
+  if (!Array.isArray(value) || value.length !== 4 || !value.every(Number.isFinite)) {
+    return undefined;
+  }
+  const [min, max, mean, stddev] = value;
+  return { min, max, mean, stddev };
+};
+
+// API Endpoint: Receive per-window aggregates from ESP32
+// Body: { farmerId, deviceId, aggregates: [{ ts, ageMs, durationMs, count, temperature: [min, max, mean, sd], ... }] }
+app.post('/api/storage/aggregates/batch', async (req, res) => {
+  try {
+    const { farmerId, deviceId, aggregates } = req.body;
+
+    if (!deviceId || !Array.isArray(aggregates) || aggregates.length === 0) {
+      return res.status(400).json({
+        success: false,
+        message: 'deviceId and a non-empty aggregates array are required'
+      });
+    }
+
+    if (aggregates.length > 500) {
+      return res.status(413).json({
+        success: false,
+        message: 'A batch may contain at most 500 aggregates'
+      });
+    }
+
+    // Window start: device epoch time when synced, otherwise reconstructed from its age
+    const receivedAt = Date.now();
+    const docs = aggregates
+      .filter(item => item && Number(item.durationMs) > 0 && Number(item.count) > 0)
+      .map(item => {
+        const ts = Number(item.ts);
+        const windowStart = ts > MIN_DEVICE_EPOCH_MS && ts < receivedAt + MAX_DEVICE_CLOCK_AHEAD_MS
+          ? new Date(ts)
+          : new Date(receivedAt - (Number(item.ageMs) || 0));
+
+        const doc = {
+          farmerId: farmerId || '507f1f77bcf86cd799439011',
+          deviceId,
+          windowStart,
+          durationMs: Number(item.durationMs),
+          sampleCount: Number(item.count)
+        };
+        for (const [key, field] of Object.entries(AGGREGATE_CHANNELS)) {
+          doc[field] = parseChannelSummary(item[key]);
+        }
+        return doc;
+      });
+
+    const inserted = docs.length > 0
+      ? await StorageAggregate.insertMany(docs, { ordered: false })
+      : [];
+
+    console.log(`📊 Received ESP32 aggregates from ${deviceId}: ${inserted.length}/${aggregates.length} stored`);
+
+    res.status(201).json({
+      success: true,
+      message: 'Aggregates received',
+      data: {
+        received: aggregates.length,
+        stored: inserted.length,
+        rejected: aggregates.length - inserted.length
+      }
+    });
+  } catch (error) {
+    console.error('❌ Error saving storage aggregates:', error);
+    res.status(500).json({
+      success: false,
+      message: 'Failed to save aggregates'
+    });
+  }
+});
+
+// API Endpoint: Get aggregate history for a device, e.g. ?durationMs=900000&limit=96
+app.get('/api/storage/aggregates/:deviceId', async (req, res) => {
+  try {
+    const filter = { deviceId: req.params.deviceId };
+    if (req.query.durationMs) {
+      filter.durationMs = Number(req.query.durationMs);
+    }
+    const limit = Math.min(Number(req.query.limit) || 96, 1000);
+
+    const aggregates = await StorageAggregate.find(filter)
+      .sort({ windowStart: -1 })
+      .limit(limit);
+
+    res.json({
+      success: true,
+      data: aggregates,
+      count: aggregates.length
+    });
+  } catch (error) {
+    console.error('❌ Error:', error);
+    res.status(500).json({
+      success: false,
+      message: 'Failed to fetch storage aggregates'
+    });
+  }
+});
+
 // API Endpoint: Get latest storage readings for a farmer
 app.get('/api/storage/readings/:farmerId', async (req, res) => {
   try {
@@ -624,6 +859,95 @@ app.get('/api/storage/readings/:farmerId', async (req, res) => {
   }
 });
 
+const DEVICE_ALERT_TYPES = ['gas', 'spoilage_risk'];
+const DEVICE_ALERT_SEVERITIES = ['critical', 'warning', 'info'];
+
+// A device's owner is the farmer on its config, or until it has one the farmer of its newest stored reading
+const findDeviceOwner = async (deviceId) => {
+  const config = await DeviceConfig.findOne({ deviceId }).select('farmerId').lean();
+  if (config?.farmerId) {
+    return String(config.farmerId);
+  }
+  const latest = await StorageReading.findOne({ deviceId })
+    .sort({ timestamp: -1 })
+    .select('farmerId')
+    .lean();
+  return latest?.farmerId ? String(latest.farmerId) : null;
+};
+
+// API Endpoint: Receive an alert raised by the ESP32 detectors, sent as soon as they trip
+// Body: { farmerId, deviceId, alertType, severity, message, channels, threshold, currentReadings, ts, ageMs, window: [{ ageMs, CO2, ... }] }
+// Only accepted from a known device, for the farmer who owns it
+// Requests without a deviceId fall through to the authenticated storage router
+app.post('/api/storage/alerts', async (req, res, next) => {
+  const { deviceId } = req.body;
+  if (!deviceId) {
+    return next();
+  }
+
+  try {
+    const { farmerId, alertType, severity, message, channels, threshold, currentReadings, ts, ageMs, window } = req.body;
+
+    if (!DEVICE_ALERT_TYPES.includes(alertType) || !DEVICE_ALERT_SEVERITIES.includes(severity) || !message) {
+      return res.status(400).json({
+        success: false,
+        message: 'alertType (gas, spoilage_risk), severity and message are required'
+      });
+    }
+
+    const owner = await findDeviceOwner(deviceId);
+    if (!owner || String(farmerId) !== owner) {
+      return res.status(403).json({
+        success: false,
+        message: 'Unknown device, or farmerId is not the owner of this device'
+      });
+    }
+
+    // Detection time: device epoch time when synced, otherwise reconstructed from its age
+    const receivedAt = Date.now();
+    const detectedMs = Number(ts);
+    const detectedAt = detectedMs > MIN_DEVICE_EPOCH_MS && detectedMs < receivedAt + MAX_DEVICE_CLOCK_AHEAD_MS
+      ? new Date(detectedMs)
+      : new Date(receivedAt - (Number(ageMs) || 0));
+
+    const alert = new StorageAlert({
+      batchId: deviceId,  // A device watches one storage unit, its alerts are grouped under it
+      deviceId,
+      farmerId: owner,
+      alertType,
+      severity,
+      message,
+      channels: Array.isArray(channels) ? channels : [],
+      threshold: threshold || {},
+      currentReadings: currentReadings || {},
+      window: (Array.isArray(window) ? window.slice(0, 32) : []).map(({ ageMs: sampleAgeMs, ...gasLevels }) => ({
+        timestamp: new Date(receivedAt - (Number(sampleAgeMs) || 0)),
+        gasLevels
+      })),
+      recommendedAction: 'Inspect the stored produce for spoilage and increase ventilation',
+      createdAt: detectedAt
+    });
+    await alert.save();
+
+    console.log(`🚨 ESP32 alert from ${deviceId}: ${message} (${Date.now() - detectedAt.getTime()}ms after detection)`);
+
+    res.status(201).json({
+      success: true,
+      message: 'Alert received',
+      data: {
+        id: alert._id,
+        severity: alert.severity
+      }
+    });
+  } catch (error) {
+    console.error('❌ Error saving ESP32 alert:', error);
+    res.status(500).json({
+      success: false,
+      message: 'Failed to save alert'
+    });
+  }
+});
+
 // API Endpoint: Get storage alerts
 app.get('/api/storage/alerts/:farmerId', async (req, res) => {
   try {
@@ -648,6 +972,154 @@ app.get('/api/storage/alerts/:farmerId', async (req, res) => {
   }
 });
 
+// Device settings over fleet settings; unset fields are left out so the firmware keeps its defaults
+const resolveDeviceConfig = async (deviceId) => {
+  const configs = await DeviceConfig.find({ deviceId: { $in: [FLEET_CONFIG_ID, deviceId] } }).lean();
+  const fleet = configs.find(config => config.deviceId === FLEET_CONFIG_ID) || {};
+  const device = configs.find(config => config.deviceId === deviceId && deviceId !== FLEET_CONFIG_ID) || {};
+
+  const data = {};
+  for (const field of DEVICE_CONFIG_FIELDS) {
+    const value = device[field] ?? fleet[field];
+    if (value !== undefined && value !== null) {
+      data[field] = value;
+    }
+  }
+  return data;
+};
+
+// API Endpoint: Config polled by an ESP32 with If-None-Match
+// Express derives the ETag from the body and answers 304 without one when it still matches,
+// so the body must only depend on the config (no timestamps)
+app.get('/api/storage/devices/:deviceId/config', async (req, res) => {
+  try {
+    const data = await resolveDeviceConfig(req.params.deviceId);
+    res.set('Cache-Control', 'no-cache');
+    res.json({
+      success: true,
+      data
+    });
+  } catch (error) {
+    console.error('❌ Error:', error);
+    res.status(500).json({
+      success: false,
+      message: 'Failed to fetch device config'
+    });
+  }
+});
+
+// API Endpoint: Tune one device, or the whole fleet with deviceId '*'
+// Body: { minIntervalMs, maxIntervalMs, uplinkSamples, pollIntervalMs, cropProfile, r0, backendHost, backendPort, firmwareVersion }
+// null clears a field; devices pick the change up at their next poll
+// Farmers tune their own devices; the fleet config and ADMIN_CONFIG_FIELDS need an admin
+app.put('/api/storage/devices/:deviceId/config', authenticate, authorize('farmer', 'admin'), async (req, res) => {
+  try {
+    const { deviceId } = req.params;
+    const isAdmin = req.user.role === 'admin';
+
+    if (!isAdmin) {
+      const adminFields = ADMIN_CONFIG_FIELDS.filter(field => req.body[field] !== undefined);
+      if (deviceId === FLEET_CONFIG_ID || adminFields.length > 0) {
+        return res.status(403).json({
+          success: false,
+          message: deviceId === FLEET_CONFIG_ID
+            ? 'Only an admin can change the fleet config'
+            : `Only an admin can change ${adminFields.join(', ')}`
+        });
+      }
+    }
+
+    const owner = deviceId === FLEET_CONFIG_ID ? null : await findDeviceOwner(deviceId);
+    if (!isAdmin && owner !== String(req.user._id)) {
+      return res.status(403).json({
+        success: false,
+        message: 'This device is not registered to you'
+      });
+    }
+
+    const set = {};
+    const unset = {};
+    for (const field of DEVICE_CONFIG_FIELDS) {
+      if (req.body[field] === null) {
+        unset[field] = '';
+      } else if (req.body[field] !== undefined) {
+        set[field] = req.body[field];
+      }
+    }
+
+    if (Object.keys(set).length === 0 && Object.keys(unset).length === 0) {
+      return res.status(400).json({
+        success: false,
+        message: `Nothing to update, expected one of: ${DEVICE_CONFIG_FIELDS.join(', ')}`
+      });
+    }
+
+    // Devices reject a config whose interval bounds cross, so never publish one
+    const next = { ...(await resolveDeviceConfig(deviceId)), ...set };
+    if (next.minIntervalMs !== undefined && next.maxIntervalMs !== undefined && next.minIntervalMs > next.maxIntervalMs) {
+      return res.status(400).json({
+        success: false,
+        message: 'minIntervalMs must not be above maxIntervalMs'
+      });
+    }
+
+    // The owner found from readings is recorded, so later readings cannot move the device to another farmer
+    const update = { $set: owner ? { ...set, farmerId: owner } : set };
+    if (Object.keys(unset).length > 0) {
+      update.$unset = unset;
+    }
+    await DeviceConfig.findOneAndUpdate(
+      { deviceId },
+      update,
+      { upsert: true, runValidators: true, setDefaultsOnInsert: true }
+    );
+
+    const data = await resolveDeviceConfig(deviceId);
+    res.json({
+      success: true,
+      message: 'Device config updated',
+      data
+    });
+  } catch (error) {
+    console.error('❌ Error:', error);
+    res.status(error.name === 'ValidationError' || error.name === 'CastError' ? 400 : 500).json({
+      success: false,
+      message: 'Failed to update device config',
+      error: error.message
+    });
+  }
+});
+
+// Firmware delta patches: <from>_<to>.hdp, built with esp32-storage/tools/delta_patch.cpp
+const FIRMWARE_DIR = process.env.FIRMWARE_DIR || path.join(__dirname, 'firmware');
+const FIRMWARE_VERSION_PATTERN = /^[A-Za-z0-9._-]{1,23}$/;
+
+// API Endpoint: Patch from the release a device runs to the one its config names
+// Sent with a Content-Length; the device writes it to flash while it downloads, so no need to buffer here either
+app.get('/api/storage/firmware/:from/:to', (req, res) => {
+  const { from, to } = req.params;
+  if (!FIRMWARE_VERSION_PATTERN.test(from) || !FIRMWARE_VERSION_PATTERN.test(to) || from === to) {
+    return res.status(400).json({
+      success: false,
+      message: 'Expected two different versions of letters, digits, dots, dashes and underscores'
+    });
+  }
+
+  res.sendFile(`${from}_${to}.hdp`, {
+    root: FIRMWARE_DIR,
+    headers: { 'Content-Type': 'application/octet-stream' }
+  }, (error) => {
+    if (!error) {
+      console.log(`📦 Firmware patch ${from} -> ${to} sent`);
+    } else if (!res.headersSent) {
+      res.status(error.statusCode === 404 ? 404 : 500).json({
+        success: false,
+        message: error.statusCode === 404 ? `No firmware patch from ${from} to ${to}` : 'Failed to send firmware patch'
+      });
+    }
+  });
+});
+
 // ==================== REQUEST MANAGEMENT ROUTES ====================
 
 // API Endpoint: Create a new buyer request
@@ -1080,8 +1552,13 @@ app.get('/health', (req, res) => {
   res.json({ status: 'ok', message: 'HarvestHub API is running' });
 });
 
-app.listen(PORT, () => {
+const server = app.listen(PORT, () => {
   console.log(`🚀 Server running on http://localhost:${PORT}`);
   console.log(`🤖 Gemini Vision API: ${process.env.GEMINI_API_KEY ? 'Configured' : 'NOT configured'}`);
   console.log(`🔐 JWT Secret: ${process.env.JWT_SECRET ? 'Configured' : 'Using default - CHANGE IN PRODUCTION'}`);
 });
+
+// ESP32 devices keep one connection open between readings (every 5 s); Node's
+// default 5 s keep-alive timeout would close it right before each reuse
+server.keepAliveTimeout = 65000;
+server.headersTimeout = 66000;
@@ -0,0 +1,335 @@
+#include <string.h>
+#include "delta_patch.h"
+
+static const uint8_t DELTA_MAGIC[2] = { 'H', 'D' };
+
+/* Half-byte table, 64 bytes instead of 1 KB, fast enough for a flash-speed source */
+static const uint32_t CRC_NIBBLES[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ CRC_NIBBLES[crc & 0x0F];
+    crc = (crc >> 4) ^ CRC_NIBBLES[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+const char* deltaStatusName(DeltaStatus status) {
+  switch (status) {
+    case DELTA_MORE: return "incomplete";
+    case DELTA_DONE: return "done";
+    case DELTA_BAD_HEADER: return "not a patch";
+    case DELTA_SOURCE_MISMATCH: return "wrong source image";
+    case DELTA_CORRUPT: return "corrupt patch";
+    case DELTA_TRUNCATED: return "truncated patch";
+    case DELTA_TARGET_MISMATCH: return "target CRC mismatch";
+    case DELTA_READ_FAILED: return "source read failed";
+    case DELTA_WRITE_FAILED: return "target write failed";
+  }
+  return "?";
+}
+
+static uint32_t readLe32(const uint8_t* data) {
+  return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+void DeltaPatcher::begin(DeltaSource& patchSource, DeltaTarget& patchTarget) {
+  source = &patchSource;
+  target = &patchTarget;
+  state = DELTA_MORE;
+  step = STEP_HEADER;
+  memset(&header, 0, sizeof(header));
+  headerLength = 0;
+  varint = 0;
+  varintShift = 0;
+  copyLeft = 0;
+  insertLeft = 0;
+  seek = 0;
+  runLeft = 0;
+  sourcePosition = 0;
+  produced = 0;
+  consumed = 0;
+  crc = 0;
+  sourceStart = 0;
+  sourceLength = 0;
+  targetLength = 0;
+}
+
+DeltaStatus DeltaPatcher::fail(DeltaStatus status) {
+  state = status;
+  return status;
+}
+
+DeltaStatus DeltaPatcher::write(const uint8_t* data, size_t length) {
+  if (state == DELTA_DONE && length > 0) {
+    return fail(DELTA_CORRUPT);  // Bytes past the end of the target
+  }
+  if (state != DELTA_MORE) {
+    return state;
+  }
+  consumed += length;
+
+  size_t i = 0;
+  while (i < length && state == DELTA_MORE) {
+    size_t left = length - i;
+    switch (step) {
+      case STEP_HEADER: {
+        size_t take = DELTA_HEADER_SIZE - headerLength < left ? DELTA_HEADER_SIZE - headerLength : left;
+        memcpy(headerBytes + headerLength, data + i, take);
+        headerLength += take;
+        i += take;
+        if (headerLength == DELTA_HEADER_SIZE && parseHeader()) {
+          nextStep();
+        }
+        break;
+      }
+
+      case STEP_LITERALS: {
+        size_t take = runLeft < left ? runLeft : left;
+        if (copySource(take, data + i)) {
+          runLeft -= take;
+          copyLeft -= take;
+          i += take;
+          if (runLeft == 0) {
+            nextStep();
+          }
+        }
+        break;
+      }
+
+      case STEP_INSERT: {
+        size_t take = insertLeft < left ? insertLeft : left;
+        if (emit(data + i, take)) {
+          insertLeft -= take;
+          i += take;
+          if (insertLeft == 0) {
+            nextStep();
+          }
+        }
+        break;
+      }
+
+      case STEP_END:
+        fail(DELTA_CORRUPT);
+        break;
+
+      default:
+        // The varint fields of a block and of a difference run
+        if (!readVarint(data[i++])) {
+          break;
+        }
+        if (step == STEP_COPY_LENGTH) {
+          copyLeft = varint;
+          step = STEP_INSERT_LENGTH;
+        } else if (step == STEP_INSERT_LENGTH) {
+          insertLeft = varint;
+          step = STEP_SEEK;
+        } else if (step == STEP_SEEK) {
+          seek = (int32_t)(varint >> 1) ^ -(int32_t)(varint & 1);
+          // Whole block within both images, so the runs below only check against it
+          if (copyLeft > header.sourceSize - sourcePosition || copyLeft > header.targetSize - produced ||
+              insertLeft > header.targetSize - produced - copyLeft) {
+            fail(DELTA_CORRUPT);
+            break;
+          }
+          nextStep();
+        } else if (step == STEP_ZEROS) {
+          if (varint > copyLeft) {
+            fail(DELTA_CORRUPT);
+            break;
+          }
+          if (copySource(varint, nullptr)) {
+            copyLeft -= varint;
+            step = STEP_LITERAL_LENGTH;
+          }
+        } else if (step == STEP_LITERAL_LENGTH) {
+          if (varint > copyLeft) {
+            fail(DELTA_CORRUPT);
+            break;
+          }
+          runLeft = varint;
+          if (runLeft > 0) {
+            step = STEP_LITERALS;
+          } else {
+            nextStep();
+          }
+        }
+        break;
+    }
+  }
+  if (state == DELTA_DONE && i < length) {
+    fail(DELTA_CORRUPT);
+  }
+  return state;
+}
+
+DeltaStatus DeltaPatcher::finish() {
+  if (state == DELTA_MORE) {
+    return fail(DELTA_TRUNCATED);
+  }
+  return state;
+}
+
+/* Little endian base-128, true once the last byte of a value is in */
+bool DeltaPatcher::readVarint(uint8_t byte) {
+  if (varintShift == 0) {
+    varint = 0;
+  }
+  if (varintShift == 28 && byte > 0x0F) {
+    fail(DELTA_CORRUPT);  // More than 32 bits
+    return false;
+  }
+  varint |= (uint32_t)(byte & 0x7F) << varintShift;
+  if (byte & 0x80) {
+    varintShift += 7;
+    return false;
+  }
+  varintShift = 0;
+  return true;
+}
+
+bool DeltaPatcher::parseHeader() {
+  if (memcmp(headerBytes, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0 || headerBytes[2] != DELTA_VERSION ||
+      headerBytes[3] != 0) {
+    fail(DELTA_BAD_HEADER);
+    return false;
+  }
+  header.sourceSize = readLe32(headerBytes + 4);
+  header.sourceCrc = readLe32(headerBytes + 8);
+  header.targetSize = readLe32(headerBytes + 12);
+  header.targetCrc = readLe32(headerBytes + 16);
+
+  if (!verifySource()) {
+    return false;
+  }
+  if (!target->open(header.targetSize)) {
+    fail(DELTA_WRITE_FAILED);
+    return false;
+  }
+  return true;
+}
+
+/* Reads the whole source once; a patch for another image must not touch the target */
+bool DeltaPatcher::verifySource() {
+  uint32_t sum = 0;
+  for (uint32_t offset = 0; offset < header.sourceSize; offset += sourceLength) {
+    uint32_t left = header.sourceSize - offset;
+    sourceLength = left < sizeof(sourceBuffer) ? left : sizeof(sourceBuffer);
+    if (!source->read(offset, sourceBuffer, sourceLength)) {
+      fail(DELTA_READ_FAILED);
+      return false;
+    }
+    sum = deltaCrc32(sum, sourceBuffer, sourceLength);
+  }
+  sourceStart = header.sourceSize;  // Nothing cached
+  sourceLength = 0;
+
+  if (sum != header.sourceCrc) {
+    fail(DELTA_SOURCE_MISMATCH);
+    return false;
+  }
+  return true;
+}
+
+/* Picks the next field after a part of a block is done, ends the block and the patch */
+void DeltaPatcher::nextStep() {
+  if (copyLeft > 0) {
+    step = STEP_ZEROS;
+    return;
+  }
+  if (insertLeft > 0) {
+    step = STEP_INSERT;
+    return;
+  }
+
+  if (step != STEP_HEADER) {
+    int64_t position = (int64_t)sourcePosition + seek;
+    if (position < 0 || position > header.sourceSize) {
+      fail(DELTA_CORRUPT);
+      return;
+    }
+    sourcePosition = (uint32_t)position;
+    seek = 0;
+  }
+  if (produced < header.targetSize) {
+    step = STEP_COPY_LENGTH;
+    return;
+  }
+
+  step = STEP_END;
+  if (flush()) {
+    state = crc == header.targetCrc ? DELTA_DONE : DELTA_TARGET_MISMATCH;
+  }
+}
+
+/* Emits count source bytes, each plus the next difference byte unless difference is null */
+bool DeltaPatcher::copySource(size_t count, const uint8_t* difference) {
+  while (count > 0) {
+    if (sourcePosition < sourceStart || sourcePosition >= sourceStart + sourceLength) {
+      uint32_t left = header.sourceSize - sourcePosition;
+      sourceStart = sourcePosition;
+      sourceLength = left < sizeof(sourceBuffer) ? left : sizeof(sourceBuffer);
+      if (!source->read(sourceStart, sourceBuffer, sourceLength)) {
+        fail(DELTA_READ_FAILED);
+        return false;
+      }
+    }
+
+    const uint8_t* old = sourceBuffer + (sourcePosition - sourceStart);
+    size_t take = sourceStart + sourceLength - sourcePosition;
+    if (take > count) {
+      take = count;
+    }
+    if (difference == nullptr) {
+      if (!emit(old, take)) {
+        return false;
+      }
+    } else {
+      for (size_t i = 0; i < take; i++) {
+        if (targetLength == sizeof(targetBuffer) && !flush()) {
+          return false;
+        }
+        targetBuffer[targetLength++] = (uint8_t)(old[i] + difference[i]);
+      }
+      produced += take;
+      difference += take;
+    }
+    sourcePosition += take;
+    count -= take;
+  }
+  return true;
+}
+
+bool DeltaPatcher::emit(const uint8_t* data, size_t length) {
+  produced += length;
+  while (length > 0) {
+    if (targetLength == sizeof(targetBuffer) && !flush()) {
+      return false;
+    }
+    size_t room = sizeof(targetBuffer) - targetLength;
+    size_t take = length < room ? length : room;
+    memcpy(targetBuffer + targetLength, data, take);
+    targetLength += take;
+    data += take;
+    length -= take;
+  }
+  return true;
+}
+
+bool DeltaPatcher::flush() {
+  if (targetLength == 0) {
+    return true;
+  }
+  crc = deltaCrc32(crc, targetBuffer, targetLength);
+  if (!target->write(targetBuffer, targetLength)) {
+    fail(DELTA_WRITE_FAILED);
+    return false;
+  }
+  targetLength = 0;
+  return true;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming delta patches for firmware images (bsdiff style).
+ *
+ * A new image is mostly the old one with shifted addresses, so a patch
+ * describes it as blocks against the running image: add a difference to
+ * the old bytes (mostly zero), insert new bytes, move the old position.
+ *
+ * Layout (little endian):
+ *
+ *   "HD" version:1 flags:1
+ *   sourceSize:4 sourceCrc:4 targetSize:4 targetCrc:4
+ *   blocks until targetSize bytes are out:
+ *     copy:varint insert:varint seek:zigzag varint
+ *     copy bytes of difference as runs: zeros:varint literals:varint bytes...
+ *     insert bytes, raw
+ *
+ * The patcher is pushed the patch in chunks of any size as it arrives and
+ * writes the target through a small buffer, so neither the patch nor the
+ * image is ever held in full. The source is checked against sourceCrc
+ * before the target is opened, and the target against targetCrc at the
+ * end. CRC-32 is the zlib one.
+ *
+ * Plain C++ without Arduino, tools/delta_patch.cpp builds patches and
+ * applies them to image files on the host.
+ */
+
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 20
+#define DELTA_SOURCE_BUFFER 512   // Old image bytes read ahead
+#define DELTA_TARGET_BUFFER 1024  // New image bytes collected before a write
+
+/* The image the patch was built against, e.g. the running app partition */
+class DeltaSource {
+ public:
+  virtual ~DeltaSource() {}
+  virtual bool read(uint32_t offset, uint8_t* data, size_t length) = 0;
+};
+
+/* Where the new image goes, e.g. the inactive app partition */
+class DeltaTarget {
+ public:
+  virtual ~DeltaTarget() {}
+
+  /* Called once the source checked out, before the first write */
+  virtual bool open(uint32_t size) = 0;
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+};
+
+enum DeltaStatus {
+  DELTA_MORE,             // Fine so far, waiting for more patch bytes
+  DELTA_DONE,             // Target complete and its CRC matches
+  DELTA_BAD_HEADER,       // Not a patch of this version
+  DELTA_SOURCE_MISMATCH,  // Built against a different image
+  DELTA_CORRUPT,          // Block out of range, or bytes past the end
+  DELTA_TRUNCATED,        // finish() before the target was complete
+  DELTA_TARGET_MISMATCH,  // Target CRC differs
+  DELTA_READ_FAILED,
+  DELTA_WRITE_FAILED
+};
+
+const char* deltaStatusName(DeltaStatus status);
+
+/* zlib CRC-32, crc = 0 to start */
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t length);
+
+/* One patch at a time; no constructor work, begin() resets everything */
+class DeltaPatcher {
+ public:
+  void begin(DeltaSource& source, DeltaTarget& target);
+
+  /* Feeds the next patch bytes; anything but DELTA_MORE and DELTA_DONE is final */
+  DeltaStatus write(const uint8_t* data, size_t length);
+
+  /* End of the patch stream: DELTA_DONE if the target was complete */
+  DeltaStatus finish();
+
+  DeltaStatus status() const { return state; }
+  uint32_t sourceSize() const { return header.sourceSize; }
+  uint32_t targetSize() const { return header.targetSize; }
+  uint32_t written() const { return produced; }
+  uint32_t patchBytes() const { return consumed; }
+
+ private:
+  enum Step {
+    STEP_HEADER,
+    STEP_COPY_LENGTH,
+    STEP_INSERT_LENGTH,
+    STEP_SEEK,
+    STEP_ZEROS,
+    STEP_LITERAL_LENGTH,
+    STEP_LITERALS,
+    STEP_INSERT,
+    STEP_END
+  };
+
+  struct Header {
+    uint32_t sourceSize;
+    uint32_t sourceCrc;
+    uint32_t targetSize;
+    uint32_t targetCrc;
+  };
+
+  DeltaStatus fail(DeltaStatus status);
+  bool readVarint(uint8_t byte);
+  bool parseHeader();
+  bool verifySource();
+  void nextStep();
+  bool copySource(size_t count, const uint8_t* difference);
+  bool emit(const uint8_t* data, size_t length);
+  bool flush();
+
+  DeltaSource* source;
+  DeltaTarget* target;
+  DeltaStatus state;
+  Step step;
+  Header header;
+  uint8_t headerBytes[DELTA_HEADER_SIZE];
+  size_t headerLength;
+
+  uint32_t varint;       // Value of the varint being read
+  uint8_t varintShift;
+  uint32_t copyLeft;     // Of the current block
+  uint32_t insertLeft;
+  int32_t seek;
+  uint32_t runLeft;      // Literals left in the current run
+
+  uint32_t sourcePosition;
+  uint32_t produced;
+  uint32_t consumed;
+  uint32_t crc;
+
+  uint8_t sourceBuffer[DELTA_SOURCE_BUFFER];
+  uint32_t sourceStart;  // Offset of sourceBuffer[0]
+  size_t sourceLength;
+  uint8_t targetBuffer[DELTA_TARGET_BUFFER];
+  size_t targetLength;
+};
@@ -0,0 +1,339 @@
+#include <string.h>
+#include "series_codec.h"
+
+static const uint8_t SERIES_MAGIC[2] = { 'H', 'S' };
+
+void BitWriter::begin(uint8_t* buffer, size_t capacity) {
+  data = buffer;
+  capacityBits = capacity * 8;
+  position = 0;
+  overflow = false;
+}
+
+void BitWriter::write(uint64_t value, uint8_t bits) {
+  if (overflow || position + bits > capacityBits) {
+    overflow = true;
+    return;
+  }
+  while (bits > 0) {
+    // As many bits as are left in the current byte
+    uint8_t free = 8 - (position & 7);
+    uint8_t take = bits < free ? bits : free;
+    uint8_t chunk = (uint8_t)((value >> (bits - take)) & ((1u << take) - 1));
+    uint8_t& target = data[position >> 3];
+    if ((position & 7) == 0) {
+      target = 0;
+    }
+    target |= chunk << (free - take);
+    position += take;
+    bits -= take;
+  }
+}
+
+void BitReader::begin(const uint8_t* buffer, size_t length) {
+  data = buffer;
+  lengthBits = length * 8;
+  position = 0;
+  underflow = false;
+}
+
+uint64_t BitReader::read(uint8_t bits) {
+  if (underflow || position + bits > lengthBits) {
+    underflow = true;
+    return 0;
+  }
+  uint64_t value = 0;
+  while (bits > 0) {
+    uint8_t left = 8 - (position & 7);
+    uint8_t take = bits < left ? bits : left;
+    uint8_t chunk = (data[position >> 3] >> (left - take)) & ((1u << take) - 1);
+    value = (value << take) | chunk;
+    position += take;
+    bits -= take;
+  }
+  return value;
+}
+
+static uint64_t zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint8_t leadingZeros(uint32_t value) {
+  uint8_t count = 0;
+  for (uint32_t bit = 0x80000000u; bit != 0 && !(value & bit); bit >>= 1) {
+    count++;
+  }
+  return count;
+}
+
+static uint8_t trailingZeros(uint32_t value) {
+  uint8_t count = 0;
+  for (uint32_t bit = 1; bit != 0 && !(value & bit); bit <<= 1) {
+    count++;
+  }
+  return count;
+}
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+bool SeriesEncoder::begin(uint8_t* output, size_t capacity, SeriesTimeMode timeMode,
+                          const char* farmerId, const char* deviceId) {
+  size_t farmerLength = strlen(farmerId) < 255 ? strlen(farmerId) : 255;
+  size_t deviceLength = strlen(deviceId) < 255 ? strlen(deviceId) : 255;
+  headerLength = 6 + 1 + farmerLength + 1 + deviceLength;
+  if (capacity < headerLength) {
+    return false;
+  }
+
+  buffer = output;
+  buffer[0] = SERIES_MAGIC[0];
+  buffer[1] = SERIES_MAGIC[1];
+  buffer[2] = SERIES_VERSION;
+  buffer[3] = timeMode;
+  buffer[4] = 0;  // Row count, written by finish()
+  buffer[5] = 0;
+  buffer[6] = (uint8_t)farmerLength;
+  memcpy(buffer + 7, farmerId, farmerLength);
+  buffer[7 + farmerLength] = (uint8_t)deviceLength;
+  memcpy(buffer + 8 + farmerLength, deviceId, deviceLength);
+
+  mode = timeMode;
+  bits.begin(buffer + headerLength, capacity - headerLength);
+  rows = 0;
+  memset(&time, 0, sizeof(time));
+  memset(&sequence, 0, sizeof(sequence));
+  suppressed = 0;
+  state = 0;
+  memset(channels, 0, sizeof(channels));
+  for (int i = 0; i < SERIES_CHANNELS; i++) {
+    masks[i] = 0xFFFFFFFFu;
+  }
+  return true;
+}
+
+void SeriesEncoder::setPrecision(uint8_t channel, uint8_t mantissaBits) {
+  if (channel < SERIES_CHANNELS && mantissaBits <= 23) {
+    masks[channel] = ~((1u << (23 - mantissaBits)) - 1);
+  }
+}
+
+bool SeriesEncoder::add(const SeriesRow& row) {
+  if (rows == 0xFFFF) {
+    return false;
+  }
+  if (mode != SERIES_TIME_NONE) {
+    writeDelta(time, row.timeMs);
+  }
+  writeDelta(sequence, row.sequence);
+  writeSmall(suppressed, row.suppressed, 16);
+  writeSmall(state, row.status | (uint32_t)row.flags << 8, 16);
+
+  if (!(row.flags & SERIES_STATUS_ONLY)) {
+    for (int i = 0; i < SERIES_CHANNELS; i++) {
+      uint32_t value = floatBits(row.values[i]);
+      uint32_t dropped = ~masks[i];
+      if (dropped != 0 && (value & 0x7F800000u) != 0x7F800000u) {
+        value = (value + (dropped >> 1) + 1) & masks[i];  // Round to nearest, a carry into the exponent is exact
+      }
+      writeFloat(channels[i], value);
+    }
+  }
+  rows++;
+  return !bits.overflowed();
+}
+
+size_t SeriesEncoder::finish() {
+  if (bits.overflowed()) {
+    return 0;
+  }
+  buffer[4] = rows & 0xFF;
+  buffer[5] = rows >> 8;
+  return headerLength + bits.bytes();
+}
+
+/*
+ * Delta-of-delta in zigzag form, bucketed like Gorilla timestamps:
+ * 0 -> '0', <2^7 -> '10'+7, <2^10 -> '110'+10, <2^13 -> '1110'+13, else '1111'+64.
+ * The first row is written raw.
+ */
+void SeriesEncoder::writeDelta(DeltaColumn& column, int64_t value) {
+  if (rows == 0) {
+    bits.write((uint64_t)value, 64);
+    column.previous = value;
+    column.previousDelta = 0;
+    return;
+  }
+
+  int64_t delta = value - column.previous;
+  uint64_t encoded = zigzag(delta - column.previousDelta);
+  if (encoded == 0) {
+    bits.write(0, 1);
+  } else if (encoded < (1u << 7)) {
+    bits.write(0x2, 2);
+    bits.write(encoded, 7);
+  } else if (encoded < (1u << 10)) {
+    bits.write(0x6, 3);
+    bits.write(encoded, 10);
+  } else if (encoded < (1u << 13)) {
+    bits.write(0xE, 4);
+    bits.write(encoded, 13);
+  } else {
+    bits.write(0xF, 4);
+    bits.write(encoded, 64);
+  }
+  column.previous = value;
+  column.previousDelta = delta;
+}
+
+void SeriesEncoder::writeSmall(uint32_t& previous, uint32_t value, uint8_t width) {
+  if (value == previous) {
+    bits.write(0, 1);
+    return;
+  }
+  bits.write(1, 1);
+  bits.write(value, width);
+  previous = value;
+}
+
+/*
+ * '0' unchanged; '10' + the bits inside the previous leading/trailing zero
+ * window; '11' + 5 bits leading zeros + 5 bits (length - 1) + the bits.
+ */
+void SeriesEncoder::writeFloat(XorColumn& column, uint32_t value) {
+  uint32_t difference = value ^ column.previous;
+  column.previous = value;
+  if (difference == 0) {
+    bits.write(0, 1);
+    return;
+  }
+
+  uint8_t leading = leadingZeros(difference);
+  uint8_t trailing = trailingZeros(difference);
+  if (column.haveWindow && leading >= column.leading && trailing >= column.trailing) {
+    bits.write(0x2, 2);
+    bits.write(difference >> column.trailing, 32 - column.leading - column.trailing);
+    return;
+  }
+
+  uint8_t length = 32 - leading - trailing;
+  bits.write(0x3, 2);
+  bits.write(leading, 5);
+  bits.write(length - 1, 5);
+  bits.write(difference >> trailing, length);
+  column.leading = leading;
+  column.trailing = trailing;
+  column.haveWindow = true;
+}
+
+bool SeriesDecoder::begin(const uint8_t* data, size_t length) {
+  if (length < 8 || data[0] != SERIES_MAGIC[0] || data[1] != SERIES_MAGIC[1] ||
+      data[2] != SERIES_VERSION || data[3] > SERIES_TIME_AGE) {
+    return false;
+  }
+  mode = (SeriesTimeMode)data[3];
+  rows = data[4] | data[5] << 8;
+
+  size_t position = 6;
+  char* ids[2] = { farmer, device };
+  for (char* id : ids) {
+    if (position >= length || position + 1 + data[position] > length) {
+      return false;
+    }
+    uint8_t idLength = data[position];
+    memcpy(id, data + position + 1, idLength);
+    id[idLength] = '\0';
+    position += 1 + idLength;
+  }
+
+  bits.begin(data + position, length - position);
+  decoded = 0;
+  corrupt = false;
+  memset(&time, 0, sizeof(time));
+  memset(&sequence, 0, sizeof(sequence));
+  suppressed = 0;
+  state = 0;
+  memset(channels, 0, sizeof(channels));
+  return true;
+}
+
+bool SeriesDecoder::next(SeriesRow& row) {
+  if (decoded >= rows) {
+    return false;
+  }
+  row.timeMs = mode != SERIES_TIME_NONE ? readDelta(time) : 0;
+  row.sequence = (uint32_t)readDelta(sequence);
+  row.suppressed = (uint16_t)readSmall(suppressed, 16);
+  uint32_t bothStates = readSmall(state, 16);
+  row.status = bothStates & 0xFF;
+  row.flags = bothStates >> 8;
+
+  for (int i = 0; i < SERIES_CHANNELS; i++) {
+    if (row.flags & SERIES_STATUS_ONLY) {
+      row.values[i] = 0;
+      continue;
+    }
+    uint32_t value = readFloat(channels[i]);
+    memcpy(&row.values[i], &value, sizeof(value));
+  }
+  decoded++;
+  return !bits.exhausted() && !corrupt;
+}
+
+int64_t SeriesDecoder::readDelta(DeltaColumn& column) {
+  if (decoded == 0) {
+    column.previous = (int64_t)bits.read(64);
+    column.previousDelta = 0;
+    return column.previous;
+  }
+
+  uint64_t encoded = 0;
+  if (bits.read(1) != 0) {
+    if (bits.read(1) == 0) {
+      encoded = bits.read(7);
+    } else if (bits.read(1) == 0) {
+      encoded = bits.read(10);
+    } else if (bits.read(1) == 0) {
+      encoded = bits.read(13);
+    } else {
+      encoded = bits.read(64);
+    }
+  }
+  // Unsigned arithmetic: garbage input must not overflow a signed value
+  column.previousDelta = (int64_t)((uint64_t)column.previousDelta + (uint64_t)unzigzag(encoded));
+  column.previous = (int64_t)((uint64_t)column.previous + (uint64_t)column.previousDelta);
+  return column.previous;
+}
+
+uint32_t SeriesDecoder::readSmall(uint32_t& previous, uint8_t width) {
+  if (bits.read(1) != 0) {
+    previous = (uint32_t)bits.read(width);
+  }
+  return previous;
+}
+
+uint32_t SeriesDecoder::readFloat(XorColumn& column) {
+  if (bits.read(1) == 0) {
+    return column.previous;
+  }
+  if (bits.read(1) != 0) {
+    uint8_t leading = (uint8_t)bits.read(5);
+    uint8_t length = (uint8_t)bits.read(5) + 1;
+    if (leading + length > 32) {
+      corrupt = true;
+      return column.previous;
+    }
+    column.leading = leading;
+    column.trailing = 32 - leading - length;
+  }
+  uint8_t length = 32 - column.leading - column.trailing;
+  column.previous ^= (uint32_t)bits.read(length) << column.trailing;
+  return column.previous;
+}
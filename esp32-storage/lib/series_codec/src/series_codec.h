@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Columnar batch encoding for storage readings (Gorilla style).
+ *
+ * Consecutive readings of one room barely differ, so a batch is sent as
+ * a bit stream of differences instead of repeating every key and digit:
+ *
+ *   - time and sequence: delta-of-delta, 1 bit while the sampling grid
+ *     holds, 9 to 68 bits otherwise
+ *   - every float channel: XOR with the channel's previous value, 1 bit
+ *     when unchanged (a DHT11 temperature mostly is), otherwise only the
+ *     meaningful bits between the leading and trailing zeros
+ *   - suppressed count and status/flags: 1 bit when unchanged
+ *
+ * Layout (little endian):
+ *
+ *   "HS" version:1 timeMode:1 count:2
+ *   farmerIdLength:1 farmerId  deviceIdLength:1 deviceId
+ *   bit stream, MSB first, one row after the other
+ *
+ * Rows flagged SERIES_STATUS_ONLY carry no channel values. Floats are
+ * lossless unless the encoder is told to drop low mantissa bits.
+ *
+ * Plain C++ without Arduino, so the ingestion side can build the same
+ * code; backend/middleware/series.js is the JavaScript port of the decoder.
+ */
+
+#define SERIES_VERSION 1
+#define SERIES_CHANNELS 7               // temperature, humidity, CO2, ammonia, methane, ethylene, H2S
+#define SERIES_HEADER_MAX (6 + 2 + 2 * 255)
+#define SERIES_STATUS_ONLY 0x02         // Same bit as READING_STATUS_ONLY
+
+enum SeriesTimeMode {
+  SERIES_TIME_NONE,   // No time column
+  SERIES_TIME_EPOCH,  // UTC milliseconds, 0 = unknown
+  SERIES_TIME_AGE     // Milliseconds the reading was held before sending
+};
+
+struct SeriesRow {
+  int64_t timeMs;
+  uint32_t sequence;
+  uint16_t suppressed;
+  uint8_t status;
+  uint8_t flags;
+  float values[SERIES_CHANNELS];
+};
+
+/* Writes bits MSB first into a caller buffer, remembers running out of room */
+class BitWriter {
+ public:
+  void begin(uint8_t* buffer, size_t capacity);
+  void write(uint64_t value, uint8_t bits);
+  size_t bytes() const { return (position + 7) / 8; }
+  bool overflowed() const { return overflow; }
+
+ private:
+  uint8_t* data;
+  size_t capacityBits;
+  size_t position;
+  bool overflow;
+};
+
+class BitReader {
+ public:
+  void begin(const uint8_t* buffer, size_t length);
+  uint64_t read(uint8_t bits);
+  bool exhausted() const { return underflow; }
+
+ private:
+  const uint8_t* data;
+  size_t lengthBits;
+  size_t position;
+  bool underflow;
+};
+
+/* Running state of one integer column (delta-of-delta) */
+struct DeltaColumn {
+  int64_t previous;
+  int64_t previousDelta;
+};
+
+/* Running state of one float column (XOR) */
+struct XorColumn {
+  uint32_t previous;
+  uint8_t leading;
+  uint8_t trailing;
+  bool haveWindow;
+};
+
+class SeriesEncoder {
+ public:
+  /* Starts a batch; ids longer than 255 bytes are cut */
+  bool begin(uint8_t* buffer, size_t capacity, SeriesTimeMode mode, const char* farmerId, const char* deviceId);
+
+  /* Keeps only the top mantissaBits of a channel (23 = lossless), e.g. 16 for noisy gas values */
+  void setPrecision(uint8_t channel, uint8_t mantissaBits);
+
+  /* False once the buffer is full; the batch is then unusable */
+  bool add(const SeriesRow& row);
+
+  /* Bytes used, 0 if the buffer overflowed */
+  size_t finish();
+
+  uint16_t count() const { return rows; }
+
+ private:
+  void writeDelta(DeltaColumn& column, int64_t value);
+  void writeSmall(uint32_t& previous, uint32_t value, uint8_t bits);
+  void writeFloat(XorColumn& column, uint32_t bits);
+
+  uint8_t* buffer;
+  size_t headerLength;
+  SeriesTimeMode mode;
+  BitWriter bits;
+  uint16_t rows;
+  uint32_t masks[SERIES_CHANNELS];
+  DeltaColumn time;
+  DeltaColumn sequence;
+  uint32_t suppressed;
+  uint32_t state;  // status | flags << 8
+  XorColumn channels[SERIES_CHANNELS];
+};
+
+class SeriesDecoder {
+ public:
+  /* False if the header is not a batch of this version */
+  bool begin(const uint8_t* data, size_t length);
+
+  SeriesTimeMode timeMode() const { return mode; }
+  uint16_t count() const { return rows; }
+  const char* farmerId() const { return farmer; }
+  const char* deviceId() const { return device; }
+
+  /* Next row, false after the last one or on a truncated stream */
+  bool next(SeriesRow& row);
+
+ private:
+  int64_t readDelta(DeltaColumn& column);
+  uint32_t readSmall(uint32_t& previous, uint8_t bits);
+  uint32_t readFloat(XorColumn& column);
+
+  SeriesTimeMode mode;
+  uint16_t rows;
+  uint16_t decoded;
+  bool corrupt;
+  char farmer[256];
+  char device[256];
+  BitReader bits;
+  DeltaColumn time;
+  DeltaColumn sequence;
+  uint32_t suppressed;
+  uint32_t state;
+  XorColumn channels[SERIES_CHANNELS];
+};
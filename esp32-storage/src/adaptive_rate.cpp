@@ -0,0 +1,158 @@
+#include <math.h>
+#include <string.h>
+#include "adaptive_rate.h"
+
+void AdaptiveRate::applyDefaults() {
+  if (!configured) {
+    limits = CONTINUOUS_RATE_BOUNDS;
+    memcpy(bands, DEFAULT_DEADBANDS, sizeof(bands));
+    configured = true;
+  }
+}
+
+void AdaptiveRate::setBounds(const AdaptiveBounds& bounds) {
+  applyDefaults();
+  limits = bounds;
+}
+
+void AdaptiveRate::setBand(ReadingChannel channel, Deadband band) {
+  applyDefaults();
+  bands[channel] = band;
+}
+
+float AdaptiveRate::bandFor(int channel, float value) const {
+  float band = bands[channel].relative * fabsf(value);
+  return band < bands[channel].absolute ? bands[channel].absolute : band;
+}
+
+/* Least squares line through the window, time measured in seconds back from the newest sample */
+bool AdaptiveRate::fit(int channel, Fit& result) const {
+  uint32_t newest = times[(head + ADAPTIVE_WINDOW - 1) % ADAPTIVE_WINDOW];
+  float x[ADAPTIVE_WINDOW];
+  float y[ADAPTIVE_WINDOW];
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    int slot = (head + ADAPTIVE_WINDOW - 1 - i) % ADAPTIVE_WINDOW;
+    if (isfinite(values[slot][channel])) {
+      x[n] = -(float)(newest - times[slot]) / 1000.0f;
+      y[n] = values[slot][channel];
+      n++;
+    }
+  }
+  if (n < 3) {
+    return false;
+  }
+
+  float meanX = 0, meanY = 0;
+  for (int i = 0; i < n; i++) {
+    meanX += x[i];
+    meanY += y[i];
+  }
+  meanX /= n;
+  meanY /= n;
+
+  float sxx = 0, sxy = 0;
+  for (int i = 0; i < n; i++) {
+    sxx += (x[i] - meanX) * (x[i] - meanX);
+    sxy += (x[i] - meanX) * (y[i] - meanY);
+  }
+  if (sxx <= 0) {
+    return false;
+  }
+
+  result.slope = sxy / sxx;
+  result.intercept = meanY - result.slope * meanX;
+  float residuals = 0;
+  for (int i = 0; i < n; i++) {
+    float r = y[i] - (result.intercept + result.slope * x[i]);
+    residuals += r * r;
+  }
+  result.sigma = sqrtf(residuals / (n - 2));
+  result.slopeError = result.sigma / sqrtf(sxx);
+  return true;
+}
+
+uint32_t AdaptiveRate::update(const Reading& reading) {
+  applyDefaults();
+
+  // Off the fitted trend: something started happening, do not wait for the slope to show it
+  bool surprise = false;
+  if (count >= 3) {
+    float ahead = (float)(reading.capturedAtMs - times[(head + ADAPTIVE_WINDOW - 1) % ADAPTIVE_WINDOW]) / 1000.0f;
+    for (int i = 0; i < READING_CHANNELS && !surprise; i++) {
+      float value = readingChannel(reading, (ReadingChannel)i);
+      Fit line;
+      if (isfinite(value) && fit(i, line)) {
+        float expected = line.intercept + line.slope * ahead;
+        surprise = fabsf(value - expected) > bandFor(i, value) + ADAPTIVE_SURPRISE_SIGMAS * line.sigma;
+      }
+    }
+  }
+
+  if (samples > 0) {
+    float elapsed = (float)(reading.capturedAtMs - times[(head + ADAPTIVE_WINDOW - 1) % ADAPTIVE_WINDOW]);
+    averageIntervalMs = averageIntervalMs > 0
+        ? averageIntervalMs + (elapsed - averageIntervalMs) * ADAPTIVE_RATE_SMOOTHING
+        : elapsed;
+  }
+  samples++;
+
+  times[head] = reading.capturedAtMs;
+  for (int i = 0; i < READING_CHANNELS; i++) {
+    values[head][i] = readingChannel(reading, (ReadingChannel)i);
+  }
+  head = (head + 1) % ADAPTIVE_WINDOW;
+  if (count < ADAPTIVE_WINDOW) {
+    count++;
+  }
+
+  // Time until the fastest clearly moving channel covers its share of a deadband
+  float next = limits.maxIntervalMs;
+  driver = READING_CHANNELS;
+  for (int i = 0; i < READING_CHANNELS; i++) {
+    Fit line;
+    if (!fit(i, line)) {
+      continue;
+    }
+    float trend = fabsf(line.slope) - 2.0f * line.slopeError;
+    if (trend <= 0) {
+      continue;
+    }
+    float ms = ADAPTIVE_CHANGE_FRACTION * bandFor(i, line.intercept) / trend * 1000.0f;
+    if (ms < next) {
+      next = ms;
+      driver = (ReadingChannel)i;
+    }
+  }
+
+  if (surprise) {
+    surprises++;
+    next = limits.minIntervalMs;
+  } else if (count < 3) {
+    next = limits.minIntervalMs;  // No trend yet
+  } else if (interval > 0 && next > 2.0f * interval) {
+    next = 2.0f * interval;
+  }
+
+  interval = next < limits.minIntervalMs ? limits.minIntervalMs
+           : next > limits.maxIntervalMs ? limits.maxIntervalMs
+           : (uint32_t)next;
+  return interval;
+}
+
+uint32_t AdaptiveRate::intervalMs() const {
+  if (interval > 0) {
+    return interval;
+  }
+  return configured ? limits.minIntervalMs : CONTINUOUS_RATE_BOUNDS.minIntervalMs;
+}
+
+uint32_t AdaptiveRate::uplinkIntervalMs() const {
+  const AdaptiveBounds& bounds = configured ? limits : CONTINUOUS_RATE_BOUNDS;
+  uint32_t ms = intervalMs() * bounds.uplinkSamples;
+  return ms < bounds.minUplinkMs ? bounds.minUplinkMs : ms > bounds.maxUplinkMs ? bounds.maxUplinkMs : ms;
+}
+
+float AdaptiveRate::samplesPerMinute() const {
+  return averageIntervalMs > 0 ? 60000.0f / averageIntervalMs : 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include "reading.h"
+#include "deadband.h"
+
+/*
+ * Adaptive sampling interval.
+ *
+ * Each channel keeps its last ADAPTIVE_WINDOW samples and fits a line
+ * through them. The next interval is the time the fitted slope needs to
+ * move the channel by ADAPTIVE_CHANGE_FRACTION of its deadband; the
+ * fastest channel wins. The residual variance enters twice: a slope that
+ * is not clear of twice its standard error counts as flat (DHT11 flicker
+ * stays slow), and a sample further from the fitted line than its band
+ * plus three standard deviations drops straight to the shortest interval.
+ * Calming down is gradual, the interval at most doubles per sample.
+ *
+ * The uplink follows: a batch is due every uplinkSamples intervals.
+ *
+ * Hardware independent, so recorded traces can be replayed on a PC.
+ */
+
+#define ADAPTIVE_WINDOW 8               // Samples per channel the slope is fitted over
+#define ADAPTIVE_CHANGE_FRACTION 0.25f  // Sample again after a quarter of a deadband of expected change
+#define ADAPTIVE_SURPRISE_SIGMAS 3.0f   // Off-trend beyond band + 3 sigma: sample as fast as allowed
+#define ADAPTIVE_RATE_SMOOTHING 0.1f    // EWMA weight of one interval in the effective rate
+
+struct AdaptiveBounds {
+  uint32_t minIntervalMs;
+  uint32_t maxIntervalMs;
+  uint32_t uplinkSamples;  // Uplink interval in sampling intervals...
+  uint32_t minUplinkMs;    // ...but within these bounds
+  uint32_t maxUplinkMs;
+};
+
+/* DHT11 answers at most once a second; a stable room is read once a minute */
+constexpr AdaptiveBounds CONTINUOUS_RATE_BOUNDS = { 2000, 60000, 4, 10000, 600000 };
+
+/*
+ * No constructor on purpose, like DeadbandFilter: zero-initialized means
+ * defaults (CONTINUOUS_RATE_BOUNDS and DEFAULT_DEADBANDS), so it can sit in
+ * RTC memory in deep sleep.
+ */
+class AdaptiveRate {
+ public:
+  void setBounds(const AdaptiveBounds& bounds);
+  void setBand(ReadingChannel channel, Deadband band);
+
+  /* Feeds one reading (capturedAtMs must increase), returns the interval until the next one */
+  uint32_t update(const Reading& reading);
+
+  uint32_t intervalMs() const;
+  uint32_t uplinkIntervalMs() const;
+
+  /* Channel that set the current interval, READING_CHANNELS when all are flat */
+  ReadingChannel drivingChannel() const { return driver; }
+
+  /* Samples per minute actually taken, smoothed over the last ~10 intervals */
+  float samplesPerMinute() const;
+
+  uint32_t sampleCount() const { return samples; }
+  uint32_t surpriseCount() const { return surprises; }
+
+ private:
+  struct Fit {
+    float slope;      // Units per second
+    float slopeError;
+    float sigma;      // Residual standard deviation
+    float intercept;  // Value at the newest sample time
+  };
+
+  void applyDefaults();
+  bool fit(int channel, Fit& result) const;
+  float bandFor(int channel, float value) const;
+
+  bool configured;
+  AdaptiveBounds limits;
+  Deadband bands[READING_CHANNELS];
+  uint32_t times[ADAPTIVE_WINDOW];
+  float values[ADAPTIVE_WINDOW][READING_CHANNELS];
+  uint8_t head;
+  uint8_t count;
+  uint32_t interval;
+  ReadingChannel driver;
+  float averageIntervalMs;
+  uint32_t samples;
+  uint32_t surprises;
+};
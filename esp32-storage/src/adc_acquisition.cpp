@@ -0,0 +1,144 @@
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "adc_acquisition.h"
+#include "adc_filter.h"
+#include "log.h"
+
+#define ADC_RESULT_BYTES 2  // adc_digi_output_data_t, TYPE1 format on the ESP32
+
+static adc1_channel_t channels[ADC_MAX_CHANNELS];
+static size_t channelCount = 0;
+static bool configured = false;
+static AdcFilter filters[ADC_MAX_CHANNELS];
+static uint8_t dmaBuffer[ADC_BURST_SAMPLES * ADC_RESULT_BYTES];
+static uint16_t codes[ADC_MAX_CHANNELS][ADC_BURST_SAMPLES];
+static uint32_t overruns = 0;
+
+/* Published by the burst, read by the sampler */
+static portMUX_TYPE snapshotLock = portMUX_INITIALIZER_UNLOCKED;
+static AdcSnapshot snapshots[ADC_MAX_CHANNELS] = {};
+
+bool beginAdcAcquisition(const uint8_t* pins, size_t count) {
+  if (count == 0 || count > ADC_MAX_CHANNELS) {
+    return false;
+  }
+  uint32_t mask = 0;
+  for (size_t i = 0; i < count; i++) {
+    int8_t index = digitalPinToAnalogChannel(pins[i]);
+    if (index < 0 || index >= ADC1_CHANNEL_MAX) {
+      logError("❌ GPIO %u is not an ADC1 pin, DMA sampling unavailable\n", pins[i]);
+      return false;
+    }
+    channels[i] = (adc1_channel_t)index;
+    mask |= 1 << index;
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = sizeof(dmaBuffer) * 2;
+  init.conv_num_each_intr = sizeof(dmaBuffer);
+  init.adc1_chan_mask = mask;
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    return false;
+  }
+
+  // Same 11 dB attenuation as analogRead(), so codes match the gas table
+  static adc_digi_pattern_config_t pattern[ADC_MAX_CHANNELS] = {};
+  for (size_t i = 0; i < count; i++) {
+    pattern[i].atten = ADC_ATTEN_DB_11;
+    pattern[i].channel = channels[i];
+    pattern[i].unit = 0;  // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = true;  // Required on the ESP32
+  config.conv_limit_num = 250;
+  config.pattern_num = count;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = ADC_SAMPLE_RATE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&config) != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  channelCount = count;
+  configured = true;
+  return true;
+}
+
+bool acquireAdcBurst() {
+  if (!configured) {
+    return false;
+  }
+
+  size_t counts[ADC_MAX_CHANNELS] = {};
+  size_t full = 0;
+  adc_digi_start();
+  while (full < channelCount) {
+    uint32_t received = 0;
+    esp_err_t result = adc_digi_read_bytes(dmaBuffer, sizeof(dmaBuffer), &received, 100);
+    if (result == ESP_ERR_INVALID_STATE) {
+      overruns++;  // Old conversions were dropped, what we got is still usable
+    } else if (result != ESP_OK) {
+      break;
+    }
+    for (uint32_t i = 0; i + ADC_RESULT_BYTES <= received; i += ADC_RESULT_BYTES) {
+      const adc_digi_output_data_t* data = (const adc_digi_output_data_t*)&dmaBuffer[i];
+      for (size_t c = 0; c < channelCount; c++) {
+        if (data->type1.channel == channels[c] && counts[c] < ADC_BURST_SAMPLES) {
+          codes[c][counts[c]++] = data->type1.data;
+          full += counts[c] == ADC_BURST_SAMPLES;
+          break;
+        }
+      }
+    }
+  }
+  adc_digi_stop();
+
+  for (size_t c = 0; c < channelCount; c++) {
+    filters[c].add(codes[c], counts[c]);
+  }
+
+  portENTER_CRITICAL(&snapshotLock);
+  for (size_t c = 0; c < channelCount; c++) {
+    snapshots[c].valid = filters[c].ready();
+    snapshots[c].code = filters[c].value();
+    snapshots[c].noise = filters[c].noise();
+    snapshots[c].samples = filters[c].samples();
+    snapshots[c].overruns = overruns;
+  }
+  portEXIT_CRITICAL(&snapshotLock);
+  return full == channelCount;
+}
+
+static void adcTask(void* param) {
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    acquireAdcBurst();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ADC_BURST_INTERVAL_MS));
+  }
+}
+
+void startAdcAcquisition() {
+  if (!configured) {
+    return;
+  }
+  xTaskCreatePinnedToCore(adcTask, "adc", ADC_TASK_STACK_SIZE, nullptr,
+                          ADC_TASK_PRIORITY, nullptr, ADC_CORE);
+}
+
+AdcSnapshot getAdcSnapshot(size_t channel) {
+  AdcSnapshot copy = {};
+  if (channel >= channelCount) {
+    return copy;
+  }
+  portENTER_CRITICAL(&snapshotLock);
+  copy = snapshots[channel];
+  portEXIT_CRITICAL(&snapshotLock);
+  return copy;
+}
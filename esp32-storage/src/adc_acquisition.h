@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Background MQ135 acquisition in ADC continuous (DMA) mode.
+ *
+ * A low-priority task starts the ADC every ADC_BURST_INTERVAL_MS, lets the
+ * DMA collect ADC_BURST_SAMPLES codes per channel at ADC_SAMPLE_RATE_HZ
+ * (shared by the channels, the pattern takes them in turn), stops it and
+ * runs each channel's burst through its own AdcFilter. The sampler only
+ * copies the latest filtered codes, it never blocks on a conversion, and
+ * several gas probes never fight over the ADC with analogRead().
+ *
+ * Only ADC1 pins work: the DMA controller drives ADC1, and ADC2 is taken
+ * by WiFi anyway.
+ */
+
+#define ADC_SAMPLE_RATE_HZ 20000    // Lowest rate the ESP32 DMA mode supports
+#define ADC_BURST_SAMPLES 256       // Per channel, ~13 ms per burst and channel
+#define ADC_MAX_CHANNELS 4
+#define ADC_BURST_INTERVAL_MS 250   // 4 bursts per second, ~1000 codes per 5 s reading
+
+#define ADC_CORE APP_CPU_NUM
+#define ADC_TASK_PRIORITY 1         // Below the sampler
+#define ADC_TASK_STACK_SIZE 3072
+
+struct AdcSnapshot {
+  bool valid;        // False until the first burst went through the filter
+  float code;        // Filtered 12-bit code, fractional
+  float noise;       // Standard deviation of single raw codes
+  uint32_t samples;  // Raw codes filtered since start
+  uint32_t overruns; // Bursts where the DMA buffer overflowed
+};
+
+/* Configures DMA sampling of up to ADC_MAX_CHANNELS ADC1 pins, false if a pin or the driver cannot do it */
+bool beginAdcAcquisition(const uint8_t* pins, size_t count);
+
+/* Runs bursts in a background task */
+void startAdcAcquisition();
+
+/* Takes one burst on the calling task, for wakes that do not start the task */
+bool acquireAdcBurst();
+
+/* Latest filtered code of the channel, in the order the pins were given */
+AdcSnapshot getAdcSnapshot(size_t channel = 0);
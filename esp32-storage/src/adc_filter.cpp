@@ -0,0 +1,66 @@
+#include <string.h>
+#include "adc_filter.h"
+
+AdcFilter::AdcFilter(float alpha) : alpha(alpha) {
+  reset();
+}
+
+void AdcFilter::reset() {
+  memset(window, 0, sizeof(window));
+  filled = 0;
+  primed = false;
+  smoothed = 0;
+  deviation = 0;
+  total = 0;
+}
+
+void AdcFilter::add(uint16_t code) {
+  window[filled++] = code;
+  total++;
+  if (filled == ADC_MEDIAN_WINDOW) {
+    filterWindow();
+    filled = 0;
+  }
+}
+
+void AdcFilter::add(const uint16_t* codes, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    add(codes[i]);
+  }
+}
+
+/* Insertion sort, 9 elements are too few for anything smarter */
+static void sortWindow(uint16_t* values) {
+  for (int i = 1; i < ADC_MEDIAN_WINDOW; i++) {
+    uint16_t value = values[i];
+    int j = i - 1;
+    while (j >= 0 && values[j] > value) {
+      values[j + 1] = values[j];
+      j--;
+    }
+    values[j + 1] = value;
+  }
+}
+
+void AdcFilter::filterWindow() {
+  uint16_t sorted[ADC_MEDIAN_WINDOW];
+  memcpy(sorted, window, sizeof(sorted));
+  sortWindow(sorted);
+  uint16_t median = sorted[ADC_MEDIAN_WINDOW / 2];
+
+  // Median absolute deviation, scaled to a standard deviation for Gaussian noise
+  for (int i = 0; i < ADC_MEDIAN_WINDOW; i++) {
+    sorted[i] = window[i] > median ? window[i] - median : median - window[i];
+  }
+  sortWindow(sorted);
+  float spread = 1.4826f * sorted[ADC_MEDIAN_WINDOW / 2];
+
+  if (!primed) {
+    smoothed = median;
+    deviation = spread;
+    primed = true;
+    return;
+  }
+  smoothed += alpha * (median - smoothed);
+  deviation += alpha * (spread - deviation);
+}
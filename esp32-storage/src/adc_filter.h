@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Median + IIR filter for bursts of raw ADC codes.
+ *
+ * Codes are taken in blocks of ADC_MEDIAN_WINDOW; the median of each block
+ * throws away spikes (WiFi TX bursts couple into the ADC), then a
+ * first-order IIR smooths the medians. The median absolute deviation of
+ * each block gives a noise estimate that spikes do not inflate.
+ *
+ * Hardware independent, so recorded ADC traces can be replayed on a PC.
+ */
+
+#define ADC_MEDIAN_WINDOW 9     // Odd, so the median is one of the samples
+#define ADC_IIR_ALPHA 0.05f     // Weight of each new median, ~20 medians time constant
+
+class AdcFilter {
+ public:
+  explicit AdcFilter(float alpha = ADC_IIR_ALPHA);
+
+  void add(uint16_t code);
+  void add(const uint16_t* codes, size_t count);
+
+  /* False until the first full median window */
+  bool ready() const { return primed; }
+
+  /* Filtered code, fractional */
+  float value() const { return smoothed; }
+
+  /* Standard deviation of single raw codes, in codes */
+  float noise() const { return deviation; }
+
+  uint32_t samples() const { return total; }
+  void reset();
+
+ private:
+  void filterWindow();
+
+  float alpha;
+  uint16_t window[ADC_MEDIAN_WINDOW];
+  uint8_t filled;
+  bool primed;
+  float smoothed;
+  float deviation;
+  uint32_t total;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Bump allocator over a fixed static buffer, handed to JsonDocument so
+ * building a payload never touches the heap. Blocks are never freed one
+ * by one; reset() reclaims the whole arena once the document is gone.
+ */
+template <size_t Size>
+class ArenaAllocator : public ArduinoJson::Allocator {
+ public:
+  ArenaAllocator() : used(0), last(nullptr), peak(0), failures(0) {}
+
+  void* allocate(size_t size) override {
+    size_t needed = align(sizeof(BlockHeader) + size);
+    if (used + needed > Size) {
+      failures++;
+      return nullptr;
+    }
+    BlockHeader* header = (BlockHeader*)(buffer + used);
+    header->size = size;
+    used += needed;
+    if (used > peak) {
+      peak = used;
+    }
+    last = header + 1;
+    return last;
+  }
+
+  void deallocate(void*) override {
+    // Reclaimed by reset()
+  }
+
+  void* reallocate(void* ptr, size_t newSize) override {
+    if (ptr == nullptr) {
+      return allocate(newSize);
+    }
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+
+    if (ptr == last) {
+      // Most recent block: grow or shrink in place
+      size_t start = (uint8_t*)header - buffer;
+      size_t needed = align(sizeof(BlockHeader) + newSize);
+      if (start + needed > Size) {
+        failures++;
+        return nullptr;
+      }
+      header->size = newSize;
+      used = start + needed;
+      if (used > peak) {
+        peak = used;
+      }
+      return ptr;
+    }
+
+    void* moved = allocate(newSize);
+    if (moved != nullptr) {
+      memcpy(moved, ptr, header->size < newSize ? header->size : newSize);
+    }
+    return moved;
+  }
+
+  /* Only call once no JsonDocument uses the arena any more */
+  void reset() {
+    used = 0;
+    last = nullptr;
+  }
+
+  size_t peakUsage() const { return peak; }
+  uint32_t failedAllocations() const { return failures; }
+
+ private:
+  struct BlockHeader {
+    size_t size;
+    size_t padding;  // Keeps the payload 8-byte aligned on 32-bit targets
+  };
+
+  static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+
+  alignas(8) uint8_t buffer[Size];
+  size_t used;
+  void* last;
+  size_t peak;
+  uint32_t failures;
+};
@@ -0,0 +1,104 @@
+#include "circuit_breaker.h"
+
+#define BREAKER_MAX_EXPONENT 16  // 2^16 * base is past any sensible maxDelay
+
+void CircuitBreaker::configure(uint32_t baseDelayMs, uint32_t maxDelayMs, uint8_t failureThreshold, uint32_t seed) {
+  baseDelay = baseDelayMs;
+  maxDelay = maxDelayMs;
+  threshold = failureThreshold ? failureThreshold : 1;
+  if (random == 0) {
+    random = seed ? seed : 0x9E3779B9UL;  // Seeded once; xorshift must not start at 0
+  }
+}
+
+/* xorshift32, plenty for spreading retries */
+uint32_t CircuitBreaker::nextRandom() {
+  random ^= random << 13;
+  random ^= random >> 17;
+  random ^= random << 5;
+  return random;
+}
+
+bool CircuitBreaker::allow(uint32_t nowMs) {
+  switch (current) {
+    case BREAKER_CLOSED:
+      return true;
+    case BREAKER_OPEN:
+      if ((int32_t)(nowMs - openUntilMs) < 0) {
+        counters.rejected++;
+        return false;
+      }
+      current = BREAKER_HALF_OPEN;
+      counters.state = current;
+      probing = false;
+      // Fall through - this caller gets the probe
+    case BREAKER_HALF_OPEN:
+      if (probing) {
+        counters.rejected++;
+        return false;
+      }
+      probing = true;
+      counters.probes++;
+      return true;
+  }
+  return false;
+}
+
+void CircuitBreaker::recordIdle() {
+  probing = false;  // The probe slot was not used, the next allow() gets it
+}
+
+void CircuitBreaker::recordSuccess() {
+  current = BREAKER_CLOSED;
+  counters.state = current;
+  failures = 0;
+  attempt = 0;
+  probing = false;
+}
+
+void CircuitBreaker::recordFailure(uint32_t nowMs) {
+  if (current == BREAKER_HALF_OPEN) {
+    if (attempt < BREAKER_MAX_EXPONENT) {
+      attempt++;
+    }
+    open(nowMs);
+    return;
+  }
+
+  if (++failures >= threshold) {
+    failures = 0;
+    attempt = 0;
+    counters.opens++;
+    open(nowMs);
+  }
+}
+
+void CircuitBreaker::open(uint32_t nowMs) {
+  uint64_t ceiling = (uint64_t)baseDelay << attempt;
+  if (ceiling > maxDelay) {
+    ceiling = maxDelay;
+  }
+  uint32_t delayMs = ceiling ? nextRandom() % (uint32_t)(ceiling + 1) : 0;
+
+  current = BREAKER_OPEN;
+  probing = false;
+  openUntilMs = nowMs + delayMs;
+  counters.state = current;
+  counters.lastDelayMs = delayMs;
+}
+
+uint32_t CircuitBreaker::retryInMs(uint32_t nowMs) const {
+  if (current != BREAKER_OPEN || (int32_t)(nowMs - openUntilMs) >= 0) {
+    return 0;
+  }
+  return openUntilMs - nowMs;
+}
+
+const char* breakerStateName(BreakerState state) {
+  switch (state) {
+    case BREAKER_CLOSED: return "closed";
+    case BREAKER_OPEN: return "open";
+    case BREAKER_HALF_OPEN: return "half-open";
+  }
+  return "?";
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Circuit breaker for one uplink.
+ *
+ * CLOSED: requests go through; failureThreshold failures in a row open it.
+ * OPEN: nothing is sent until the retry delay runs out, the caller keeps
+ * buffering locally. Then one probe request is let through (HALF_OPEN):
+ * success closes the breaker, failure opens it again with a longer delay.
+ *
+ * Delays use exponential backoff with full jitter: uniformly random in
+ * [0, min(maxDelay, baseDelay * 2^attempt)]. Seeded per device, so a fleet
+ * that lost the backend at the same moment does not come back in lockstep.
+ *
+ * Hardware independent; time is passed in, the PRNG is internal.
+ */
+
+enum BreakerState {
+  BREAKER_CLOSED,
+  BREAKER_OPEN,
+  BREAKER_HALF_OPEN
+};
+
+struct BreakerStats {
+  BreakerState state;
+  uint32_t opens;         // CLOSED -> OPEN transitions
+  uint32_t probes;        // HALF_OPEN attempts
+  uint32_t rejected;      // allow() calls refused while open
+  uint32_t lastDelayMs;   // Jittered delay of the current/last open period
+};
+
+/*
+ * No constructor on purpose: it lives in the zero-initialized sink slots or
+ * RTC memory. configure() before use; calling it again keeps the state.
+ */
+class CircuitBreaker {
+ public:
+  void configure(uint32_t baseDelayMs, uint32_t maxDelayMs, uint8_t failureThreshold, uint32_t seed);
+
+  /* True if a request may be sent now; in HALF_OPEN only the one probe is allowed */
+  bool allow(uint32_t nowMs);
+
+  /* Outcome of an allowed request; recordIdle() when nothing was sent after all */
+  void recordSuccess();
+  void recordFailure(uint32_t nowMs);
+  void recordIdle();
+
+  BreakerState state() const { return current; }
+
+  /* Time left until the next probe, 0 unless open */
+  uint32_t retryInMs(uint32_t nowMs) const;
+
+  const BreakerStats& stats() const { return counters; }
+
+ private:
+  void open(uint32_t nowMs);
+  uint32_t nextRandom();
+
+  uint32_t baseDelay;
+  uint32_t maxDelay;
+  uint8_t threshold;
+  uint32_t random;
+  BreakerState current;
+  uint8_t failures;       // In a row while closed
+  uint8_t attempt;        // Backoff exponent, grows with every failed probe
+  bool probing;
+  uint32_t openUntilMs;
+  BreakerStats counters;
+};
+
+const char* breakerStateName(BreakerState state);
@@ -0,0 +1,76 @@
+#include <math.h>
+#include <string.h>
+#include "deadband.h"
+
+float readingChannel(const Reading& reading, ReadingChannel channel) {
+  switch (channel) {
+    case CHANNEL_TEMPERATURE: return reading.temperature;
+    case CHANNEL_HUMIDITY: return reading.humidity;
+    case CHANNEL_CO2: return reading.co2;
+    case CHANNEL_AMMONIA: return reading.ammonia;
+    case CHANNEL_METHANE: return reading.methane;
+    case CHANNEL_ETHYLENE: return reading.ethylene;
+    case CHANNEL_H2S: return reading.h2s;
+    default: return NAN;
+  }
+}
+
+void DeadbandFilter::applyDefaults() {
+  if (!configured) {
+    memcpy(bands, DEFAULT_DEADBANDS, sizeof(bands));
+    heartbeatMs = DEADBAND_HEARTBEAT_MS;
+    configured = true;
+  }
+}
+
+void DeadbandFilter::setBand(ReadingChannel channel, Deadband band) {
+  applyDefaults();
+  bands[channel] = band;
+}
+
+void DeadbandFilter::setHeartbeat(uint32_t intervalMs) {
+  applyDefaults();
+  heartbeatMs = intervalMs;
+}
+
+bool DeadbandFilter::admit(Reading& reading) {
+  applyDefaults();
+  bool heartbeat = haveLast && reading.capturedAtMs - last.capturedAtMs >= heartbeatMs;
+  if (haveLast && !heartbeat && !changed(reading)) {
+    pending++;
+    suppressedTotal++;
+    return false;
+  }
+
+  reading.suppressed = pending;
+  pending = 0;
+  last = reading;
+  haveLast = true;
+  admitted++;
+  return true;
+}
+
+bool DeadbandFilter::changed(const Reading& reading) const {
+  for (int i = 0; i < READING_CHANNELS; i++) {
+    ReadingChannel channel = (ReadingChannel)i;
+    float before = readingChannel(last, channel);
+    float now = readingChannel(reading, channel);
+
+    // A channel going to or from inf/NaN (saturated sensor, failed read) always counts
+    if (!isfinite(before) || !isfinite(now)) {
+      if (isfinite(before) != isfinite(now) || (isnan(before) != isnan(now))) {
+        return true;
+      }
+      continue;
+    }
+
+    float band = bands[i].relative * fabsf(before);
+    if (band < bands[i].absolute) {
+      band = bands[i].absolute;
+    }
+    if (fabsf(now - before) > band) {
+      return true;
+    }
+  }
+  return false;
+}
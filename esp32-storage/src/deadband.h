@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include "reading.h"
+
+/*
+ * Change-driven reporting.
+ *
+ * A reading is passed on only when some channel moved past its deadband
+ * since the last reading that was passed on, or when the heartbeat
+ * interval ran out so the backend still sees the device alive. Readings
+ * held back are counted into Reading::suppressed of the next one sent.
+ *
+ * Each deadband is max(absolute, relative * |last sent value|), so gas
+ * channels spanning decades get a sensible band at every level.
+ */
+
+#define DEADBAND_HEARTBEAT_MS 600000  // Send at least one reading every 10 minutes
+
+enum ReadingChannel {
+  CHANNEL_TEMPERATURE,
+  CHANNEL_HUMIDITY,
+  CHANNEL_CO2,
+  CHANNEL_AMMONIA,
+  CHANNEL_METHANE,
+  CHANNEL_ETHYLENE,
+  CHANNEL_H2S,
+  READING_CHANNELS
+};
+
+struct Deadband {
+  float absolute;
+  float relative;
+};
+
+/* Default bands: a one-step DHT11 flicker (1°C, 1%) is ignored, gases need 5% */
+constexpr Deadband DEFAULT_DEADBANDS[READING_CHANNELS] = {
+  { 1.0f, 0.0f },   // Temperature, °C
+  { 2.0f, 0.0f },   // Humidity, %
+  { 1.0f, 0.05f },  // CO2
+  { 1.0f, 0.05f },  // Ammonia
+  { 1.0f, 0.05f },  // Methane
+  { 1.0f, 0.05f },  // Ethylene
+  { 1.0f, 0.05f },  // H2S
+};
+
+float readingChannel(const Reading& reading, ReadingChannel channel);
+
+/*
+ * No constructor on purpose, like ReadingRing: zero-initialized static
+ * storage means "defaults", so it can sit in RTC memory in deep sleep.
+ */
+class DeadbandFilter {
+ public:
+  void setBand(ReadingChannel channel, Deadband band);
+  void setHeartbeat(uint32_t intervalMs);
+
+  /*
+   * True if the reading should be sent. In that case reading.suppressed is
+   * set to the number of readings held back since the previous one sent.
+   */
+  bool admit(Reading& reading);
+
+  uint32_t admittedCount() const { return admitted; }
+  uint32_t suppressedCount() const { return suppressedTotal; }
+
+ private:
+  bool changed(const Reading& reading) const;
+  void applyDefaults();
+
+  bool configured;
+  Deadband bands[READING_CHANNELS];
+  uint32_t heartbeatMs;
+  bool haveLast;
+  Reading last;
+  uint32_t pending;  // Held back since the last admitted reading
+  uint32_t admitted;
+  uint32_t suppressedTotal;
+};
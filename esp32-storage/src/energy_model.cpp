@@ -0,0 +1,52 @@
+#include "energy_model.h"
+
+const PowerProfile ESP32_WROOM_PROFILE = {
+  {
+    0.15f,   // POWER_SLEEP: ~10 uA ESP32 + ~140 uA DHT11 standby
+    45.0f,   // POWER_SAMPLE: CPU at 240 MHz, radio off
+    150.0f,  // POWER_HEATER: MQ135 heater coil at 5 V, referred to 3.3 V
+    120.0f,  // POWER_WIFI_CONNECT
+    160.0f   // POWER_UPLOAD: TX bursts
+  },
+  3.3f
+};
+
+uint64_t EnergyMeter::totalMs() const {
+  uint64_t total = 0;
+  for (int i = 0; i < POWER_PHASES; i++) {
+    total += phaseMs[i];
+  }
+  return total;
+}
+
+float EnergyMeter::milliampHours(const PowerProfile& profile) const {
+  double mAms = 0;
+  for (int i = 0; i < POWER_PHASES; i++) {
+    mAms += (double)phaseMs[i] * profile.currentMa[i];
+  }
+  return mAms / 3600000.0;
+}
+
+float EnergyMeter::averageCurrentMa(const PowerProfile& profile) const {
+  uint64_t total = totalMs();
+  if (total == 0) {
+    return 0;
+  }
+  return milliampHours(profile) * 3600000.0 / (double)total;
+}
+
+float EnergyMeter::millijoulesPerReading(const PowerProfile& profile) const {
+  if (readings == 0) {
+    return 0;
+  }
+  // mAh * V * 3.6 = J
+  return milliampHours(profile) * profile.supplyVolts * 3600.0f / readings;
+}
+
+float EnergyMeter::batteryDays(const PowerProfile& profile, float capacityMah) const {
+  float average = averageCurrentMa(profile);
+  if (average <= 0) {
+    return 0;
+  }
+  return capacityMah / average / 24.0f;
+}
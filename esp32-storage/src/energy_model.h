@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Energy accounting for the deep-sleep duty cycle.
+ *
+ * The firmware measures how long each wake spends in every phase and
+ * multiplies by the nominal supply current of that phase. The model is
+ * hardware independent, so the same numbers can be produced for a
+ * simulated schedule on a PC when sizing batteries.
+ */
+
+enum PowerPhase {
+  POWER_SLEEP,         // Deep sleep: RTC timer + RTC memory + idle sensors
+  POWER_SAMPLE,        // CPU awake, reading DHT11 / MQ135
+  POWER_HEATER,        // MQ135 heater warm-up (only when it is switched)
+  POWER_WIFI_CONNECT,  // Radio on, associating and getting an IP
+  POWER_UPLOAD,        // Radio on, sending the batch
+  POWER_PHASES
+};
+
+/* Nominal current per phase in mA, bare ESP32-WROOM module at 3.3 V */
+struct PowerProfile {
+  float currentMa[POWER_PHASES];
+  float supplyVolts;
+};
+
+extern const PowerProfile ESP32_WROOM_PROFILE;
+
+/*
+ * Accumulated time per phase. Plain data with no constructor, so it can
+ * sit in RTC memory and keep counting across deep sleep cycles.
+ */
+struct EnergyMeter {
+  uint64_t phaseMs[POWER_PHASES];
+  uint32_t readings;
+
+  void add(PowerPhase phase, uint32_t durationMs) { phaseMs[phase] += durationMs; }
+  void countReading() { readings++; }
+
+  uint64_t totalMs() const;
+  float milliampHours(const PowerProfile& profile) const;
+  float averageCurrentMa(const PowerProfile& profile) const;
+  float millijoulesPerReading(const PowerProfile& profile) const;
+
+  /* Runtime on a battery of the given capacity at the measured average current */
+  float batteryDays(const PowerProfile& profile, float capacityMah) const;
+};
@@ -0,0 +1,70 @@
+#include <WiFi.h>
+#include <Preferences.h>
+#include <string.h>
+#include "esp32_wifi.h"
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_NVS_KEY "cache"
+
+Esp32WifiRadio::Esp32WifiRadio(const char* ssid, const char* password)
+    : ssid(ssid), password(password) {}
+
+void Esp32WifiRadio::join(const WifiCache* cache) {
+  WiFi.persistent(false);         // The SDK would otherwise rewrite its own flash copy on every join
+  WiFi.setAutoReconnect(false);   // Reconnects are driven by WifiLink
+  WiFi.mode(WIFI_STA);
+
+  if (cache == nullptr) {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+    WiFi.begin(ssid, password);
+    return;
+  }
+
+#if WIFI_CACHE_IP
+  WiFi.config(IPAddress(cache->ip), IPAddress(cache->gateway), IPAddress(cache->subnet), IPAddress(cache->dns));
+#endif
+  WiFi.begin(ssid, password, cache->channel, cache->bssid, true);
+}
+
+bool Esp32WifiRadio::connected() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+bool Esp32WifiRadio::current(WifiCache& cache) {
+  uint8_t* bssid = WiFi.BSSID();
+  if (!connected() || bssid == nullptr) {
+    return false;
+  }
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.ip = WiFi.localIP();
+  cache.gateway = WiFi.gatewayIP();
+  cache.subnet = WiFi.subnetMask();
+  cache.dns = WiFi.dnsIP(0);
+  return true;
+}
+
+void Esp32WifiRadio::cancel() {
+  WiFi.disconnect();
+}
+
+bool NvsWifiCache::load(WifiCache& cache) {
+  Preferences preferences;
+  if (!preferences.begin(WIFI_NVS_NAMESPACE, true)) {
+    return false;
+  }
+  bool loaded = preferences.getBytesLength(WIFI_NVS_KEY) == sizeof(cache) &&
+                preferences.getBytes(WIFI_NVS_KEY, &cache, sizeof(cache)) == sizeof(cache);
+  preferences.end();
+  return loaded;
+}
+
+bool NvsWifiCache::save(const WifiCache& cache) {
+  Preferences preferences;
+  if (!preferences.begin(WIFI_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  bool saved = preferences.putBytes(WIFI_NVS_KEY, &cache, sizeof(cache)) == sizeof(cache);
+  preferences.end();
+  return saved;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "wifi_link.h"
+
+/* Set to 0 if the router does not keep handing out the same address */
+#ifndef WIFI_CACHE_IP
+#define WIFI_CACHE_IP 1
+#endif
+
+/* WifiRadio over the Arduino WiFi station interface */
+class Esp32WifiRadio : public WifiRadio {
+ public:
+  Esp32WifiRadio(const char* ssid, const char* password);
+
+  void join(const WifiCache* cache) override;
+  bool connected() override;
+  bool current(WifiCache& cache) override;
+  void cancel() override;
+
+ private:
+  const char* ssid;
+  const char* password;
+};
+
+/* WifiCacheStore in NVS, survives reboots and deep sleep */
+class NvsWifiCache : public WifiCacheStore {
+ public:
+  bool load(WifiCache& cache) override;
+  bool save(const WifiCache& cache) override;
+};
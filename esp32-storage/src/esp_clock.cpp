@@ -0,0 +1,118 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/time.h>
+#include "esp_clock.h"
+#include "power_profile.h"
+#include "log.h"
+
+RETAINED static uint64_t sleptMs = 0;       // Time spent in deep sleep since power-on
+RETAINED static uint64_t sleepStartedMs = 0;  // RTC time when the last deep sleep began
+RETAINED static EpochClock epochClock;
+
+/* SNTP calls back on the lwIP task, the sampler reads on another core */
+static portMUX_TYPE epochLock = portMUX_INITIALIZER_UNLOCKED;
+
+static void wakeWaiter(void* task) {
+  xTaskNotifyGive((TaskHandle_t)task);
+}
+
+uint64_t EspTimerClock::nowUs() {
+  return esp_timer_get_time();
+}
+
+void EspTimerClock::sleepUntilUs(uint64_t deadlineUs) {
+  int64_t remaining = (int64_t)(deadlineUs - nowUs());
+  if (remaining <= 0) {
+    return;
+  }
+
+  // Created on first use, by the task that will always be the one waiting
+  if (timer == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback = wakeWaiter;
+    args.arg = xTaskGetCurrentTaskHandle();
+    args.name = "sample";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+      timer = nullptr;
+      vTaskDelay(pdMS_TO_TICKS(remaining / 1000));
+      return;
+    }
+  }
+
+  ulTaskNotifyTake(pdTRUE, 0);  // Drop a stale notification
+  esp_timer_start_once(timer, remaining);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+uint64_t monotonicMs() {
+  return sleptMs + esp_timer_get_time() / 1000;
+}
+
+/* The RTC keeps counting through deep sleep; SNTP only steps it while awake, before these calls */
+static uint64_t rtcMs() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+void beginSleepClock() {
+  // esp_timer restarts at 0 on every wake, so the awake part is banked as well
+  sleptMs += esp_timer_get_time() / 1000;
+  sleepStartedMs = rtcMs();
+}
+
+uint32_t resumeSleepClock() {
+  if (sleepStartedMs == 0) {
+    return 0;
+  }
+  uint64_t awake = esp_timer_get_time() / 1000;
+  uint64_t elapsed = rtcMs() - sleepStartedMs;
+  sleepStartedMs = 0;
+
+  uint64_t asleep = elapsed > awake ? elapsed - awake : 0;
+  sleptMs += asleep;
+  return (uint32_t)asleep;
+}
+
+static void onTimeSync(struct timeval* tv) {
+  uint64_t epochMs = (uint64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000;
+  uint64_t now = monotonicMs();
+  portENTER_CRITICAL(&epochLock);
+  epochClock.sync(epochMs, now);
+  portEXIT_CRITICAL(&epochLock);
+}
+
+void startTimeSync() {
+  static bool started = false;
+  if (started) {
+    return;  // SNTP keeps resyncing on its own (every hour by default)
+  }
+  started = true;
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  configTime(0, 0, SNTP_SERVER_1, SNTP_SERVER_2);  // UTC, the backend stores UTC
+}
+
+uint64_t epochMsAt(uint64_t monotonic) {
+  portENTER_CRITICAL(&epochLock);
+  uint64_t epochMs = epochClock.toEpochMs(monotonic);
+  portEXIT_CRITICAL(&epochLock);
+  return epochMs;
+}
+
+uint32_t timeSyncCount() {
+  portENTER_CRITICAL(&epochLock);
+  uint32_t syncs = epochClock.syncCount();
+  portEXIT_CRITICAL(&epochLock);
+  return syncs;
+}
+
+void printClockStats() {
+  portENTER_CRITICAL(&epochLock);
+  EpochClock copy = epochClock;
+  portEXIT_CRITICAL(&epochLock);
+  logInfo("🕒 Clock: %u SNTP syncs, last correction %dms, drift %.1f ppm\n",
+            copy.syncCount(), copy.lastCorrectionMs(), copy.driftPpm());
+}
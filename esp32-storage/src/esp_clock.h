@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <esp_timer.h>
+#include "sample_clock.h"
+
+/*
+ * Device side of sample_clock.h.
+ *
+ * monotonicMs() counts from power-on and, in the deep sleep profile, keeps
+ * counting through sleep (the slept time is added from RTC memory). The
+ * epoch clock is disciplined by SNTP once WiFi is up.
+ */
+
+#define SNTP_SERVER_1 "pool.ntp.org"
+#define SNTP_SERVER_2 "time.google.com"
+
+/*
+ * MonotonicClock over esp_timer, sleeping on a one-shot timer and a task
+ * notification. Only one task may sleep on an instance.
+ */
+class EspTimerClock : public MonotonicClock {
+ public:
+  uint64_t nowUs() override;
+  void sleepUntilUs(uint64_t deadlineUs) override;
+
+ private:
+  esp_timer_handle_t timer = nullptr;
+};
+
+uint64_t monotonicMs();
+
+/* Deep sleep: call right before esp_deep_sleep_start()... */
+void beginSleepClock();
+
+/* ...and first thing after a timer wake, returns the ms actually slept */
+uint32_t resumeSleepClock();
+
+/* Starts SNTP, safe to call on every (re)connect */
+void startTimeSync();
+
+/* Wall-clock ms of a monotonicMs() timestamp, 0 until the first SNTP sync */
+uint64_t epochMsAt(uint64_t monotonic);
+
+uint32_t timeSyncCount();
+void printClockStats();
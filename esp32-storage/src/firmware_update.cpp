@@ -0,0 +1,58 @@
+#include "firmware_update.h"
+
+bool PartitionSource::read(uint32_t offset, uint8_t* data, size_t length) {
+  return offset + length <= partition->size && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+bool OtaTarget::open(uint32_t size) {
+  if (size > partition->size) {
+    error = ESP_FAIL;
+    return false;
+  }
+  error = esp_ota_begin(partition, size, &handle);
+  opened = error == ESP_OK;
+  return opened;
+}
+
+bool OtaTarget::write(const uint8_t* data, size_t length) {
+  error = esp_ota_write(handle, data, length);
+  return error == ESP_OK;
+}
+
+bool FirmwareUpdate::begin() {
+  source.partition = esp_ota_get_running_partition();
+  target.partition = esp_ota_get_next_update_partition(nullptr);
+  target.opened = false;
+  target.error = ESP_OK;
+  if (source.partition == nullptr || target.partition == nullptr || target.partition == source.partition) {
+    target.error = ESP_FAIL;
+    return false;
+  }
+  patcher.begin(source, target);
+  return true;
+}
+
+bool FirmwareUpdate::write(const uint8_t* data, size_t length) {
+  DeltaStatus status = patcher.write(data, length);
+  return status == DELTA_MORE || status == DELTA_DONE;
+}
+
+bool FirmwareUpdate::finish() {
+  if (patcher.finish() != DELTA_DONE) {
+    abort();
+    return false;
+  }
+  target.opened = false;
+  target.error = esp_ota_end(target.handle);  // Frees the handle whatever it returns
+  if (target.error == ESP_OK) {
+    target.error = esp_ota_set_boot_partition(target.partition);
+  }
+  return target.error == ESP_OK;
+}
+
+void FirmwareUpdate::abort() {
+  if (target.opened) {
+    esp_ota_abort(target.handle);
+    target.opened = false;
+  }
+}
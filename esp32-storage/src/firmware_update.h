@@ -0,0 +1,61 @@
+#pragma once
+
+#include <esp_ota_ops.h>
+#include "delta_patch.h"
+#include "http_uplink.h"
+
+/*
+ * Delta firmware update into the inactive OTA slot.
+ *
+ * The patch is applied while it downloads: the running app partition is
+ * the source and every finished block goes straight to esp_ota_write(),
+ * so RAM only holds the patcher's two small buffers. The slot is switched
+ * only after the target CRC matched and esp_ota_end() validated the image
+ * (checksum and appended SHA-256); anything else aborts the slot and the
+ * running firmware keeps booting.
+ */
+
+/* The running app partition, read through the flash cache */
+class PartitionSource : public DeltaSource {
+ public:
+  const esp_partition_t* partition;
+  bool read(uint32_t offset, uint8_t* data, size_t length) override;
+};
+
+/* The next OTA slot, erased by esp_ota_begin() once the source checked out */
+class OtaTarget : public DeltaTarget {
+ public:
+  const esp_partition_t* partition;
+  esp_ota_handle_t handle;
+  bool opened;
+  esp_err_t error;
+
+  bool open(uint32_t size) override;
+  bool write(const uint8_t* data, size_t length) override;
+};
+
+class FirmwareUpdate : public HttpBodySink {
+ public:
+  /* Picks the partitions, false if the partition table has no second app slot */
+  bool begin();
+
+  /* Patch bytes from the download */
+  bool write(const uint8_t* data, size_t length) override;
+
+  /* After the download: validates the image and makes it the boot partition */
+  bool finish();
+
+  /* Drops a partly written slot */
+  void abort();
+
+  DeltaStatus status() const { return patcher.status(); }
+  esp_err_t error() const { return target.error; }
+  const char* slot() const { return target.partition != nullptr ? target.partition->label : "-"; }
+  uint32_t written() const { return patcher.written(); }
+  uint32_t patchBytes() const { return patcher.patchBytes(); }
+
+ private:
+  PartitionSource source;
+  OtaTarget target;
+  DeltaPatcher patcher;
+};
@@ -0,0 +1,101 @@
+#include <math.h>
+#include "gas_detector.h"
+#include "deadband.h"
+
+float gasReading(const Reading& reading, GasChannel channel) {
+  // Gas channels follow temperature and humidity in ReadingChannel order
+  return readingChannel(reading, (ReadingChannel)(CHANNEL_CO2 + channel));
+}
+
+const char* gasChannelName(GasChannel channel) {
+  switch (channel) {
+    case GAS_CO2: return "CO2";
+    case GAS_AMMONIA: return "ammonia";
+    case GAS_METHANE: return "methane";
+    case GAS_ETHYLENE: return "ethylene";
+    case GAS_H2S: return "H2S";
+    default: return "?";
+  }
+}
+
+uint8_t GasDetector::update(const Reading& reading) {
+  uint32_t dtMs = haveLast ? reading.capturedAtMs - lastMs : 0;
+  lastMs = reading.capturedAtMs;
+  haveLast = true;
+
+  uint8_t tripped = 0;
+  for (int i = 0; i < GAS_CHANNELS; i++) {
+    if (updateChannel(channels[i], gasReading(reading, (GasChannel)i), dtMs, reading.capturedAtMs)) {
+      tripped |= 1 << i;
+      trips++;
+    }
+  }
+  return tripped;
+}
+
+float GasDetector::baselinePpm(GasChannel channel) const {
+  return channels[channel].samples > 0 ? expf(channels[channel].mean) : NAN;
+}
+
+bool GasDetector::updateChannel(GasChannelState& state, float ppm, uint32_t dtMs, uint32_t nowMs) {
+  if (!isfinite(ppm) || ppm <= 0) {
+    return false;  // Failed or saturated read, says nothing about the trend
+  }
+  float y = logf(ppm);
+
+  if (state.samples == 0) {
+    state.mean = y;
+    state.variance = 0;
+    state.samples = 1;
+    return false;
+  }
+
+  float sigma = sqrtf(state.variance);
+  if (sigma < DETECTOR_SIGMA_FLOOR) {
+    sigma = DETECTOR_SIGMA_FLOOR;
+  }
+  float z = (y - state.mean) / sigma;
+  bool armed = state.samples >= DETECTOR_WARMUP_SAMPLES;
+
+  bool tripped = false;
+  if (armed) {
+    state.cusum += z - DETECTOR_ALLOWANCE;
+    if (state.cusum < 0) {
+      state.cusum = 0;
+    }
+
+    if (state.alarmed) {
+      state.clearRun = z < 1.0f ? state.clearRun + 1 : 0;
+      if (state.clearRun >= DETECTOR_CLEAR_SAMPLES || nowMs - state.alarmedAtMs >= DETECTOR_REARM_MS) {
+        // Back to normal, or the new normal: start over from the current level
+        state.alarmed = false;
+        state.cusum = 0;
+        state.mean = y;
+      }
+    } else if (state.cusum > DETECTOR_THRESHOLD) {
+      state.alarmed = true;
+      state.alarmedAtMs = nowMs;
+      state.clearRun = 0;
+      tripped = true;
+    }
+  }
+
+  // Winsorized: a reading far above the baseline moves it by DETECTOR_CLIP_SIGMAS at most
+  if (!state.alarmed) {
+    float alpha = 1.0f - expf(-(float)dtMs / DETECTOR_BASELINE_TAU_MS);
+    if (!armed && alpha < 1.0f / (state.samples + 1)) {
+      alpha = 1.0f / (state.samples + 1);  // Warm-up converges like a plain average
+    }
+    float diff = y - state.mean;
+    if (armed && fabsf(diff) > DETECTOR_CLIP_SIGMAS * sigma) {
+      diff = diff > 0 ? DETECTOR_CLIP_SIGMAS * sigma : -DETECTOR_CLIP_SIGMAS * sigma;
+    }
+    float increment = alpha * diff;
+    state.mean += increment;
+    state.variance = (1.0f - alpha) * (state.variance + diff * increment);
+  }
+  if (state.samples < DETECTOR_WARMUP_SAMPLES) {
+    state.samples++;
+  }
+  return tripped;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include "reading.h"
+#include "gas_table.h"
+
+/*
+ * Spoilage onset detection on the device, one detector per gas channel.
+ *
+ * Each channel is tracked in log space (gases span decades, a 2x rise is
+ * the same step at 5 or 500 ppm) against an EWMA baseline and EWMA
+ * variance with a time constant of DETECTOR_BASELINE_TAU_MS, so the
+ * baseline follows slow drift whatever the sampling interval. The
+ * standardized residual feeds a one-sided upper CUSUM:
+ *
+ *   S = max(0, S + z - k)    trips when S > h
+ *
+ * A sustained rise of d sigmas per sample trips within h / (d - k)
+ * samples, a jump of several sigmas on the next sample. Baseline updates
+ * are clipped to DETECTOR_CLIP_SIGMAS, so a rising channel can only drag
+ * it along slowly while the variance still sees the whole noise band
+ * (freezing it on every excursion underestimates the noise and trips on
+ * slow daily swings).
+ *
+ * A tripped channel stays alarmed (no repeated alerts) until it falls back
+ * within a sigma of the baseline, or DETECTOR_REARM_MS later adopts the new
+ * level as baseline, after which a further rise alerts again.
+ *
+ * Hardware independent; no constructor, so it can sit in RTC memory.
+ */
+
+#define DETECTOR_BASELINE_TAU_MS 1800000  // Baseline follows changes slower than ~30 minutes
+#define DETECTOR_SIGMA_FLOOR 0.02f        // Log units: noise below 2% is not trusted
+#define DETECTOR_ALLOWANCE 1.0f           // k, sigmas per sample tolerated as noise and drift
+#define DETECTOR_THRESHOLD 10.0f          // h, sigmas
+#define DETECTOR_CLIP_SIGMAS 3.0f         // Largest baseline step per reading
+#define DETECTOR_WARMUP_SAMPLES 12        // Baseline readings before a channel is armed
+#define DETECTOR_CLEAR_SAMPLES 6          // Readings back near the baseline that clear an alarm
+#define DETECTOR_REARM_MS 3600000         // An alarm older than this re-baselines on the current level
+#define DETECTOR_CRITICAL_RATIO 2.0f      // Alerts at twice the baseline or more are critical
+
+struct GasChannelState {
+  float mean;       // EWMA of log(ppm)
+  float variance;   // EWMA variance of log(ppm)
+  float cusum;      // S, in sigmas
+  uint32_t samples;  // Counts up to DETECTOR_WARMUP_SAMPLES
+  uint8_t clearRun; // Consecutive readings near the baseline while alarmed
+  bool alarmed;
+  uint32_t alarmedAtMs;
+};
+
+class GasDetector {
+ public:
+  /* Feeds one reading, returns a bit per GasChannel that tripped on it */
+  uint8_t update(const Reading& reading);
+
+  bool alarmed(GasChannel channel) const { return channels[channel].alarmed; }
+  float statistic(GasChannel channel) const { return channels[channel].cusum; }
+  float baselinePpm(GasChannel channel) const;
+  uint32_t tripCount() const { return trips; }
+
+ private:
+  bool updateChannel(GasChannelState& state, float ppm, uint32_t dtMs, uint32_t nowMs);
+
+  bool haveLast;
+  uint32_t lastMs;
+  GasChannelState channels[GAS_CHANNELS];
+  uint32_t trips;
+};
+
+/* Reading value of a gas channel */
+float gasReading(const Reading& reading, GasChannel channel);
+const char* gasChannelName(GasChannel channel);
@@ -0,0 +1,107 @@
+#include <math.h>
+#include "gas_table.h"
+
+/* Just enough constexpr math to build the table, accurate to double precision */
+namespace {
+
+constexpr double LN2 = 0.693147180559945309417;
+
+constexpr double constLog(double x) {
+  // x = m * 2^k with m in [1, 2), then ln(m) = 2 * atanh((m - 1) / (m + 1))
+  int k = 0;
+  while (x >= 2.0) { x /= 2.0; k++; }
+  while (x < 1.0) { x *= 2.0; k--; }
+  double t = (x - 1.0) / (x + 1.0);
+  double t2 = t * t;
+  double term = t;
+  double sum = 0.0;
+  for (int n = 1; n < 60; n += 2) {
+    sum += term / n;
+    term *= t2;
+  }
+  return 2.0 * sum + k * LN2;
+}
+
+constexpr double constExp(double y) {
+  // e^y = 2^k * e^r with |r| <= ln2 / 2
+  int k = (int)(y / LN2 + (y < 0 ? -0.5 : 0.5));
+  double r = y - k * LN2;
+  double term = 1.0;
+  double sum = 1.0;
+  for (int n = 1; n < 25; n++) {
+    term *= r / n;
+    sum += term;
+  }
+  for (; k > 0; k--) sum *= 2.0;
+  for (; k < 0; k++) sum /= 2.0;
+  return sum;
+}
+
+struct GasTable {
+  float ppm[ADC_CODES][GAS_CHANNELS];
+
+  constexpr GasTable() : ppm() {
+    for (int code = 0; code < ADC_CODES; code++) {
+      for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+        const GasCurve& curve = GAS_CURVES[gas];
+        if (code == 0) {
+          ppm[code][gas] = 0.0f;  // No current through the sensor: ratio -> infinity
+        } else {
+          // A saturated ADC would mean Rs = 0, report it like the last finite code
+          int finite = code < ADC_CODES - 1 ? code : ADC_CODES - 2;
+          double ratio = MQ135_RL * (ADC_CODES - 1 - finite) / finite / MQ135_R0;
+          ppm[code][gas] = curve.a * GAS_SCALE * constExp(curve.b * constLog(ratio));
+        }
+      }
+    }
+  }
+};
+
+// Lives in flash (80 KB), computed by the compiler
+constexpr GasTable GAS_TABLE;
+
+}  // namespace
+
+void gasPpmFromCode(uint16_t code, float ppm[GAS_CHANNELS]) {
+  if (code >= ADC_CODES) {
+    code = ADC_CODES - 1;
+  }
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    ppm[gas] = GAS_TABLE.ppm[code][gas];
+  }
+}
+
+GasCalibration::GasCalibration() {
+  setR0(MQ135_R0);
+}
+
+void GasCalibration::setR0(float r0) {
+  resistance = r0;
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    factor[gas] = pow(MQ135_R0 / r0, GAS_CURVES[gas].b);
+  }
+}
+
+void GasCalibration::convert(float code, float ppm[GAS_CHANNELS]) const {
+  if (!(code > 0.0f)) {
+    code = 0.0f;  // Also catches NaN
+  }
+  if (code >= ADC_CODES - 1) {
+    code = ADC_CODES - 1;
+  }
+
+  int low = (int)code;
+  float t = code - low;
+  const float* lower = GAS_TABLE.ppm[low];
+  if (t == 0.0f) {
+    for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+      ppm[gas] = lower[gas] * factor[gas];
+    }
+    return;
+  }
+
+  const float* upper = GAS_TABLE.ppm[low + 1];
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    ppm[gas] = (lower[gas] + (upper[gas] - lower[gas]) * t) * factor[gas];
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * MQ135 ADC code to gas concentration without pow() at runtime.
+ *
+ * ppm = a * (Rs / R0)^b * GAS_SCALE with Rs = RL * (4095 - code) / code,
+ * evaluated at compile time for every 12-bit code and all five curves.
+ * A runtime R0 only rescales each curve by (MQ135_R0 / R0)^b, so
+ * calibration costs five pow() calls once instead of five per sample.
+ */
+
+#define ADC_CODES 4096      // 12-bit ESP32 ADC
+#define MQ135_RL 10.0       // Load resistor, kOhm
+#define MQ135_R0 29.0       // Sensor resistance in clean air the table is built for, kOhm
+#define GAS_SCALE 100.0     // Scaling factor applied to every gas value
+
+enum GasChannel {
+  GAS_CO2,
+  GAS_AMMONIA,
+  GAS_METHANE,
+  GAS_ETHYLENE,
+  GAS_H2S,
+  GAS_CHANNELS
+};
+
+/* ppm = a * ratio^b */
+struct GasCurve {
+  double a;
+  double b;
+};
+
+constexpr GasCurve GAS_CURVES[GAS_CHANNELS] = {
+  { 116.6, -2.77 },   // CO2
+  { 102.2, -2.473 },  // Ammonia
+  { 50.0, -2.3 },     // Methane
+  { 70.0, -2.5 },     // Ethylene
+  { 40.0, -2.1 },     // H2S
+};
+
+/* Exact table lookup for the compile-time R0 */
+void gasPpmFromCode(uint16_t code, float ppm[GAS_CHANNELS]);
+
+/*
+ * Conversion for a runtime-calibrated R0. Takes fractional codes (e.g. a
+ * filtered average) and interpolates linearly between table entries; that
+ * stays within 0.02% of pow() for codes 64..4000 and loses accuracy only
+ * at the rails, where the curves are steepest.
+ */
+class GasCalibration {
+ public:
+  GasCalibration();
+
+  /* Sensor resistance in clean air in kOhm, from a calibration run */
+  void setR0(float r0);
+  float r0() const { return resistance; }
+
+  void convert(float code, float ppm[GAS_CHANNELS]) const;
+
+ private:
+  float resistance;
+  float factor[GAS_CHANNELS];
+};
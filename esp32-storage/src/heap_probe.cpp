@@ -0,0 +1,60 @@
+#include <Arduino.h>
+#include "heap_probe.h"
+
+#ifdef HEAP_PROBE
+
+static TaskHandle_t probedTask = nullptr;
+static volatile uint32_t allocationCount = 0;
+
+static inline void countAllocation() {
+  if (probedTask != nullptr && xTaskGetCurrentTaskHandle() == probedTask) {
+    allocationCount = allocationCount + 1;
+  }
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  countAllocation();
+  return __real_realloc(ptr, size);
+}
+}
+
+void heapProbeAttach() {
+  probedTask = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t heapProbeCount() {
+  return allocationCount;
+}
+
+bool heapProbeEnabled() {
+  return true;
+}
+
+#else
+
+void heapProbeAttach() {}
+
+uint32_t heapProbeCount() {
+  return 0;
+}
+
+bool heapProbeEnabled() {
+  return false;
+}
+
+#endif
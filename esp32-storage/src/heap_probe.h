@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Counts heap allocations (malloc/calloc/realloc, so also new and String)
+ * made by one task. Needs HEAP_PROBE and the -Wl,--wrap linker flags from
+ * platformio.ini; without them the count stays 0 and attach() is a no-op.
+ */
+
+/* Starts counting allocations made by the calling task */
+void heapProbeAttach();
+
+/* Allocations made by the attached task since boot */
+uint32_t heapProbeCount();
+
+/* True when the linker wraps are active and counts mean something */
+bool heapProbeEnabled();
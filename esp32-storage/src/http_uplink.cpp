@@ -0,0 +1,256 @@
+#include <HTTPClient.h>
+#include "http_uplink.h"
+#include "log.h"
+
+HttpUplink::HttpUplink(WiFiClient& client, const char* host, uint16_t port)
+    : client(client), host(host), port(port), counters() {
+  responseBody[0] = '\0';
+}
+
+void HttpUplink::setEndpoint(const char* newHost, uint16_t newPort) {
+  client.stop();
+  host = newHost;
+  port = newPort;
+}
+
+bool HttpUplink::prepare(HttpRequestHead& head, const char* method, const char* path, const char* contentType) {
+  int written = snprintf(head.text, sizeof(head.text),
+                         "%s %s HTTP/1.1\r\n"
+                         "Host: %s:%u\r\n"
+                         "Content-Type: %s\r\n"
+                         "Connection: keep-alive\r\n"
+                         "Content-Length: ",
+                         method, path, host, port, contentType);
+  if (written < 0 || written >= (int)sizeof(head.text)) {
+    head.length = 0;
+    return false;
+  }
+  head.length = written;
+  return true;
+}
+
+int HttpUplink::send(const HttpRequestHead& head, const uint8_t* body, size_t length) {
+  HttpResponse response = { responseBody, sizeof(responseBody), 0, nullptr, 0, nullptr };
+  return request(head, body, length, nullptr, response);
+}
+
+int HttpUplink::fetch(const HttpRequestHead& head, const char* etag, HttpResponse& response) {
+  return request(head, nullptr, 0, etag != nullptr && etag[0] != '\0' ? etag : nullptr, response);
+}
+
+int HttpUplink::request(const HttpRequestHead& head, const uint8_t* body, size_t length, const char* etag,
+                        HttpResponse& response) {
+  uint32_t started = millis();
+  response.length = 0;
+  if (response.body != nullptr) {
+    response.body[0] = '\0';
+  }
+  if (response.etag != nullptr) {
+    response.etag[0] = '\0';
+  }
+
+  bool reused = client.connected();
+  if (!reused && !open()) {
+    counters.failures++;
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  int status = attempt(head, body, length, etag, response);
+
+  if (status < 0 && reused && !client.connected()) {
+    // The server dropped the idle connection under us, retry once on a fresh one
+    client.stop();
+    reused = false;
+    if (open()) {
+      status = attempt(head, body, length, etag, response);
+    }
+  }
+
+  if (status < 0) {
+    client.stop();
+    counters.failures++;
+    return status;
+  }
+
+  uint32_t latency = millis() - started;
+  counters.requests++;
+  counters.lastLatencyMs = latency;
+  if (reused) {
+    counters.reuses++;
+    counters.reuseLatencyMs += latency;
+  } else {
+    counters.connectLatencyMs += latency;
+  }
+  return status;
+}
+
+bool HttpUplink::open() {
+  uint32_t started = millis();
+  if (!client.connect(host, port)) {
+    return false;
+  }
+  client.setNoDelay(true);
+
+  counters.lastConnectMs = millis() - started;
+  counters.connectTimeMs += counters.lastConnectMs;
+  counters.connects++;
+  return true;
+}
+
+int HttpUplink::attempt(const HttpRequestHead& head, const uint8_t* body, size_t length, const char* etag,
+                        HttpResponse& response) {
+  if (head.length == 0) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+
+  char contentLength[HTTP_LINE_MAX];
+  int lengthSize = etag != nullptr
+      ? snprintf(contentLength, sizeof(contentLength), "%u\r\nIf-None-Match: %s\r\n\r\n", (unsigned)length, etag)
+      : snprintf(contentLength, sizeof(contentLength), "%u\r\n\r\n", (unsigned)length);
+  if (lengthSize < 0 || lengthSize >= (int)sizeof(contentLength)) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+
+  if (client.write((const uint8_t*)head.text, head.length) != head.length ||
+      client.write((const uint8_t*)contentLength, lengthSize) != (size_t)lengthSize) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  if (length > 0 && client.write(body, length) != length) {
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+
+  uint32_t deadline = millis() + HTTP_RESPONSE_TIMEOUT_MS;
+  char line[HTTP_LINE_MAX];
+
+  // Status line: "HTTP/1.1 201 Created"
+  if (!readLine(line, sizeof(line), deadline)) {
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  int status = 0;
+  if (strncmp(line, "HTTP/1.", 7) != 0 || (status = atoi(line + 9)) <= 0) {
+    return HTTPC_ERROR_NO_HTTP_SERVER;
+  }
+
+  long bodyLength = -1;
+  bool keepAlive = true;
+  for (;;) {
+    if (!readLine(line, sizeof(line), deadline)) {
+      return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    if (line[0] == '\0') {
+      break;  // End of headers
+    }
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      bodyLength = atol(line + 15);
+    } else if (strncasecmp(line, "Connection:", 11) == 0 && strcasestr(line + 11, "close")) {
+      keepAlive = false;
+    } else if (response.etag != nullptr && strncasecmp(line, "ETag:", 5) == 0) {
+      const char* value = line + 5;
+      while (*value == ' ') {
+        value++;
+      }
+      strncpy(response.etag, value, response.etagCapacity - 1);
+      response.etag[response.etagCapacity - 1] = '\0';
+    }
+  }
+
+  // 304 and 204 never have a body, the connection stays usable without a length
+  if (status == 304 || status == 204) {
+    bodyLength = 0;
+  }
+
+  // Only a 200 body goes to a sink, an error page is read past
+  if (status != 200) {
+    response.sink = nullptr;
+  }
+
+  // Without a length we cannot find the end of the body, so the connection is not reusable
+  if (bodyLength < 0 || !drainBody(bodyLength, deadline, response)) {
+    keepAlive = false;
+  }
+  if (!keepAlive) {
+    client.stop();
+  }
+  return status;
+}
+
+bool HttpUplink::readLine(char* line, size_t capacity, uint32_t deadline) {
+  size_t used = 0;
+  for (;;) {
+    while (!client.available()) {
+      if (!client.connected() || (int32_t)(millis() - deadline) >= 0) {
+        return false;
+      }
+      delay(1);
+    }
+
+    int c = client.read();
+    if (c < 0 || c == '\n') {
+      break;
+    }
+    if (c != '\r' && used + 1 < capacity) {
+      line[used++] = (char)c;  // Overlong header lines are truncated
+    }
+  }
+  line[used] = '\0';
+  return true;
+}
+
+bool HttpUplink::drainBody(size_t length, uint32_t deadline, HttpResponse& response) {
+  size_t kept = 0;
+  uint8_t chunk[256];
+  response.length = length;
+
+  while (length > 0) {
+    while (!client.available()) {
+      if (!client.connected() || (int32_t)(millis() - deadline) >= 0) {
+        if (response.body != nullptr) {
+          response.body[kept] = '\0';
+        }
+        return false;
+      }
+      delay(1);
+    }
+
+    int got = client.read(chunk, length < sizeof(chunk) ? length : sizeof(chunk));
+    if (got <= 0) {
+      break;
+    }
+    length -= got;
+    if (response.sink != nullptr) {
+      if (!response.sink->write(chunk, got)) {
+        return false;
+      }
+      deadline = millis() + HTTP_RESPONSE_TIMEOUT_MS;  // A download may take longer than one timeout
+      continue;
+    }
+    if (response.body == nullptr) {
+      continue;
+    }
+    size_t room = response.capacity - 1 - kept;
+    size_t keep = (size_t)got < room ? (size_t)got : room;
+    memcpy(response.body + kept, chunk, keep);
+    kept += keep;
+  }
+
+  if (response.body != nullptr) {
+    response.body[kept] = '\0';
+  }
+  return length == 0;
+}
+
+void HttpUplink::stop() {
+  client.stop();
+}
+
+void HttpUplink::printStats() const {
+  uint32_t connected = counters.requests - counters.reuses;
+  logInfo("🔗 Uplink %s:%u: requests=%u connects=%u reuses=%u failures=%u last=%ums avg(connect)=%ums avg(reuse)=%ums\n",
+                host, port, counters.requests, counters.connects, counters.reuses, counters.failures,
+                counters.lastLatencyMs,
+                connected ? counters.connectLatencyMs / connected : 0,
+                counters.reuses ? counters.reuseLatencyMs / counters.reuses : 0);
+  logDebug("🔐 Connect/handshake: last=%ums avg=%ums total=%ums, %.2f per request\n",
+            counters.lastConnectMs, counters.connects ? counters.connectTimeMs / counters.connects : 0,
+            counters.connectTimeMs, counters.requests ? (float)counters.connects / counters.requests : 0.0f);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/*
+ * Long-lived HTTP/1.1 keep-alive connection to one host.
+ *
+ * Request lines and headers are formatted once into an HttpRequestHead and
+ * reused for every request, only Content-Length and the body change. The
+ * connection is opened on first use and transparently re-opened when the
+ * server closes it; a request that fails on a reused connection is retried
+ * once on a fresh one.
+ *
+ * Over a WiFiClientSecure every connect is a full TLS handshake, so the
+ * connect counters below are the handshake count and time; keeping the
+ * connection alive is what saves them.
+ */
+
+#define HTTP_HEAD_MAX 256
+#define HTTP_RESPONSE_TIMEOUT_MS 5000
+#define HTTP_LINE_MAX 128
+
+struct HttpRequestHead {
+  char text[HTTP_HEAD_MAX];  // "POST /path HTTP/1.1\r\n...Content-Length: "
+  size_t length;
+};
+
+/* Takes a response body as it arrives, for bodies too large to hold */
+class HttpBodySink {
+ public:
+  virtual ~HttpBodySink() {}
+
+  /* False stops the download, the connection is closed */
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+};
+
+/* Where a response goes: body truncated to capacity, total length kept */
+struct HttpResponse {
+  char* body;
+  size_t capacity;
+  size_t length;      // Full body length, may exceed capacity
+  char* etag;         // ETag header, nullptr if not wanted
+  size_t etagCapacity;
+  HttpBodySink* sink; // Gets a 200 body instead of body/capacity if set; the timeout then runs per chunk
+};
+
+struct UplinkStats {
+  uint32_t requests;         // Requests that got an HTTP status back
+  uint32_t connects;         // TCP connections opened (TLS handshakes on a secure client)
+  uint32_t connectTimeMs;    // Summed time spent in connect(), including the TLS handshake
+  uint32_t lastConnectMs;
+  uint32_t reuses;           // Requests sent on an already open connection
+  uint32_t failures;         // Requests that got no usable response
+  uint32_t connectLatencyMs; // Summed latency of requests that had to connect
+  uint32_t reuseLatencyMs;   // Summed latency of requests on a reused connection
+  uint32_t lastLatencyMs;
+};
+
+class HttpUplink {
+ public:
+  HttpUplink(WiFiClient& client, const char* host, uint16_t port);
+
+  /* Changes the server before the first request; heads prepared earlier keep the old Host */
+  void setEndpoint(const char* host, uint16_t port);
+
+  /* Formats the request line and fixed headers once, returns false if they do not fit */
+  bool prepare(HttpRequestHead& head, const char* method, const char* path, const char* contentType);
+
+  /* Sends one request, returns the HTTP status or a negative value on transport errors */
+  int send(const HttpRequestHead& head, const uint8_t* body, size_t length);
+
+  /*
+   * Conditional request (e.g. GET, head prepared with that method): etag goes
+   * out as If-None-Match unless empty, the body and ETag of the response land
+   * in response. Returns the HTTP status like send(), 304 when unchanged.
+   */
+  int fetch(const HttpRequestHead& head, const char* etag, HttpResponse& response);
+
+  /* Response body of the last send(), truncated to the buffer size */
+  const char* response() const { return responseBody; }
+
+  const UplinkStats& stats() const { return counters; }
+  void printStats() const;
+  void stop();
+
+ private:
+  bool open();
+  int request(const HttpRequestHead& head, const uint8_t* body, size_t length, const char* etag,
+              HttpResponse& response);
+  int attempt(const HttpRequestHead& head, const uint8_t* body, size_t length, const char* etag,
+              HttpResponse& response);
+  bool readLine(char* line, size_t capacity, uint32_t deadline);
+  bool drainBody(size_t length, uint32_t deadline, HttpResponse& response);
+
+  WiFiClient& client;
+  const char* host;
+  uint16_t port;
+  UplinkStats counters;
+  char responseBody[HTTP_LINE_MAX];
+};
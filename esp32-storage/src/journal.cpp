@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <string.h>
+#include "journal.h"
+
+#define JOURNAL_MAGIC 0x4A524E4CUL  // "JRNL"
+#define JOURNAL_META_PATH "/journal.meta"
+
+struct SegmentHeader {
+  uint32_t magic;
+  uint32_t generation;
+  uint32_t recordSize;  // Segments written by a build with a different Reading layout are discarded
+};
+
+struct JournalRecord {
+  uint32_t session;
+  Reading reading;
+  uint32_t crc;
+};
+
+struct JournalMeta {
+  uint32_t magic;
+  uint32_t replayGeneration;
+  uint32_t replayRecord;
+  uint32_t wear[JOURNAL_SEGMENTS];
+  uint32_t crc;
+};
+
+static uint32_t crc32(const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint32_t crc = 0xFFFFFFFFUL;
+  while (length--) {
+    crc ^= *bytes++;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+Journal::Journal(JournalStorage& storage)
+    : storage(storage), writeSegment(-1), replaySegment(-1), replayRecord(0),
+      peekSkipped(0), nextGeneration(1), counters() {
+  memset(segments, 0, sizeof(segments));
+}
+
+bool Journal::begin() {
+  JournalMeta meta;
+  bool haveMeta = storage.fileSize(JOURNAL_META_PATH) == (int32_t)sizeof(meta) &&
+                  storage.readAt(JOURNAL_META_PATH, 0, &meta, sizeof(meta)) &&
+                  meta.magic == JOURNAL_MAGIC &&
+                  meta.crc == crc32(&meta, offsetof(JournalMeta, crc));
+
+  char path[JOURNAL_PATH_MAX];
+  uint32_t newest = 0;
+  for (int i = 0; i < JOURNAL_SEGMENTS; i++) {
+    Segment& segment = segments[i];
+    segment.wear = haveMeta ? meta.wear[i] : 0;
+
+    segmentPath(i, path);
+    int32_t size = storage.fileSize(path);
+    if (size < 0) {
+      continue;
+    }
+
+    SegmentHeader header;
+    if (size < (int32_t)sizeof(header) ||
+        !storage.readAt(path, 0, &header, sizeof(header)) ||
+        header.magic != JOURNAL_MAGIC ||
+        header.recordSize != sizeof(JournalRecord) ||
+        header.generation == 0) {
+      storage.remove(path);
+      continue;
+    }
+
+    uint32_t body = size - sizeof(header);
+    segment.generation = header.generation;
+    segment.records = body / sizeof(JournalRecord);
+
+    // A torn tail from a power loss: never append behind it
+    bool aligned = body % sizeof(JournalRecord) == 0;
+    if (header.generation > newest) {
+      newest = header.generation;
+      writeSegment = aligned && segment.records < JOURNAL_RECORDS_PER_SEGMENT ? i : -1;
+    }
+  }
+  nextGeneration = newest + 1;
+
+  advanceReplay();
+  if (replaySegment >= 0 && haveMeta && segments[replaySegment].generation == meta.replayGeneration) {
+    replayRecord = meta.replayRecord;
+    releaseIfReplayed();
+  }
+
+  counters.pending = pending();
+  return true;
+}
+
+bool Journal::append(const Reading& reading, uint32_t session) {
+  if (writeSegment < 0 || segments[writeSegment].records >= JOURNAL_RECORDS_PER_SEGMENT) {
+    if (!rotate()) {
+      return false;
+    }
+  }
+
+  JournalRecord record;
+  memset(&record, 0, sizeof(record));
+  record.session = session;
+  record.reading = reading;
+  record.crc = crc32(&record, offsetof(JournalRecord, crc));
+
+  char path[JOURNAL_PATH_MAX];
+  segmentPath(writeSegment, path);
+  if (!storage.append(path, &record, sizeof(record))) {
+    // Offsets of this segment are no longer trustworthy, start a new one next time
+    writeSegment = -1;
+    return false;
+  }
+
+  segments[writeSegment].records++;
+  counters.appended++;
+  return true;
+}
+
+size_t Journal::peek(Reading* out, size_t max, uint32_t& session) {
+  peekSkipped = 0;
+  char path[JOURNAL_PATH_MAX];
+
+  while (replaySegment >= 0) {
+    const Segment& segment = segments[replaySegment];
+    segmentPath(replaySegment, path);
+
+    size_t count = 0;
+    for (uint32_t r = replayRecord + peekSkipped; r < segment.records && count < max; r++) {
+      JournalRecord record;
+      bool valid = storage.readAt(path, recordOffset(r), &record, sizeof(record)) &&
+                   record.crc == crc32(&record, offsetof(JournalRecord, crc));
+      if (!valid) {
+        if (count > 0) {
+          break;  // Skipped at the start of the next peek
+        }
+        peekSkipped++;
+        continue;
+      }
+      if (count > 0 && record.session != session) {
+        break;
+      }
+      session = record.session;
+      out[count++] = record.reading;
+    }
+
+    if (count > 0 || max == 0) {
+      return count;
+    }
+    if (peekSkipped == 0 && replaySegment == writeSegment) {
+      return 0;  // Caught up with the segment being written
+    }
+    // Nothing but corrupt records left in this segment, or none at all (a power cut tore its first one): move on
+    commit(0);
+  }
+  return 0;
+}
+
+bool Journal::commit(size_t count) {
+  if (replaySegment < 0) {
+    return false;
+  }
+
+  replayRecord += count + peekSkipped;
+  counters.replayed += count;
+  counters.corrupt += peekSkipped;
+  peekSkipped = 0;
+
+  releaseIfReplayed();
+  return saveMeta();
+}
+
+uint32_t Journal::pending() const {
+  uint32_t total = 0;
+  for (int i = 0; i < JOURNAL_SEGMENTS; i++) {
+    total += segments[i].records;
+  }
+  return replaySegment >= 0 ? total - replayRecord : total;
+}
+
+JournalStats Journal::stats() const {
+  JournalStats stats = counters;
+  stats.pending = pending();
+  stats.minWear = segments[0].wear;
+  stats.maxWear = segments[0].wear;
+  for (int i = 1; i < JOURNAL_SEGMENTS; i++) {
+    if (segments[i].wear < stats.minWear) stats.minWear = segments[i].wear;
+    if (segments[i].wear > stats.maxWear) stats.maxWear = segments[i].wear;
+  }
+  return stats;
+}
+
+bool Journal::rotate() {
+  int chosen = -1;
+  for (int attempt = 0; attempt < 2 && chosen < 0; attempt++) {
+    // Least-worn free segment
+    for (int i = 0; i < JOURNAL_SEGMENTS; i++) {
+      if (segments[i].generation == 0 && (chosen < 0 || segments[i].wear < segments[chosen].wear)) {
+        chosen = i;
+      }
+    }
+
+    if (chosen < 0 && replaySegment >= 0) {
+      // Journal full: give up the oldest unreplayed readings
+      counters.dropped += segments[replaySegment].records - replayRecord;
+      release(replaySegment);
+      advanceReplay();
+    }
+  }
+  if (chosen < 0) {
+    return false;
+  }
+
+  Segment& segment = segments[chosen];
+  SegmentHeader header = { JOURNAL_MAGIC, nextGeneration, sizeof(JournalRecord) };
+
+  char path[JOURNAL_PATH_MAX];
+  segmentPath(chosen, path);
+  segment.wear++;
+  if (!storage.writeFile(path, &header, sizeof(header))) {
+    saveMeta();
+    return false;
+  }
+
+  segment.generation = nextGeneration++;
+  segment.records = 0;
+  writeSegment = chosen;
+  counters.rotations++;
+
+  if (replaySegment < 0) {
+    replaySegment = chosen;
+    replayRecord = 0;
+  }
+  return saveMeta();
+}
+
+void Journal::release(int index) {
+  char path[JOURNAL_PATH_MAX];
+  segmentPath(index, path);
+  storage.remove(path);
+
+  segments[index].generation = 0;
+  segments[index].records = 0;
+  if (writeSegment == index) {
+    writeSegment = -1;
+  }
+  if (replaySegment == index) {
+    replaySegment = -1;
+    replayRecord = 0;
+  }
+}
+
+void Journal::releaseIfReplayed() {
+  const Segment& segment = segments[replaySegment];
+  if (replayRecord < segment.records) {
+    return;
+  }
+  // The segment still being appended to stays, so catching up does not cost a new segment
+  if (replaySegment == writeSegment && segment.records < JOURNAL_RECORDS_PER_SEGMENT) {
+    return;
+  }
+  release(replaySegment);
+  advanceReplay();
+}
+
+void Journal::advanceReplay() {
+  replaySegment = -1;
+  replayRecord = 0;
+  for (int i = 0; i < JOURNAL_SEGMENTS; i++) {
+    if (segments[i].generation != 0 &&
+        (replaySegment < 0 || segments[i].generation < segments[replaySegment].generation)) {
+      replaySegment = i;
+    }
+  }
+}
+
+bool Journal::saveMeta() {
+  JournalMeta meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.magic = JOURNAL_MAGIC;
+  meta.replayGeneration = replaySegment >= 0 ? segments[replaySegment].generation : 0;
+  meta.replayRecord = replayRecord;
+  for (int i = 0; i < JOURNAL_SEGMENTS; i++) {
+    meta.wear[i] = segments[i].wear;
+  }
+  meta.crc = crc32(&meta, offsetof(JournalMeta, crc));
+  return storage.writeFile(JOURNAL_META_PATH, &meta, sizeof(meta));
+}
+
+void Journal::segmentPath(int index, char* path) const {
+  snprintf(path, JOURNAL_PATH_MAX, "/journal%d.bin", index);
+}
+
+uint32_t Journal::recordOffset(uint32_t record) const {
+  return sizeof(SegmentHeader) + record * sizeof(JournalRecord);
+}
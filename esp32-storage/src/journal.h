@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+
+/*
+ * Store-and-forward journal for readings that could not be uploaded.
+ *
+ * Append-only and split into a fixed set of segment files. The write
+ * cursor is the tail of the newest segment, the replay cursor points into
+ * the oldest one. A full segment is deleted once fully replayed; the next one
+ * is taken from the free segments with the lowest reuse count so flash
+ * wear spreads evenly. When every segment is full the oldest one is
+ * sacrificed so fresh readings always fit.
+ *
+ * Hardware independent: all file access goes through JournalStorage,
+ * implemented over LittleFS on the device.
+ */
+
+#define JOURNAL_SEGMENTS 8
+#define JOURNAL_RECORDS_PER_SEGMENT 256  // 8 x 256 readings = ~2.8 hours at 5 s
+#define JOURNAL_PATH_MAX 24
+
+/* The handful of file operations the journal needs */
+class JournalStorage {
+ public:
+  virtual ~JournalStorage() {}
+
+  /* File size in bytes, or -1 if it does not exist */
+  virtual int32_t fileSize(const char* path) = 0;
+
+  /* Reads exactly length bytes at offset */
+  virtual bool readAt(const char* path, uint32_t offset, void* data, size_t length) = 0;
+
+  /* Appends to the file, creating it if needed */
+  virtual bool append(const char* path, const void* data, size_t length) = 0;
+
+  /* Replaces the whole file */
+  virtual bool writeFile(const char* path, const void* data, size_t length) = 0;
+
+  virtual bool remove(const char* path) = 0;
+};
+
+struct JournalStats {
+  uint32_t pending;      // Records not yet replayed
+  uint32_t appended;     // Records written since boot
+  uint32_t replayed;     // Records acknowledged since boot
+  uint32_t dropped;      // Records lost because the journal was full
+  uint32_t corrupt;      // Records skipped on a CRC mismatch (e.g. torn write on power loss)
+  uint32_t rotations;    // Segments started since boot
+  uint32_t maxWear;      // Highest reuse count of any segment
+  uint32_t minWear;      // Lowest reuse count of any segment
+};
+
+class Journal {
+ public:
+  explicit Journal(JournalStorage& storage);
+
+  /* Recovers the cursors from what is on flash */
+  bool begin();
+
+  /* session identifies the boot the reading was captured in */
+  bool append(const Reading& reading, uint32_t session);
+
+  /*
+   * Copies up to max readings from the replay cursor without consuming them.
+   * Only readings from one boot session are returned together.
+   */
+  size_t peek(Reading* out, size_t max, uint32_t& session);
+
+  /* Consumes count readings returned by the last peek() */
+  bool commit(size_t count);
+
+  uint32_t pending() const;
+  JournalStats stats() const;
+
+ private:
+  struct Segment {
+    uint32_t generation;  // 0 = free, otherwise order in which segments were started
+    uint32_t records;
+    uint32_t wear;        // How many times this segment has been (re)started
+  };
+
+  bool rotate();
+  void release(int index);
+  void releaseIfReplayed();
+  void advanceReplay();
+  bool saveMeta();
+  void segmentPath(int index, char* path) const;
+  uint32_t recordOffset(uint32_t record) const;
+
+  JournalStorage& storage;
+  Segment segments[JOURNAL_SEGMENTS];
+  int writeSegment;      // -1 until the next append starts a segment
+  int replaySegment;     // -1 when there is nothing to replay
+  uint32_t replayRecord;
+  uint32_t peekSkipped;  // Corrupt records passed over by the last peek()
+  uint32_t nextGeneration;
+  JournalStats counters;
+};
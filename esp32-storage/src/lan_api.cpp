@@ -0,0 +1,359 @@
+#include "lan_api.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "deadband.h"
+#include "status_classifier.h"
+
+static const char* const CHANNEL_KEYS[READING_CHANNELS] = {
+  "temperature", "humidity", "CO2", "ammonia", "methane", "ethylene", "H2S"
+};
+
+void LanApi::configure(const char* deviceId, const uint32_t* windowsMs, size_t windowCount, LanEpochFn epochFn) {
+  device = deviceId;
+  epochAt = epochFn;
+  aggregator.setWindows(windowsMs, windowCount);
+}
+
+void LanApi::add(const Reading& reading) {
+  readings.push(reading);
+  size_t count = aggregator.add(reading, closed);
+  for (size_t i = 0; i < count; i++) {
+    aggregates.push(closed[i]);
+  }
+}
+
+void LanApi::handle(LanSocket& client, uint64_t nowMs) {
+  socket = &client;
+  now = nowMs;
+  failed = false;
+  outLength = 0;
+  counters.requests++;
+
+  Request request;
+  if (!readRequest(client, request)) {
+    respond(400, "Bad request");
+  } else if (!request.get) {
+    respond(405, "Only GET is supported");
+  } else if (strcmp(request.path, "/api/status") == 0) {
+    sendStatus(request);
+  } else if (strcmp(request.path, "/api/readings") == 0) {
+    sendReadings(request);
+  } else if (strcmp(request.path, "/api/aggregates") == 0) {
+    sendAggregates(request);
+  } else {
+    respond(404, "Not found");
+  }
+
+  flush();
+  if (failed) {
+    counters.aborted++;
+  }
+  socket = nullptr;
+}
+
+/* Reads one line without the line break, false on timeout; longer lines are cut */
+static bool readLine(LanSocket& socket, char* line, size_t capacity) {
+  size_t length = 0;
+  for (;;) {
+    int c = socket.read();
+    if (c < 0) {
+      return false;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (c != '\r' && length + 1 < capacity) {
+      line[length++] = (char)c;
+    }
+  }
+  line[length] = '\0';
+  return true;
+}
+
+bool LanApi::readRequest(LanSocket& client, Request& request) {
+  char line[LAN_REQUEST_LINE_MAX];
+  if (!readLine(client, line, sizeof(line))) {
+    return false;
+  }
+
+  // "GET /api/readings?since=12 HTTP/1.1"
+  char* target = strchr(line, ' ');
+  if (target == nullptr) {
+    return false;
+  }
+  *target++ = '\0';
+  char* version = strchr(target, ' ');
+  if (version == nullptr || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+    return false;
+  }
+  *version = '\0';
+
+  request.get = strcmp(line, "GET") == 0;
+  request.format = FORMAT_JSON;
+  request.since = 0;
+  request.limit = 0;
+
+  char* query = strchr(target, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+  }
+  strncpy(request.path, target, sizeof(request.path) - 1);
+  request.path[sizeof(request.path) - 1] = '\0';
+
+  for (char* param = query; param != nullptr && *param != '\0';) {
+    char* next = strchr(param, '&');
+    if (next != nullptr) {
+      *next++ = '\0';
+    }
+    if (strncmp(param, "since=", 6) == 0) {
+      request.since = strtoul(param + 6, nullptr, 10);
+    } else if (strncmp(param, "limit=", 6) == 0) {
+      request.limit = strtoul(param + 6, nullptr, 10);
+    } else if (strcmp(param, "format=msgpack") == 0) {
+      request.format = FORMAT_MSGPACK;
+    }
+    param = next;
+  }
+
+  // Headers: only Accept matters, the rest is read and dropped
+  for (int lines = 0; lines < LAN_HEADER_LINES_MAX; lines++) {
+    if (!readLine(client, line, sizeof(line))) {
+      return false;
+    }
+    if (line[0] == '\0') {
+      return true;
+    }
+    if (strncasecmp(line, "Accept:", 7) == 0 && strstr(line, "application/msgpack") != nullptr) {
+      request.format = FORMAT_MSGPACK;
+    }
+  }
+  return false;
+}
+
+void LanApi::sendHead(int status, const char* contentType) {
+  const char* reason = status == 200 ? "OK"
+                     : status == 404 ? "Not Found"
+                     : status == 405 ? "Method Not Allowed"
+                     : "Bad Request";
+  char head[192];
+  int length = snprintf(head, sizeof(head),
+                        "HTTP/1.1 %d %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Cache-Control: no-store\r\n"
+                        "Access-Control-Allow-Origin: *\r\n"
+                        "Connection: close\r\n\r\n",
+                        status, reason, contentType);
+  write(head, (size_t)length);
+}
+
+/* Errors are always JSON, shaped like the backend's */
+void LanApi::respond(int status, const char* message) {
+  counters.rejected++;
+  sendHead(status, "application/json");
+  arena.reset();
+  JsonDocument doc(&arena);
+  doc["success"] = false;
+  doc["message"] = message;
+  write(item, serialize(doc, FORMAT_JSON));
+}
+
+void LanApi::sendStatus(const Request& request) {
+  sendHead(200, request.format == FORMAT_MSGPACK ? "application/msgpack" : "application/json");
+
+  arena.reset();
+  JsonDocument doc(&arena);
+  doc["deviceId"] = device;
+  doc["readings"] = readings.size();
+  doc["aggregates"] = aggregates.size();
+  if (!readings.empty()) {
+    const Reading& latest = readings.at(readings.size() - 1);
+    doc["firstSeq"] = readings.at(0).sequence;
+    doc["lastSeq"] = latest.sequence;
+    if (latest.status != STATUS_UNKNOWN) {
+      doc["status"] = storageStatusName((StorageStatus)latest.status);
+    }
+    stamp(doc.as<JsonObject>(), latest.epochMs, latest.capturedAtMs);
+  }
+  write(item, serialize(doc, request.format));
+}
+
+void LanApi::sendReadings(const Request& request) {
+  // Sequences only grow within a boot, so everything after the first match is newer
+  size_t first = 0;
+  while (first < readings.size() && readings.at(first).sequence <= request.since) {
+    first++;
+  }
+  size_t count = readings.size() - first;
+  if (request.limit > 0 && request.limit < count) {
+    count = request.limit;
+  }
+
+  sendHead(200, request.format == FORMAT_MSGPACK ? "application/msgpack" : "application/json");
+  beginList("readings", count, request.format);
+  for (size_t i = 0; i < count && !failed; i++) {
+    size_t length = serializeReading(readings.at(first + i), request.format);
+    if (length == 0) {
+      failed = true;  // Cut short rather than send a list that does not match its count
+      break;
+    }
+    if (i > 0 && request.format == FORMAT_JSON) {
+      write(",", 1);
+    }
+    write(item, length);
+    counters.itemsServed++;
+  }
+  endList(request.format);
+}
+
+void LanApi::sendAggregates(const Request& request) {
+  size_t count = aggregates.size();
+  if (request.limit > 0 && request.limit < count) {
+    count = request.limit;
+  }
+  size_t first = aggregates.size() - count;
+
+  sendHead(200, request.format == FORMAT_MSGPACK ? "application/msgpack" : "application/json");
+  beginList("aggregates", count, request.format);
+  for (size_t i = 0; i < count && !failed; i++) {
+    size_t length = serializeAggregate(aggregates.at(first + i), request.format);
+    if (length == 0) {
+      failed = true;  // Cut short rather than send a list that does not match its count
+      break;
+    }
+    if (i > 0 && request.format == FORMAT_JSON) {
+      write(",", 1);
+    }
+    write(item, length);
+    counters.itemsServed++;
+  }
+  endList(request.format);
+}
+
+/* {"deviceId":...,"<key>":[ with the list left open, the count is only needed by MessagePack */
+void LanApi::beginList(const char* key, size_t count, Format format) {
+  arena.reset();
+  JsonDocument doc(&arena);
+  doc["deviceId"] = device;
+  size_t length = serialize(doc, format);
+  if (length == 0) {
+    failed = true;
+    return;
+  }
+
+  if (format == FORMAT_JSON) {
+    write(item, length - 1);  // Without the closing brace
+    char open[32];
+    write(open, snprintf(open, sizeof(open), ",\"%s\":[", key));
+    return;
+  }
+
+  item[0] = 0x82;  // fixmap of 2 instead of 1
+  write(item, length);
+  uint8_t keyLength = (uint8_t)strlen(key);
+  uint8_t prefix = 0xA0 | keyLength;  // fixstr, keys are short
+  write(&prefix, 1);
+  write(key, keyLength);
+  uint8_t array[5] = { 0xDD, (uint8_t)(count >> 24), (uint8_t)(count >> 16), (uint8_t)(count >> 8), (uint8_t)count };
+  write(array, sizeof(array));
+}
+
+void LanApi::endList(Format format) {
+  if (format == FORMAT_JSON) {
+    write("]}", 2);
+  }
+}
+
+/* ts once the capture time is known, else how long ago it was captured */
+void LanApi::stamp(JsonObject item, uint64_t epochMs, uint32_t capturedAtMs) {
+  uint32_t age = (uint32_t)now - capturedAtMs;
+  if (epochMs == 0 && epochAt != nullptr) {
+    epochMs = epochAt(now - age);
+  }
+  if (epochMs != 0) {
+    item["ts"] = epochMs;
+  } else {
+    item["ageMs"] = age;
+  }
+}
+
+size_t LanApi::serializeReading(const Reading& reading, Format format) {
+  arena.reset();
+  JsonDocument doc(&arena);
+  JsonObject object = doc.to<JsonObject>();
+  object["seq"] = reading.sequence;
+  stamp(object, reading.epochMs, reading.capturedAtMs);
+  if (reading.status != STATUS_UNKNOWN) {
+    object["status"] = storageStatusName((StorageStatus)reading.status);
+  }
+  for (int c = 0; c < READING_CHANNELS; c++) {
+    object[CHANNEL_KEYS[c]] = readingChannel(reading, (ReadingChannel)c);
+  }
+  return serialize(doc, format);
+}
+
+size_t LanApi::serializeAggregate(const AggregateRecord& record, Format format) {
+  arena.reset();
+  JsonDocument doc(&arena);
+  JsonObject object = doc.to<JsonObject>();
+  stamp(object, record.startEpochMs, record.startMs);
+  object["durationMs"] = record.durationMs;
+  object["count"] = record.count;
+
+  // [min, max, mean, stddev], channels without a valid sample are left out
+  for (int c = 0; c < READING_CHANNELS; c++) {
+    const ChannelSummary& summary = record.channels[c];
+    if (isnan(summary.mean)) {
+      continue;
+    }
+    JsonArray values = object[CHANNEL_KEYS[c]].to<JsonArray>();
+    values.add(summary.min);
+    values.add(summary.max);
+    values.add(summary.mean);
+    values.add(summary.stddev);
+  }
+  return serialize(doc, format);
+}
+
+/* Into item[], 0 if it did not fit */
+size_t LanApi::serialize(JsonDocument& doc, Format format) {
+  if (doc.overflowed()) {
+    return 0;
+  }
+  size_t length = format == FORMAT_MSGPACK ? measureMsgPack(doc) : measureJson(doc);
+  if (length >= LAN_ITEM_MAX) {
+    return 0;
+  }
+  return format == FORMAT_MSGPACK ? serializeMsgPack(doc, item, LAN_ITEM_MAX)
+                                  : serializeJson(doc, (char*)item, LAN_ITEM_MAX);
+}
+
+void LanApi::write(const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (length > 0 && !failed) {
+    size_t chunk = LAN_WRITE_BUFFER - outLength;
+    if (chunk > length) {
+      chunk = length;
+    }
+    memcpy(out + outLength, bytes, chunk);
+    outLength += chunk;
+    bytes += chunk;
+    length -= chunk;
+    if (outLength == LAN_WRITE_BUFFER) {
+      flush();
+    }
+  }
+}
+
+void LanApi::flush() {
+  if (outLength == 0 || failed) {
+    outLength = 0;
+    return;
+  }
+  size_t written = socket->write(out, outLength);
+  counters.bytesServed += written;
+  failed = written < outLength;
+  outLength = 0;
+}
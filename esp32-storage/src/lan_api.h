@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+#include "reading_ring.h"
+#include "arena_allocator.h"
+#include "window_aggregate.h"
+
+/*
+ * Read-only HTTP API for the LAN, served from RAM.
+ *
+ * Keeps the recent readings and closed windows in its own rings, so local
+ * dashboards and gateways can poll the device instead of the backend:
+ *
+ *   GET /api/status                        latest status and what is held
+ *   GET /api/readings?since=<seq>&limit=n  readings after seq, oldest first
+ *   GET /api/aggregates?limit=n            newest windows, oldest first
+ *
+ * JSON by default, MessagePack with ?format=msgpack or an Accept header
+ * naming application/msgpack. Item fields match the backend uplink. The
+ * body is streamed item by item through a small buffer and the connection
+ * closed after it, so no response is ever held in full.
+ *
+ * Not thread-safe: add() and handle() must run on the same task (the LAN
+ * sink worker), which is also why a response never sees the rings move.
+ * Hardware independent, the connection is a LanSocket.
+ */
+
+#define LAN_HISTORY_READINGS 360   // An hour at 10 s, 12 minutes at the fastest rate
+#define LAN_HISTORY_AGGREGATES 48  // ~45 minutes of 1 minute windows plus their 15 minute ones
+#define LAN_REQUEST_LINE_MAX 128
+#define LAN_HEADER_LINES_MAX 32    // Requests with more header lines are refused
+#define LAN_WRITE_BUFFER 512       // Bytes collected before a socket write
+#define LAN_ITEM_MAX 512           // One serialized reading or window
+#define LAN_ARENA_SIZE 2048        // JsonDocument storage for one item
+
+/* One accepted connection */
+class LanSocket {
+ public:
+  virtual ~LanSocket() {}
+
+  /* Next request byte, -1 on timeout or when the client closed */
+  virtual int read() = 0;
+
+  /* Bytes actually written, fewer means the client is gone */
+  virtual size_t write(const uint8_t* data, size_t length) = 0;
+};
+
+/* Wall-clock time of a monotonicMs() instant, 0 while unknown */
+typedef uint64_t (*LanEpochFn)(uint64_t monotonicMs);
+
+struct LanApiStats {
+  uint32_t requests;
+  uint32_t rejected;      // Answered with a 4xx status
+  uint32_t aborted;       // Client gone or too slow before the response was complete
+  uint32_t itemsServed;
+  uint32_t bytesServed;
+};
+
+class LanApi {
+ public:
+  void configure(const char* deviceId, const uint32_t* windowsMs, size_t windowCount, LanEpochFn epochAt);
+
+  /* Keeps a reading and the windows it closed */
+  void add(const Reading& reading);
+
+  /* Reads one request and streams the response; nowMs is monotonicMs() */
+  void handle(LanSocket& socket, uint64_t nowMs);
+
+  size_t readingCount() const { return readings.size(); }
+  size_t aggregateCount() const { return aggregates.size(); }
+  const LanApiStats& stats() const { return counters; }
+
+ private:
+  enum Format { FORMAT_JSON, FORMAT_MSGPACK };
+
+  struct Request {
+    char path[LAN_REQUEST_LINE_MAX];
+    bool get;
+    Format format;
+    uint32_t since;
+    uint32_t limit;  // 0 = everything held
+  };
+
+  bool readRequest(LanSocket& socket, Request& request);
+  void respond(int status, const char* message);
+  void sendStatus(const Request& request);
+  void sendReadings(const Request& request);
+  void sendAggregates(const Request& request);
+  void beginList(const char* key, size_t count, Format format);
+  void endList(Format format);
+  void sendHead(int status, const char* contentType);
+  size_t serializeReading(const Reading& reading, Format format);
+  size_t serializeAggregate(const AggregateRecord& record, Format format);
+  size_t serialize(JsonDocument& doc, Format format);
+  void stamp(JsonObject item, uint64_t epochMs, uint32_t capturedAtMs);
+  void write(const void* data, size_t length);
+  void flush();
+
+  const char* device;
+  LanEpochFn epochAt;
+  uint64_t now;
+  ReadingRing<LAN_HISTORY_READINGS> readings;
+  ReadingRing<LAN_HISTORY_AGGREGATES, AggregateRecord> aggregates;
+  WindowAggregator aggregator;
+  AggregateRecord closed[AGGREGATE_WINDOWS];
+
+  LanSocket* socket;
+  bool failed;  // Client stopped taking bytes, the rest of the response is skipped
+  uint8_t out[LAN_WRITE_BUFFER];
+  size_t outLength;
+  uint8_t item[LAN_ITEM_MAX];
+  ArenaAllocator<LAN_ARENA_SIZE> arena;
+  LanApiStats counters;
+};
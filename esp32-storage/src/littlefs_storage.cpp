@@ -0,0 +1,53 @@
+#include <LittleFS.h>
+#include "littlefs_storage.h"
+
+bool LittleFsStorage::begin() {
+  return LittleFS.begin(true);
+}
+
+int32_t LittleFsStorage::fileSize(const char* path) {
+  if (!LittleFS.exists(path)) {
+    return -1;
+  }
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    return -1;
+  }
+  int32_t size = file.size();
+  file.close();
+  return size;
+}
+
+bool LittleFsStorage::readAt(const char* path, uint32_t offset, void* data, size_t length) {
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.seek(offset) && file.read((uint8_t*)data, length) == length;
+  file.close();
+  return ok;
+}
+
+bool LittleFsStorage::append(const char* path, const void* data, size_t length) {
+  File file = LittleFS.open(path, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write((const uint8_t*)data, length) == length;
+  file.close();
+  return ok;
+}
+
+bool LittleFsStorage::writeFile(const char* path, const void* data, size_t length) {
+  File file = LittleFS.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write((const uint8_t*)data, length) == length;
+  file.close();
+  return ok;
+}
+
+bool LittleFsStorage::remove(const char* path) {
+  return LittleFS.remove(path);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "journal.h"
+
+/* JournalStorage over the LittleFS partition (board_build.filesystem = littlefs) */
+class LittleFsStorage : public JournalStorage {
+ public:
+  /* Mounts the partition, formatting it on first use */
+  bool begin();
+
+  int32_t fileSize(const char* path) override;
+  bool readAt(const char* path, uint32_t offset, void* data, size_t length) override;
+  bool append(const char* path, const void* data, size_t length) override;
+  bool writeFile(const char* path, const void* data, size_t length) override;
+  bool remove(const char* path) override;
+};
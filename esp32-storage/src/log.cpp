@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdarg.h>
+#include <atomic>
+#include "log.h"
+
+/*
+ * Bounded multi-producer queue (Vyukov): a producer claims a position with
+ * one compare-and-swap, formats straight into that slot and publishes it by
+ * advancing the slot's sequence. Only the drain task consumes.
+ *
+ * Slot i expects sequence i when free; it is stored minus i so that the
+ * zero-initialized ring is valid before beginLog() runs.
+ */
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  uint16_t length;
+  char text[LOG_LINE_MAX];
+};
+
+static LogSlot slots[LOG_RING_SLOTS];
+static std::atomic<uint32_t> enqueuePosition(0);
+static std::atomic<uint32_t> dequeuePosition(0);  // Only the drain task advances it
+static std::atomic<uint32_t> droppedCount(0);
+static TaskHandle_t drainTask = nullptr;
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+
+static uint32_t slotSequence(uint32_t index) {
+  return slots[index].sequence.load(std::memory_order_acquire) + index;
+}
+
+static void setSlotSequence(uint32_t index, uint32_t sequence) {
+  slots[index].sequence.store(sequence - index, std::memory_order_release);
+}
+
+void logWrite(const char* format, ...) {
+  uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+  uint32_t index;
+  for (;;) {
+    index = position & (LOG_RING_SLOTS - 1);
+    int32_t lag = (int32_t)(slotSequence(index) - position);
+    if (lag == 0) {
+      if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);  // Full, never wait for the UART
+      return;
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogSlot& slot = slots[index];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(slot.text, sizeof(slot.text), format, args);
+  va_end(args);
+  slot.length = length < 0 ? 0 : length >= (int)sizeof(slot.text) ? sizeof(slot.text) - 1 : length;
+  setSlotSequence(index, position + 1);
+
+  if (drainTask != nullptr) {
+    xTaskNotifyGive(drainTask);
+  }
+}
+
+/* Writes out the oldest published line, false if there is none */
+static bool drainOne() {
+  uint32_t position = dequeuePosition.load(std::memory_order_relaxed);
+  uint32_t index = position & (LOG_RING_SLOTS - 1);
+  if (slotSequence(index) != position + 1) {
+    return false;
+  }
+  Serial.write((const uint8_t*)slots[index].text, slots[index].length);
+  setSlotSequence(index, position + LOG_RING_SLOTS);
+  dequeuePosition.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+static void drainLoop(void* param) {
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (drainOne()) {
+    }
+
+    uint32_t drops = droppedCount.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      char line[48];
+      int length = snprintf(line, sizeof(line), "⚠️ Log: %u lines dropped\n", drops - reportedDrops);
+      Serial.write((const uint8_t*)line, length);
+      reportedDrops = drops;
+    }
+  }
+}
+
+void beginLog() {
+  if (drainTask != nullptr) {
+    return;
+  }
+  xTaskCreatePinnedToCore(drainLoop, "log", LOG_DRAIN_STACK_SIZE, nullptr,
+                          LOG_DRAIN_PRIORITY, &drainTask, tskNO_AFFINITY);
+  xTaskNotifyGive(drainTask);  // Lines logged before the task existed
+}
+
+void logFlush() {
+  if (drainTask == nullptr) {
+    while (drainOne()) {
+    }
+  } else {
+    uint32_t started = millis();
+    while (dequeuePosition.load(std::memory_order_acquire) != enqueuePosition.load(std::memory_order_relaxed) &&
+           millis() - started < LOG_FLUSH_TIMEOUT_MS) {
+      delay(1);
+    }
+  }
+  Serial.flush();
+}
+
+uint32_t logDroppedCount() {
+  return droppedCount.load(std::memory_order_relaxed);
+}
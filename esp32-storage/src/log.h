@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Leveled logging that never blocks on the UART.
+ *
+ * logError()/logWarn()/logInfo()/logDebug() format into a slot of a
+ * lock-free ring (any task, not from ISRs) and return; a low-priority task
+ * drains the ring to Serial. When the ring is full the line is dropped and
+ * counted instead of waiting, the drain task reports the count.
+ *
+ * LOG_LEVEL picks what is compiled in, e.g. -DLOG_LEVEL=4 for debug lines.
+ * Levels above it cost nothing: the calls are dead code the compiler drops,
+ * arguments and format strings included, but are still type-checked.
+ * Lines longer than LOG_LINE_MAX are truncated.
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_LINE_MAX 184        // Text per record, a slot is 192 bytes
+#define LOG_RING_SLOTS 32       // Power of two, ~6 KB
+#define LOG_DRAIN_PRIORITY 1    // Below every worker, printing only uses idle time
+#define LOG_DRAIN_STACK_SIZE 2048
+#define LOG_FLUSH_TIMEOUT_MS 500
+
+/* Starts the drain task; lines logged before are kept in the ring */
+void beginLog();
+
+/* Waits until the ring is empty and Serial has sent it, e.g. before deep sleep */
+void logFlush();
+
+/* Lines lost to a full ring since boot */
+uint32_t logDroppedCount();
+
+void logWrite(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define logError(...) logWrite(__VA_ARGS__)
+#else
+#define logError(...) do { if (0) logWrite(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define logWarn(...) logWrite(__VA_ARGS__)
+#else
+#define logWarn(...) do { if (0) logWrite(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define logInfo(...) logWrite(__VA_ARGS__)
+#else
+#define logInfo(...) do { if (0) logWrite(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define logDebug(...) logWrite(__VA_ARGS__)
+#else
+#define logDebug(...) do { if (0) logWrite(__VA_ARGS__); } while (0)
+#endif
@@ -1,187 +1,1560 @@
 #include <WiFi.h>
+#include <WiFiClientSecure.h>
 #include <HTTPClient.h>
 #include <DHT.h>
 #include <ArduinoJson.h>
+#include <esp_sleep.h>
+#include "power_profile.h"
+#include "reading.h"
+#include "pipeline.h"
+#include "http_uplink.h"
+#include "reading_ring.h"
+#include "journal.h"
+#include "littlefs_storage.h"
+#include "arena_allocator.h"
+#include "heap_probe.h"
+#include "energy_model.h"
+#include "gas_table.h"
+#include "adc_acquisition.h"
+#include "sensor_array.h"
+#include "deadband.h"
+#include "window_aggregate.h"
+#include "gas_detector.h"
+#include "status_classifier.h"
+#include "series_codec.h"
+#include "lan_api.h"
+#include "remote_config.h"
+#include "nvs_config.h"
+#include "firmware_update.h"
+#include "adaptive_rate.h"
+#include "uplink_manager.h"
+#include "wifi_link.h"
+#include "esp32_wifi.h"
+#include "esp_clock.h"
+#include "log.h"
 
 /* WiFi */
 const char* ssid = "gypsa";
 const char* password = "iniyan07";
 
+/* Reconnects without blocking, rejoining the cached access point first (see wifi_link.h) */
+Esp32WifiRadio wifiRadio(ssid, password);
+NvsWifiCache wifiCacheStore;
+WifiLink wifiLink(wifiRadio, wifiCacheStore);
+
 /* Backend API */
 const char* backendHost = "10.88.168.184";  // Your PC's IP address on the same WiFi network
-const int backendPort = 5000;
+int backendPort = 5000;
 const char* farmerId = "507f1f77bcf86cd799439011";  // Farmer ID
 const char* deviceId = "ESP32_001";
+const char* cropProfile = "default";  // Status limits for the stored crop, see CROP_PROFILES in status_classifier.h
+
+/* One keep-alive connection to the backend, request head built once in setup() */
+WiFiClient backendClient;
+HttpUplink backendUplink(backendClient, backendHost, backendPort);
+HttpRequestHead batchHead;
+HttpRequestHead aggregateHead;
+
+/* Runtime config from the backend: polled with its ETag, kept in NVS, applied at boot (see remote_config.h) */
+NvsConfigStore configStore;
+RETAINED RemoteConfig remoteConfig;
+HttpRequestHead configHead;
+char configBody[CONFIG_BODY_MAX];
+char configEtag[CONFIG_ETAG_MAX];
+char configuredHost[CONFIG_HOST_MAX];
+
+/* Delta firmware updates: the config names the release, the backend serves a patch from this one (see firmware_update.h) */
+#define FIRMWARE_VERSION "1.1.0"  // Bump for every release, patches are built against the image of the running one
+FirmwareUpdate firmwareUpdate;
+HttpRequestHead firmwareHead;
+RETAINED char failedFirmware[CONFIG_VERSION_MAX];  // Its patch did not apply, not fetched again
+
+/* A polled config reaches the other tasks as a whole: each copies it under the lock when the generation moves */
+portMUX_TYPE configLock = portMUX_INITIALIZER_UNLOCKED;
+DeviceConfig publishedConfig;
+volatile uint32_t configGeneration = 0;
+
+/* Deep sleep profile (see power_profile.h): the sleep time and WiFi cadence follow the adaptive rate */
+#if POWER_PROFILE_DEEP_SLEEP
+// Stable room: a reading every 5 minutes, WiFi every 15; the heater needs 20 s per wake
+constexpr AdaptiveBounds DEEP_SLEEP_RATE_BOUNDS = { 30000, 300000, 15, 60000, 900000 };
+#define DEEP_SLEEP_BREAKER_DELAY_MS 900000      // Backend down: skip WiFi for up to 15 min...
+#define DEEP_SLEEP_BREAKER_MAX_DELAY_MS 7200000 // ...growing to 2 hours, jittered
+#define DEEP_SLEEP_WIFI_TIMEOUT_MS 10000  // Give up and sleep if the AP does not answer
+#define DEEP_SLEEP_REPLAY_BATCHES 4       // Journaled batches replayed per WiFi wake
+#define DEEP_SLEEP_SNTP_WAIT_MS 2000      // Longest the radio stays up waiting for the time server
+#define DEEP_SLEEP_ADC_BURSTS 4           // ~50 ms of DMA sampling per wake for the MQ135 filter
+#define BATTERY_CAPACITY_MAH 2000         // Used for the runtime estimate only
+#endif
+
+/* Batching: readings wait in RAM and go out as one POST */
+#define BATCH_SIZE 12            // Flush after 12 readings or after uplinkIntervalMs(), whichever comes first
+#define BATCH_MAX 24             // Largest batch sent in one request when catching up
+#if POWER_PROFILE_DEEP_SLEEP
+#define RING_CAPACITY 64         // RTC slow memory is 8 KB, spills to the journal beyond this
+#else
+#define RING_CAPACITY 120        // 10 minutes of readings kept while the backend is unreachable
+#endif
+
+/* Uplink encoding: build with -DUPLINK_MSGPACK=1 to send MessagePack instead of JSON */
+#ifndef UPLINK_MSGPACK
+#define UPLINK_MSGPACK 0
+#endif
+#if UPLINK_MSGPACK
+#define UPLINK_CONTENT_TYPE "application/msgpack"
+#define UPLINK_FORMAT_NAME "MsgPack"
+#else
+#define UPLINK_CONTENT_TYPE "application/json"
+#define UPLINK_FORMAT_NAME "JSON"
+#endif
+/* Build with -DUPLINK_SERIES=1 to send reading batches column-compressed (series_codec.h), ~6x smaller than JSON */
+#ifndef UPLINK_SERIES
+#define UPLINK_SERIES 0
+#endif
+#if UPLINK_SERIES
+#define BATCH_CONTENT_TYPE "application/x-harvesthub-series"
+#define SERIES_GAS_MANTISSA_BITS 16  // Relative error below 1e-5, far under the MQ135 noise
+#else
+#define BATCH_CONTENT_TYPE UPLINK_CONTENT_TYPE
+#endif
+/* Build with -DLAN_API=1 to serve recent readings and windows to the LAN on port 80 (see lan_api.h) */
+#ifndef LAN_API
+#define LAN_API 0
+#endif
+#if LAN_API && POWER_PROFILE_DEEP_SLEEP
+#error "LAN_API needs the radio on between readings, it cannot be combined with POWER_PROFILE_DEEP_SLEEP"
+#endif
+#define PAYLOAD_MAX 5120       // A full BATCH_MAX batch is ~3.5 KB as JSON, ~2.5 KB as MsgPack, +0.6 KB with 8 probes
+#define JSON_ARENA_SIZE 12288  // JsonDocument storage for one BATCH_MAX batch
+
+/* Upload path buffers are all static, so steady state never touches the heap */
+RETAINED ReadingRing<RING_CAPACITY> pendingReadings;
+Reading batch[BATCH_MAX];
+uint8_t payload[PAYLOAD_MAX];
+ArenaAllocator<JSON_ARENA_SIZE> jsonArena;
+uint32_t lastFlushMs = 0;
+
+/* Firebase only gets readings that moved past the deadbands (see deadband.h) */
+RETAINED DeadbandFilter deadband;
+
+/* Every reading is stamped normal/warning/critical on the device (see status_classifier.h) */
+RETAINED StatusClassifier classifier;
+
+/* History: per-window aggregates for every channel, raw readings only around anomalies (see window_aggregate.h) */
+#define AGGREGATE_BATCH_MAX 8  // ~2.5 KB as JSON
+#if POWER_PROFILE_DEEP_SLEEP
+#define AGGREGATE_CAPACITY 8   // Two hours of windows in RTC memory
+const uint32_t AGGREGATE_WINDOW_MS[AGGREGATE_WINDOWS] = { 900000, 3600000 };  // 15 min and 1 h
+#else
+#define AGGREGATE_CAPACITY 32  // Half an hour of windows kept while the backend is unreachable
+const uint32_t AGGREGATE_WINDOW_MS[AGGREGATE_WINDOWS] = { 60000, 900000 };    // 1 min and 15 min
+#endif
+
+RETAINED WindowAggregator aggregator;
+RETAINED RawSampleGate rawGate;
+RETAINED ReadingRing<AGGREGATE_CAPACITY, AggregateRecord> pendingAggregates;
+AggregateRecord closedWindows[AGGREGATE_WINDOWS];
+Reading rawReadings[AGGREGATE_RAW_CONTEXT + 1];
+
+/* Spoilage alerts: CUSUM detectors on every gas channel, a trip is POSTed right away (see gas_detector.h) */
+#define ALERT_WINDOW 6  // Readings up to the trip sent with the alert
+#define ALERT_PAYLOAD_MAX 1536
+
+struct PendingAlert {
+  uint8_t channels;  // GasChannel bits tripped and not yet delivered, 0 if none
+  uint8_t attempts;
+  Reading reading;   // Latest tripping reading
+  Reading window[ALERT_WINDOW];
+  uint8_t windowCount;
+};
+
+RETAINED GasDetector gasDetector;
+RETAINED ReadingRing<ALERT_WINDOW> recentReadings;
+RETAINED PendingAlert pendingAlert;
+
+/* Own connection, so an alert never waits behind a batch upload on the backend worker */
+WiFiClient alertClient;
+HttpUplink alertUplink(alertClient, backendHost, backendPort);
+HttpRequestHead alertHead;
+ArenaAllocator<4096> alertArena;
+char alertPayload[ALERT_PAYLOAD_MAX];
+
+/* Store-and-forward: batches the backend did not take are journaled on LittleFS */
+#define JOURNAL_REPLAY_INTERVAL_MS 10000  // At most one replayed batch every 10 s after reconnect
+
+LittleFsStorage flashStorage;
+Journal journal(flashStorage);
+bool journalReady = false;
+bool backendReachable = false;
+RETAINED uint32_t bootSession = 0;  // Tells journaled readings from this boot apart from older ones
+uint32_t lastReplayMs = 0;
 
 /* Firebase (Optional - for backup) */
-const char* firebaseHost = "https://agri-48613-default-rtdb.firebaseio.com";
+const char* firebaseHost = "agri-48613-default-rtdb.firebaseio.com";  // Without https://
+const int firebasePort = 443;
 const char* firebaseAuth = "FRpJ90gTLsqtbynawN7dI9Wx5upRXmypwAB3xZ1T";
 
-/* Sensors */
-#define DHTPIN 4
+#define FIREBASE_HANDSHAKE_TIMEOUT_S 10  // The library default of 120 s would park the sink worker
+
+/*
+ * One TLS connection kept alive across PUTs, so the handshake (the most
+ * expensive thing the device does) only happens when Firebase drops it.
+ * The Arduino WiFiClientSecure has no hook for TLS session resumption;
+ * handshake count and time are printed after every PUT instead.
+ */
+WiFiClientSecure firebaseClient;
+HttpUplink firebaseUplink(firebaseClient, firebaseHost, firebasePort);
+HttpRequestHead firebaseHead;
+char firebaseBody[320];
+
+/* Sensors: one row per probe, each read on its own period and staggered with the others (see sensor_array.h) */
 #define DHTTYPE DHT11
-#define MQ135_PIN 34
+#define MQ135_HEATER_PIN -1    // GPIO driving the heater MOSFET of every MQ135, -1 if the heaters are always powered
+#define MQ135_WARMUP_MS 20000  // Heater warm-up before a reading when it is switched
+#define PROBE_TASK_PRIORITY 2  // Below the sampler, above the ADC bursts
+#define PROBE_TASK_STACK_SIZE 3072
 
-DHT dht(DHTPIN, DHTTYPE);
+struct ProbeWiring {
+  ProbeSpec spec;
+  uint8_t pin;  // DHT data pin, or an ADC1 pin (GPIO 32-39) for an MQ135
+};
 
-/* MQ135 constants */
-float RL = 10.0;
-float R0 = 29.0;
+// A DHT11 measures at most every 2 s, the library hands back its last values in between
+const ProbeWiring PROBES[] = {
+  { { "dht-1", PROBE_CLIMATE, 2000 }, 4 },
+  { { "mq135-1", PROBE_GAS, 1000 }, 34 },
+  // { { "dht-2", PROBE_CLIMATE, 2000 }, 16 },  // Up to SENSOR_MAX_PROBES rows,
+  // { { "mq135-2", PROBE_GAS, 1000 }, 35 },    // ADC_MAX_CHANNELS of them MQ135s
+};
 
-/* Scaling factor */
-float SCALE = 100.0;
+/* MQ135 conversion, R0 can be recalibrated at runtime (see gas_table.h) */
+GasCalibration gasCalibration;
+bool gasDmaReady = false;  // Filtered DMA bursts, otherwise one analogRead() per read
 
-/* Gas formula */
-float getPPM(float ratio, float a, float b) {
-  return a * pow(ratio, b);
-}
+class DhtProbe : public Probe {
+ public:
+  explicit DhtProbe(uint8_t pin) : sensor(pin, DHTTYPE) {}
+
+  void begin() { sensor.begin(); }
+
+  bool read(float* values) override {
+    values[0] = sensor.readTemperature();
+    values[1] = sensor.readHumidity();  // Same transfer, the library kept it
+    return !isnan(values[0]) && !isnan(values[1]);
+  }
+
+ private:
+  DHT sensor;
+};
+
+class Mq135Probe : public Probe {
+ public:
+  Mq135Probe(uint8_t pin, uint8_t channel) : pin(pin), channel(channel) {}
+
+  bool read(float* values) override {
+    if (gasDmaReady) {
+      AdcSnapshot adc = getAdcSnapshot(channel);
+      values[0] = adc.code;
+      return adc.valid;
+    }
+    values[0] = analogRead(pin);
+    return true;
+  }
+
+ private:
+  uint8_t pin;
+  uint8_t channel;  // Its place in the ADC DMA pattern
+};
+
+SensorArray probeArray;
+
+#if !POWER_PROFILE_DEEP_SLEEP
+/* The probe task publishes the frame after every read, the sampler and the backend sink copy it */
+portMUX_TYPE frameLock = portMUX_INITIALIZER_UNLOCKED;
+SensorFrame publishedFrame;
+#endif
+
+#if POWER_PROFILE_DEEP_SLEEP
+/* Deep sleep state, all of it survives between wakes */
+RETAINED uint32_t wakeCount = 0;
+RETAINED uint64_t lastUploadMs = 0;
+RETAINED AdaptiveRate sleepRate;
+RETAINED CircuitBreaker uploadBreaker;  // Keeps the radio off while the backend is down
+RETAINED uint32_t sleepSequence = 0;
+RETAINED EnergyMeter energy;
+
+void runDeepSleepCycle();
+void warmUpGasSensor();
+void uploadBeforeSleep();
+#else
+void startProbeTask();
+#endif
 
 /* Function declarations */
-void sendToBackend(float temp, float hum, float co2, float ammonia, float methane, float ethylene, float h2s);
-void sendToFirebase(float temp, float hum, float co2, float ammonia, float methane, float ethylene, float h2s);
+void beginProbes();
+void takeFrame(SensorFrame& frame);
+void printProbeStats();
+bool readSensors(Reading& reading);
+bool ensureWiFi();
+void bufferReading(const Reading& reading);
+void reportUplinks();
+void bufferForBackend(const Reading& reading);
+void bufferRawReading(const Reading& reading);
+SinkResult flushToBackend();
+void spillToJournal(size_t count);
+SinkResult replayJournal();
+bool replayJournalBatch();
+bool sendBatchToBackend(const Reading* readings, size_t count, bool sameBoot);
+bool sendAggregatesToBackend();
+void detectSpoilage(const Reading& reading);
+void applyStoredConfig();
+void applyCropProfile(const char* name);
+void pollRemoteConfig();
+void updateFirmware(const char* version);
+void publishConfig(const DeviceConfig& config);
+bool takeConfig(uint32_t& seen, DeviceConfig& config);
+SinkResult flushAlert();
+bool postToBackend(const HttpRequestHead& head, JsonDocument& doc, const char* what, size_t count);
+bool deliverToBackend(const HttpRequestHead& head, size_t length, const char* what, size_t count);
+#if UPLINK_SERIES
+bool sendSeriesBatch(const Reading* readings, size_t count, bool sameBoot);
+#else
+void addProbeColumns(JsonDocument& doc);
+#endif
+bool sendToFirebase(const Reading& reading);
+bool wifiUp();
+void printWifiStats();
+
+/* Uplink sinks, each with its own queue and worker task (see uplink_manager.h) */
+#define STATS_REPORT_INTERVAL_MS 60000
+
+class BackendSink : public UplinkSink {
+ public:
+  void take(const Reading& reading) override { bufferForBackend(reading); }
+  SinkResult flush() override { return flushToBackend(); }
+};
+
+/* Firebase only keeps the latest values, so this sink holds one reading */
+class FirebaseSink : public UplinkSink {
+ public:
+  void take(const Reading& sampled) override {
+    Reading reading = sampled;
+    bool moved = deadband.admit(reading);
+    if (!moved && !(reading.flags & READING_STATUS_CHANGED)) {
+      logDebug("🔇 No change beyond the deadbands, Firebase not updated\n");
+      return;
+    }
+    latest = reading;
+    waiting = true;
+  }
+
+  SinkResult flush() override {
+    if (!waiting) {
+      return SINK_IDLE;
+    }
+    if (!sendToFirebase(latest)) {
+      return SINK_FAILED;
+    }
+    waiting = false;
+    return SINK_SENT;
+  }
+
+ private:
+  Reading latest = {};
+  bool waiting = false;
+};
+
+/* Alerts go out as soon as a detector trips, ahead of everything else */
+class AlertSink : public UplinkSink {
+ public:
+  void take(const Reading& reading) override { detectSpoilage(reading); }
+  SinkResult flush() override { return flushAlert(); }
+};
+
+#if LAN_API
+#define LAN_API_PORT 80
+#define LAN_API_TIMEOUT_MS 2000  // A client that has not sent its request by then is dropped
+
+WiFiServer lanServer(LAN_API_PORT);
+LanApi lanApi;
+bool lanServerStarted = false;
+SinkResult serveLanClient();
+
+/* LanSocket over an accepted WiFiClient, reads give up at the deadline */
+class WiFiLanSocket : public LanSocket {
+ public:
+  explicit WiFiLanSocket(WiFiClient& client) : client(client), deadline(millis() + LAN_API_TIMEOUT_MS) {}
+
+  int read() override {
+    while (!client.available()) {
+      if (!client.connected() || (int32_t)(millis() - deadline) >= 0) {
+        return -1;
+      }
+      delay(1);
+    }
+    return client.read();
+  }
+
+  size_t write(const uint8_t* data, size_t length) override { return client.write(data, length); }
+
+ private:
+  WiFiClient& client;
+  uint32_t deadline;
+};
+
+/* Keeps its own history of every reading, requests are served on this sink's worker */
+class LanSink : public UplinkSink {
+ public:
+  void take(const Reading& reading) override { lanApi.add(reading); }
+  SinkResult flush() override { return serveLanClient(); }
+};
+#endif
+
+// name, queue, rate limit, retry delay, max retry delay, breaker threshold, core, priority, stack, heap probe
+const SinkPolicy backendPolicy = { "backend", READING_QUEUE_LENGTH, 0, 5000, 300000, 3, PRO_CPU_NUM, 2, 8192, true };
+const SinkPolicy firebasePolicy = { "firebase", 1, 60000, 10000, 300000, 2, PRO_CPU_NUM, 1, 8192, false };
+const SinkPolicy alertPolicy = { "alerts", 4, 0, 2000, 60000, 3, PRO_CPU_NUM, 3, 8192, false };
+#if LAN_API
+const SinkPolicy lanPolicy = { "lan", READING_QUEUE_LENGTH, 0, 1000, 1000, 3, PRO_CPU_NUM, 1, 6144, false };
+#endif
+
+BackendSink backendSink;
+FirebaseSink firebaseSink;
+AlertSink alertSink;
+#if LAN_API
+LanSink lanSink;
+#endif
+uint32_t lastReportMs = 0;
 
 void setup() {
   Serial.begin(115200);
-  Serial.println("🌾 ESP32 Storage Monitor Starting...");
+  beginLog();
+  logInfo("🌾 ESP32 Storage Monitor %s Starting...\n", FIRMWARE_VERSION);
   
-  dht.begin();
+  beginProbes();
 
-  // Connect to WiFi
-  Serial.print("📡 Connecting to WiFi: ");
-  Serial.println(ssid);
-  WiFi.begin(ssid, password);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  // Tuning from the last config poll, before anything uses the endpoints or limits
+  remoteConfig.begin(configStore);
+  applyStoredConfig();
+
+  // URLs and headers are formatted once here, never per upload
+  char configPath[96];
+  snprintf(configPath, sizeof(configPath), "/api/storage/devices/%s/config", deviceId);
+  backendUplink.prepare(configHead, "GET", configPath, "application/json");
+  backendUplink.prepare(batchHead, "POST", "/api/storage/readings/batch", BATCH_CONTENT_TYPE);
+  backendUplink.prepare(aggregateHead, "POST", "/api/storage/aggregates/batch", UPLINK_CONTENT_TYPE);
+  alertUplink.prepare(alertHead, "POST", "/api/storage/alerts", "application/json");
+  aggregator.setWindows(AGGREGATE_WINDOW_MS, AGGREGATE_WINDOWS);  // Windows still open in RTC memory carry on
+
+  char firebasePath[96];
+  snprintf(firebasePath, sizeof(firebasePath), "/sensor.json?auth=%s", firebaseAuth);
+  firebaseClient.setInsecure();  // Same as HTTPClient without a CA certificate
+  firebaseClient.setHandshakeTimeout(FIREBASE_HANDSHAKE_TIMEOUT_S);
+  firebaseUplink.prepare(firebaseHead, "PUT", firebasePath, "application/json");
+
+  // Readings journaled before a reboot are replayed once the backend is back
+  if (bootSession == 0) {
+    bootSession = esp_random();  // Deep sleep wakes keep the session of the power-on boot
   }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\n✅ WiFi Connected!");
-    Serial.print("📍 IP Address: ");
-    Serial.println(WiFi.localIP());
+  journalReady = flashStorage.begin() && journal.begin();
+  if (journalReady) {
+    logInfo("💾 Journal ready, %u readings waiting for upload\n", journal.pending());
   } else {
-    Serial.println("\n❌ WiFi Connection Failed!");
+    logError("❌ LittleFS mount failed, failed uploads will not be kept\n");
+  }
+
+  wifiLink.begin();
+
+#if POWER_PROFILE_DEEP_SLEEP
+  runDeepSleepCycle();  // Never returns
+#endif
+
+  // Connect to WiFi in the background, sampling starts right away
+  logInfo("📡 Connecting to WiFi: %s\n", ssid);
+  ensureWiFi();
+
+  if (gasDmaReady) {
+    startAdcAcquisition();
   }
+#if !POWER_PROFILE_DEEP_SLEEP
+  startProbeTask();  // Reads every probe once, the first sample needs them
+#endif
+
+  // The backend and Firebase upload concurrently, a slow Firebase never delays the backend
+  addUplinkSink(backendSink, backendPolicy, wifiUp);
+  addUplinkSink(firebaseSink, firebasePolicy, wifiUp);
+  addUplinkSink(alertSink, alertPolicy, wifiUp);
+#if LAN_API
+  lanApi.configure(deviceId, AGGREGATE_WINDOW_MS, AGGREGATE_WINDOWS, epochMsAt);
+  addUplinkSink(lanSink, lanPolicy, wifiUp);
+#endif
+
+  // Sampler on the APP core, uploader next to the WiFi stack on the PRO core
+  startPipeline(readSensors, ensureWiFi, bufferReading, reportUplinks);
 }
 
 void loop() {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("⚠️ WiFi disconnected, reconnecting...");
-    WiFi.begin(ssid, password);
-    delay(5000);
-    return;
+  // All work happens in the sampler and uploader tasks
+  vTaskDelete(NULL);
+}
+
+#if POWER_PROFILE_DEEP_SLEEP
+/* One wake: read, buffer in RTC memory, upload when the uplink interval ran out, sleep */
+void runDeepSleepCycle() {
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+    // Measured on the RTC, this also carries monotonicMs() across the sleep
+    energy.add(POWER_SLEEP, resumeSleepClock());
   }
+  wakeCount++;
 
-  // Read sensors
-  float humidity = dht.readHumidity();
-  float temperature = dht.readTemperature();
+  uint32_t heaterMs = 0;
+  if (MQ135_HEATER_PIN >= 0) {
+    uint32_t started = millis();
+    warmUpGasSensor();
+    heaterMs = millis() - started;
+    energy.add(POWER_HEATER, heaterMs);
+  }
 
-  // Check if DHT reading failed
-  if (isnan(humidity) || isnan(temperature)) {
-    Serial.println("❌ Failed to read from DHT sensor!");
-    delay(2000);
-    return;
+  for (int i = 1; gasDmaReady && i < DEEP_SLEEP_ADC_BURSTS; i++) {
+    acquireAdcBurst();  // setup() took the first one
   }
 
-  int adc = analogRead(MQ135_PIN);
-  float voltage = adc * (3.3 / 4095.0);
-  float Rs = ((3.3 - voltage) / voltage) * RL;
-  float ratio = Rs / R0;
+  Reading reading = {};
+  sleepRate.setBounds(samplingBounds(remoteConfig.current(), DEEP_SLEEP_RATE_BOUNDS));
+  if (readSensors(reading)) {
+    sleepRate.update(reading);
+    reading.sequence = sleepSequence++;
+    bufferReading(reading);
+    energy.countReading();
+  }
+
+  uint32_t radioMs = 0;
+  uploadBreaker.configure(DEEP_SLEEP_BREAKER_DELAY_MS, DEEP_SLEEP_BREAKER_MAX_DELAY_MS, 2, esp_random());
+  bool due = monotonicMs() - lastUploadMs >= sleepRate.uplinkIntervalMs() ||
+             pendingReadings.full() || pendingAggregates.full();
+  bool alerting = pendingAlert.channels != 0 && pendingAlert.attempts == 0;  // A new alert gets one try past the breaker
+  if ((due && uploadBreaker.allow((uint32_t)monotonicMs())) || alerting) {
+    lastUploadMs = monotonicMs();
+    uint32_t started = millis();
+    uploadBeforeSleep();
+    radioMs = millis() - started;
+  }
+
+  // Everything else this wake (boot, sensor reads, logging) counts as sampling
+  uint32_t awake = millis();
+  energy.add(POWER_SAMPLE, awake - heaterMs - radioMs);
+
+  logInfo("🔋 Wake %u: %u readings and %u windows buffered, %.2f mJ/reading, avg %.3f mA, ~%.0f days on %u mAh\n",
+            wakeCount, (unsigned)pendingReadings.size(), (unsigned)pendingAggregates.size(),
+            energy.millijoulesPerReading(ESP32_WROOM_PROFILE),
+            energy.averageCurrentMa(ESP32_WROOM_PROFILE),
+            energy.batteryDays(ESP32_WROOM_PROFILE, BATTERY_CAPACITY_MAH), BATTERY_CAPACITY_MAH);
+  logInfo("⏱️ Next reading in %us (%.2f/min effective), uplink every %us\n",
+          sleepRate.intervalMs() / 1000, sleepRate.samplesPerMinute(), sleepRate.uplinkIntervalMs() / 1000);
+  logFlush();
+
+  uint32_t periodMs = sleepRate.intervalMs();
+  uint32_t sleepMs = awake < periodMs - 1000 ? periodMs - awake : 1000;
+  beginSleepClock();
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000);
+  esp_deep_sleep_start();
+}
+
+/* Powers the MQ135 heater just long enough for one reading */
+void warmUpGasSensor() {
+  pinMode(MQ135_HEATER_PIN, OUTPUT);
+  digitalWrite(MQ135_HEATER_PIN, HIGH);
+  delay(MQ135_WARMUP_MS);
+}
+
+/* Brings WiFi up once, sends everything buffered and some of the journal, then turns the radio off */
+void uploadBeforeSleep() {
+  uint32_t started = millis();
+  while (!wifiLink.poll(millis()) && millis() - started < DEEP_SLEEP_WIFI_TIMEOUT_MS) {
+    delay(20);
+  }
+  energy.add(POWER_WIFI_CONNECT, millis() - started);
+
+  started = millis();
+  SinkResult result = SINK_IDLE;
+  if (wifiLink.state() != WIFI_UP) {
+    logError("❌ WiFi Connection Failed, readings stay in RTC memory\n");
+  } else {
+    logInfo("✅ WiFi Connected in %ums (%s)\n", wifiLink.stats().lastJoinMs,
+              wifiLink.stats().fastJoins ? "cached access point" : "full scan");
+    uint32_t syncs = timeSyncCount();
+    startTimeSync();  // Readings sent before it answers use the previous wake's sync
+    result = flushAlert();
+    alertUplink.stop();
+    while (result != SINK_FAILED && !pendingAggregates.empty()) {
+      if (!sendAggregatesToBackend()) {
+        result = SINK_FAILED;
+        break;
+      }
+      result = SINK_SENT;
+    }
+    while (result != SINK_FAILED && !pendingReadings.empty()) {
+      size_t count = pendingReadings.size() < BATCH_MAX ? pendingReadings.size() : BATCH_MAX;
+      for (size_t i = 0; i < count; i++) {
+        batch[i] = pendingReadings.at(i);
+      }
+      if (!sendBatchToBackend(batch, count, true)) {
+        result = SINK_FAILED;
+        spillToJournal(count);
+        break;
+      }
+      result = SINK_SENT;
+      pendingReadings.discard(count);
+    }
+
+    for (int i = 0; i < DEEP_SLEEP_REPLAY_BATCHES && backendReachable && journalReady; i++) {
+      if (!replayJournalBatch()) {
+        break;
+      }
+    }
+    if (result != SINK_FAILED && remoteConfig.due((uint32_t)monotonicMs())) {
+      pollRemoteConfig();  // Takes effect from the next wake
+    }
+    backendUplink.stop();
+
+    // Re-anchor the epoch clock before the radio goes off, usually already done by now
+    uint32_t waited = millis();
+    while (timeSyncCount() == syncs && millis() - waited < DEEP_SLEEP_SNTP_WAIT_MS) {
+      delay(20);
+    }
+  }
+
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  energy.add(POWER_UPLOAD, millis() - started);
+
+  // A WiFi failure says nothing about the backend
+  if (result == SINK_SENT) {
+    uploadBreaker.recordSuccess();
+  } else if (result == SINK_FAILED) {
+    uploadBreaker.recordFailure((uint32_t)monotonicMs());
+    if (uploadBreaker.state() == BREAKER_OPEN) {
+      logWarn("🔌 Backend unreachable, no WiFi for %us\n", uploadBreaker.retryInMs((uint32_t)monotonicMs()) / 1000);
+    }
+  } else {
+    uploadBreaker.recordIdle();
+  }
+}
+#endif
+
+/* Registers the probes of PROBES, the MQ135s become the ADC DMA channels in table order */
+void beginProbes() {
+  uint8_t gasPins[ADC_MAX_CHANNELS];
+  uint8_t gasCount = 0;
+  for (const ProbeWiring& wiring : PROBES) {
+    bool gas = wiring.spec.kind == PROBE_GAS;
+    if (probeArray.count() == SENSOR_MAX_PROBES || (gas && gasCount == ADC_MAX_CHANNELS)) {
+      logError("❌ Probe %s left out, at most %u probes and %u MQ135s\n",
+               wiring.spec.name, SENSOR_MAX_PROBES, ADC_MAX_CHANNELS);
+      continue;
+    }
+
+    Probe* probe;
+    if (gas) {
+      probe = new Mq135Probe(wiring.pin, gasCount);
+      gasPins[gasCount++] = wiring.pin;
+    } else {
+      DhtProbe* dht = new DhtProbe(wiring.pin);
+      dht->begin();
+      probe = dht;
+    }
+    probeArray.add(*probe, wiring.spec);
+    size_t index = probeArray.count() - 1;
+    logInfo("🔌 Probe %s on GPIO %u, every %ums at +%ums\n", wiring.spec.name, wiring.pin,
+            probeArray.frame().periodMs[index], probeArray.phaseMs(index));
+  }
+  if (probeArray.collisions() > 0) {
+    logWarn("⚠️ %u DHT pairs share a read slot, lengthen their periods\n", probeArray.collisions());
+  }
+
+  // MQ135s are oversampled in DMA bursts; the first burst primes the filters before any reading
+  gasDmaReady = gasCount > 0 && beginAdcAcquisition(gasPins, gasCount) && acquireAdcBurst();
+  if (!gasDmaReady) {
+    logWarn("⚠️ ADC DMA mode unavailable, MQ135 falls back to analogRead()\n");
+  }
+}
+
+#if POWER_PROFILE_DEEP_SLEEP
+void takeFrame(SensorFrame& frame) {
+  frame = probeArray.frame();
+}
+#else
+void publishFrame() {
+  portENTER_CRITICAL(&frameLock);
+  publishedFrame = probeArray.frame();
+  portEXIT_CRITICAL(&frameLock);
+}
+
+void takeFrame(SensorFrame& frame) {
+  portENTER_CRITICAL(&frameLock);
+  frame = publishedFrame;
+  portEXIT_CRITICAL(&frameLock);
+}
+
+/* Reads one probe per wake, sleeps until the next one is due */
+void probeTask(void* param) {
+  for (;;) {
+    if (probeArray.poll((uint32_t)monotonicMs())) {
+      publishFrame();
+    }
+    vTaskDelay(pdMS_TO_TICKS(probeArray.dueInMs((uint32_t)monotonicMs())));
+  }
+}
+
+/* Every probe is read once so the first sample has values, then the task keeps them fresh */
+void startProbeTask() {
+  probeArray.readAll((uint32_t)monotonicMs());
+  publishFrame();
+  xTaskCreatePinnedToCore(probeTask, "probes", PROBE_TASK_STACK_SIZE, nullptr,
+                          PROBE_TASK_PRIORITY, nullptr, SAMPLER_CORE);
+}
+#endif
+
+void printProbeStats() {
+  for (size_t i = 0; i < probeArray.count(); i++) {
+    const ProbeStats& stats = probeArray.stats(i);
+    logInfo("🔌 Probe %s: %u reads, %u failed, %u skipped, %ums late at most\n", probeArray.frame().name[i],
+            stats.reads, stats.failures, stats.skipped, stats.maxLateMs);
+  }
+}
+
+/* Runs on the sampler task */
+bool readSensors(Reading& reading) {
+#if !POWER_PROFILE_DEEP_SLEEP
+  static uint32_t configSeen = 0;
+  DeviceConfig config;
+  if (takeConfig(configSeen, config)) {
+    setSamplingBounds(samplingBounds(config, CONTINUOUS_RATE_BOUNDS));
+    gasCalibration.setR0(config.r0 > 0.0f ? config.r0 : MQ135_R0);
+  }
+#endif
+
+#if POWER_PROFILE_DEEP_SLEEP
+  probeArray.readAll((uint32_t)monotonicMs());  // No probe task between deep sleeps
+#endif
+  SensorFrame frame;
+  takeFrame(frame);
+
+  // The room: climate averaged over the probes, gas from the worst spot
+  uint64_t now = monotonicMs();
+  RoomValues room;
+  if (!combineFrame(frame, (uint32_t)now, room)) {
+    logError(room.climateProbes == 0 ? "❌ Failed to read from DHT sensor!\n" : "❌ Failed to read from MQ135 sensor!\n");
+    return false;
+  }
+  logDebug("🔬 MQ135: code %.1f, worst of %u; climate from %u DHT\n", room.gasCode, room.gasProbes, room.climateProbes);
+
+  // Precomputed curves: a table read instead of five pow() calls
+  float ppm[GAS_CHANNELS];
+  gasCalibration.convert(room.gasCode, ppm);
+
+  reading.capturedAtMs = (uint32_t)now;
+  reading.epochMs = epochMsAt(now);
+  reading.temperature = room.temperature;
+  reading.humidity = room.humidity;
 
   /* Scaled gas values */
-  float co2 = getPPM(ratio, 116.6, -2.77) * SCALE;
-  float ammonia = getPPM(ratio, 102.2, -2.473) * SCALE;
-  float methane = getPPM(ratio, 50.0, -2.3) * SCALE;
-  float ethylene = getPPM(ratio, 70.0, -2.5) * SCALE;
-  float h2s = getPPM(ratio, 40.0, -2.1) * SCALE;
-
-  // Display readings
-  Serial.println("\n📊 Sensor Readings:");
-  Serial.printf("🌡️  Temperature: %.1f°C\n", temperature);
-  Serial.printf("💧 Humidity: %.1f%%\n", humidity);
-  Serial.printf("💨 CO2: %.1f ppm\n", co2);
-  Serial.printf("💨 Ammonia: %.1f ppm\n", ammonia);
-  Serial.printf("💨 Methane: %.1f ppm\n", methane);
-  Serial.printf("💨 Ethylene: %.1f ppm\n", ethylene);
-  Serial.printf("💨 H2S: %.1f ppm\n", h2s);
-
-  // Send to Local Backend (HarvestHub)
-  sendToBackend(temperature, humidity, co2, ammonia, methane, ethylene, h2s);
-  
-  // Send to Firebase (Optional backup)
-  sendToFirebase(temperature, humidity, co2, ammonia, methane, ethylene, h2s);
+  reading.co2 = ppm[GAS_CO2];
+  reading.ammonia = ppm[GAS_AMMONIA];
+  reading.methane = ppm[GAS_METHANE];
+  reading.ethylene = ppm[GAS_ETHYLENE];
+  reading.h2s = ppm[GAS_H2S];
 
-  delay(5000);  // Read every 5 seconds
+  return true;
 }
 
-void sendToBackend(float temp, float hum, float co2, float ammonia, float methane, float ethylene, float h2s) {
-  HTTPClient http;
-  
-  String url = "http://" + String(backendHost) + ":" + String(backendPort) + "/api/storage/readings";
-  
-  Serial.println("\n📤 Sending to Backend: " + url);
-  
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
+/* Runs on the sink workers, never blocks */
+bool wifiUp() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+/* Runs on the uploader task, returns right away whatever the link is doing */
+bool ensureWiFi() {
+  static WifiLinkState previous = WIFI_DOWN;
+  static uint32_t previousFastJoins = 0;
+
+  bool up = wifiLink.poll(millis());
+  WifiLinkState state = wifiLink.state();
+  if (state != previous) {
+    const WifiLinkStats& stats = wifiLink.stats();
+    if (state == WIFI_UP) {
+      logInfo("✅ WiFi Connected in %ums (%s), IP %s\n", stats.lastJoinMs,
+                stats.fastJoins != previousFastJoins ? "cached access point" : "full scan",
+                WiFi.localIP().toString().c_str());
+      previousFastJoins = stats.fastJoins;
+      startTimeSync();
+    } else if (previous == WIFI_UP) {
+      logWarn("⚠️ WiFi disconnected, reconnecting...\n");
+    } else if (state == WIFI_BACKOFF) {
+      logError("❌ WiFi Connection Failed, retrying later\n");
+    }
+    previous = state;
+  }
+  return up;
+}
+
+void printWifiStats() {
+  const WifiLinkStats& stats = wifiLink.stats();
+  logInfo("📶 WiFi: connects=%u (fast %u) drops=%u failed=%u join last=%ums max=%ums\n",
+            stats.connects, stats.fastJoins, stats.drops, stats.failedJoins, stats.lastJoinMs, stats.maxJoinMs);
+  logInfo("📶 Join times: <250ms:%u <500ms:%u <1s:%u <2s:%u <5s:%u <10s:%u >=10s:%u\n",
+            stats.histogram[0], stats.histogram[1], stats.histogram[2], stats.histogram[3],
+            stats.histogram[4], stats.histogram[5], stats.histogram[6]);
+}
+
+/* Runs on the uploader task */
+void bufferReading(const Reading& sampled) {
+  Reading reading = sampled;
+
+#if !POWER_PROFILE_DEEP_SLEEP
+  static uint32_t configSeen = 0;
+  DeviceConfig config;
+  if (takeConfig(configSeen, config)) {
+    applyCropProfile(config.cropProfile[0] != '\0' ? config.cropProfile : cropProfile);
+  }
+#endif
+
+  StorageStatus previous = classifier.status();
+  reading.status = classifier.classify(reading);
+  if (reading.status != previous) {
+    reading.flags |= READING_STATUS_CHANGED;
+    if (previous != STATUS_UNKNOWN) {
+      logWarn("⚠️ Storage status %s -> %s\n", storageStatusName(previous), storageStatusName(classifier.status()));
+    }
+  }
+
+  // Display readings, two log records instead of one per line
+  logInfo("\n📊 Sensor Readings (#%u):\n"
+          "🌡️  Temperature: %.1f°C\n"
+          "💧 Humidity: %.1f%%\n",
+          reading.sequence, reading.temperature, reading.humidity);
+  logInfo("💨 CO2: %.1f ppm\n"
+          "💨 Ammonia: %.1f ppm\n"
+          "💨 Methane: %.1f ppm\n"
+          "💨 Ethylene: %.1f ppm\n"
+          "💨 H2S: %.1f ppm\n"
+          "📦 Status: %s (%s)\n",
+          reading.co2, reading.ammonia, reading.methane, reading.ethylene, reading.h2s,
+          storageStatusName(classifier.status()), classifier.profile().name);
+
+  // Every reading goes to the sinks: the backend aggregates them, Firebase filters its own
+#if POWER_PROFILE_DEEP_SLEEP
+  backendSink.take(reading);  // No sink workers between deep sleeps
+  alertSink.take(reading);
+#else
+  publishReading(reading);
+#endif
+}
+
+/* Runs on the uploader task while WiFi is up */
+void reportUplinks() {
+  if (millis() - lastReportMs < STATS_REPORT_INTERVAL_MS) {
+    return;
+  }
+  lastReportMs = millis();
+
+  printPipelineStats();
+  printProbeStats();
+  printUplinkStats();
+  printWifiStats();
+  printClockStats();
+  logInfo("📊 History: %u windows closed, %u raw readings sent, %u aggregated only\n",
+            aggregator.closedCount(), rawGate.sentCount(), rawGate.heldCount());
+  logInfo("🚨 Detectors: %u trips\n", gasDetector.tripCount());
+  logInfo("📦 Status: %s (%s), %u changes\n", storageStatusName(classifier.status()),
+          classifier.profile().name, classifier.transitionCount());
+  logInfo("🔇 Firebase deadband: %u readings sent, %u suppressed\n",
+            deadband.admittedCount(), deadband.suppressedCount());
+  logInfo("⚙️ Config: %u polls, %u applied, %u rejected\n",
+          remoteConfig.pollCount(), remoteConfig.appliedCount(), remoteConfig.rejectedCount());
+#if LAN_API
+  const LanApiStats& lan = lanApi.stats();
+  logInfo("🏠 LAN API: %u requests (%u rejected, %u aborted), %u items in %u bytes, %u readings held\n",
+          lan.requests, lan.rejected, lan.aborted, lan.itemsServed, lan.bytesServed, (unsigned)lanApi.readingCount());
+#endif
+}
+
+#if LAN_API
+/* Runs on the LAN sink worker while WiFi is up, one client per call */
+SinkResult serveLanClient() {
+  if (!lanServerStarted) {
+    lanServer.begin();  // Listens on every address, so a new DHCP lease needs no restart
+    lanServer.setNoDelay(true);
+    lanServerStarted = true;
+    logInfo("🏠 LAN API on http://%s:%d/api/readings\n", WiFi.localIP().toString().c_str(), LAN_API_PORT);
+  }
+
+  WiFiClient client = lanServer.available();
+  if (!client) {
+    return SINK_IDLE;
+  }
+  WiFiLanSocket socket(client);
+  lanApi.handle(socket, monotonicMs());
+  client.stop();
+  return SINK_SENT;
+}
+#endif
+
+/* Runs on the backend sink worker, sees every reading */
+void bufferForBackend(const Reading& reading) {
+  // Judged against the windows before the reading joins them
+  bool anomaly = aggregator.isAnomaly(reading);
+
+  size_t closed = aggregator.add(reading, closedWindows);
+  for (size_t i = 0; i < closed; i++) {
+    if (!pendingAggregates.push(closedWindows[i])) {
+      logWarn("⚠️ Aggregate buffer full, oldest window dropped\n");
+    }
+  }
+
+  if (anomaly) {
+    logInfo("🚨 Reading #%u is far off the %u min average, sending raw readings around it\n",
+            reading.sequence, AGGREGATE_WINDOW_MS[AGGREGATE_WINDOWS - 1] / 60000);
+  }
+  bool statusChanged = reading.flags & READING_STATUS_CHANGED;
+  size_t count = rawGate.admit(reading, anomaly || statusChanged, rawReadings);
+  for (size_t i = 0; i < count; i++) {
+    bufferRawReading(rawReadings[i]);
+  }
+}
+
+void bufferRawReading(const Reading& reading) {
+  // Move the oldest readings to flash rather than overwriting them
+  if (pendingReadings.full()) {
+    spillToJournal(BATCH_MAX);
+  }
+  if (!pendingReadings.push(reading)) {
+    logWarn("⚠️ Reading buffer full, oldest reading dropped\n");
+  }
+}
+
+/* Runs on the backend sink worker while WiFi is up */
+SinkResult flushToBackend() {
+  if (remoteConfig.due((uint32_t)monotonicMs())) {
+    pollRemoteConfig();
+  }
+
+  bool due = millis() - lastFlushMs >= uplinkIntervalMs();
+  bool aggregatesDue = !pendingAggregates.empty() && (pendingAggregates.size() >= AGGREGATE_BATCH_MAX || due);
+  bool readingsDue = !pendingReadings.empty() && (pendingReadings.size() >= BATCH_SIZE || due);
+  if (aggregatesDue || readingsDue) {
+    lastFlushMs = millis();
+
+    // Aggregates stay in RAM until the backend takes them, they are not journaled
+    if (!pendingAggregates.empty() && !sendAggregatesToBackend()) {
+      return SINK_FAILED;
+    }
+    if (pendingReadings.empty()) {
+      return SINK_SENT;
+    }
+
+    // Send to Local Backend (HarvestHub), oldest readings first
+    size_t count = pendingReadings.size() < BATCH_MAX ? pendingReadings.size() : BATCH_MAX;
+    for (size_t i = 0; i < count; i++) {
+      batch[i] = pendingReadings.at(i);
+    }
+    if (sendBatchToBackend(batch, count, true)) {
+      pendingReadings.discard(count);  // Delivered or permanently rejected
+      return SINK_SENT;
+    }
+    spillToJournal(count);
+    return SINK_FAILED;
+  }
+
+  return replayJournal();
+}
+
+/* Moves the count oldest buffered readings into the flash journal */
+void spillToJournal(size_t count) {
+  if (!journalReady) {
+    return;  // Readings stay in RAM until the ring overwrites them
+  }
+  if (count > pendingReadings.size()) {
+    count = pendingReadings.size();
+  }
+
+  size_t written = 0;
+  while (written < count && journal.append(pendingReadings.at(written), bootSession)) {
+    written++;
+  }
+  pendingReadings.discard(written);
 
-  // Create JSON payload
-  JsonDocument doc;
+  JournalStats stats = journal.stats();
+  logInfo("💾 Journaled %u readings (%u waiting, %u dropped, segment wear %u-%u)\n",
+                (unsigned)written, stats.pending, stats.dropped, stats.minWear, stats.maxWear);
+}
+
+/* Replays journaled readings in rate-limited batches once the backend answers again */
+SinkResult replayJournal() {
+  if (!journalReady || !backendReachable || journal.pending() == 0) {
+    return SINK_IDLE;
+  }
+  if (millis() - lastReplayMs < JOURNAL_REPLAY_INTERVAL_MS) {
+    return SINK_IDLE;
+  }
+  lastReplayMs = millis();
+
+  return replayJournalBatch() ? SINK_SENT : SINK_FAILED;
+}
+
+/* Sends the oldest journaled batch, true if the journal advanced */
+bool replayJournalBatch() {
+  uint32_t session = 0;
+  size_t count = journal.peek(batch, BATCH_MAX, session);
+  if (count == 0) {
+    return false;
+  }
+
+  logInfo("♻️ Replaying %u journaled readings (%u waiting)\n", (unsigned)count, journal.pending());
+  if (!sendBatchToBackend(batch, count, session == bootSession)) {
+    return false;
+  }
+  journal.commit(count);
+  return true;
+}
+
+bool sendBatchToBackend(const Reading* readings, size_t count, bool sameBoot) {
+  logInfo("\n📤 Sending %u readings to Backend: http://%s:%d/api/storage/readings/batch\n",
+                (unsigned)count, backendHost, backendPort);
+
+#if UPLINK_SERIES
+  return sendSeriesBatch(readings, count, sameBoot);
+#else
+  // Build payload, device fields once for the whole batch
+  jsonArena.reset();
+  JsonDocument doc(&jsonArena);
   doc["farmerId"] = farmerId;
   doc["deviceId"] = deviceId;
-  doc["temperature"] = temp;
-  doc["humidity"] = hum;
-  doc["CO2"] = co2;
-  doc["ammonia"] = ammonia;
-  doc["methane"] = methane;
-  doc["ethylene"] = ethylene;
-  doc["H2S"] = h2s;
-
-  String json;
-  serializeJson(doc, json);
-  
-  Serial.println("📋 JSON: " + json);
+  JsonArray items = doc["readings"].to<JsonArray>();
 
-  int httpCode = http.POST(json);
-  
-  if (httpCode > 0) {
-    Serial.printf("✅ Backend response: %d\n", httpCode);
-    if (httpCode == 200) {
-      String response = http.getString();
-      Serial.println("📥 Response: " + response);
+  uint64_t now = monotonicMs();
+  for (size_t i = 0; i < count; i++) {
+    const Reading& reading = readings[i];
+    JsonObject item = items.add<JsonObject>();
+    item["seq"] = reading.sequence;
+    if (reading.suppressed > 0) {
+      item["suppressed"] = reading.suppressed;
     }
+
+    // Captured before the first SNTP sync: stamp it now if the monotonic clock still applies
+    uint32_t age = (uint32_t)now - reading.capturedAtMs;
+    uint64_t epoch = reading.epochMs;
+    if (epoch == 0 && sameBoot) {
+      epoch = epochMsAt(now - age);
+    }
+    if (epoch != 0) {
+      item["ts"] = epoch;
+    } else if (sameBoot) {
+      item["ageMs"] = age;  // The clock restarts on reboot, older ages are unknown
+    }
+    if (reading.status != STATUS_UNKNOWN) {
+      item["status"] = storageStatusName((StorageStatus)reading.status);
+    }
+
+    // Heartbeat while nothing changed: status and time only, the values are in the aggregates
+    if (reading.flags & READING_STATUS_ONLY) {
+      continue;
+    }
+    item["temperature"] = reading.temperature;
+    item["humidity"] = reading.humidity;
+    item["CO2"] = reading.co2;
+    item["ammonia"] = reading.ammonia;
+    item["methane"] = reading.methane;
+    item["ethylene"] = reading.ethylene;
+    item["H2S"] = reading.h2s;
+  }
+
+  // A single probe is the reading itself, several go along once per batch
+  if (probeArray.count() > 1) {
+    addProbeColumns(doc);
+  }
+
+  return postToBackend(batchHead, doc, "readings", count);
+#endif
+}
+
+#if !UPLINK_SERIES
+/* The latest value of every probe, one array per field like the frame; null where a probe has none */
+void addProbeColumns(JsonDocument& doc) {
+  SensorFrame frame;
+  takeFrame(frame);
+  uint32_t now = (uint32_t)monotonicMs();
+
+  JsonObject probes = doc["probes"].to<JsonObject>();
+  JsonArray names = probes["name"].to<JsonArray>();
+  JsonArray ages = probes["ageMs"].to<JsonArray>();
+  JsonArray temperature = probes["temperature"].to<JsonArray>();
+  JsonArray humidity = probes["humidity"].to<JsonArray>();
+  static const char* const GAS_KEYS[GAS_CHANNELS] = { "CO2", "ammonia", "methane", "ethylene", "H2S" };
+  JsonArray gas[GAS_CHANNELS];
+  for (int channel = 0; channel < GAS_CHANNELS; channel++) {
+    gas[channel] = probes[GAS_KEYS[channel]].to<JsonArray>();
+  }
+
+  for (size_t i = 0; i < frame.count; i++) {
+    bool read = frame.readAtMs[i] != 0;
+    bool climate = read && frame.kind[i] == PROBE_CLIMATE;
+    names.add(frame.name[i]);
+    if (read) {
+      ages.add(now - frame.readAtMs[i]);
+    } else {
+      ages.add(nullptr);
+    }
+    if (climate) {
+      temperature.add(frame.temperature[i]);
+      humidity.add(frame.humidity[i]);
+    } else {
+      temperature.add(nullptr);
+      humidity.add(nullptr);
+    }
+
+    float ppm[GAS_CHANNELS];
+    if (read && !climate) {
+      gasCalibration.convert(frame.gasCode[i], ppm);
+    }
+    for (int channel = 0; channel < GAS_CHANNELS; channel++) {
+      if (read && !climate) {
+        gas[channel].add(ppm[channel]);
+      } else {
+        gas[channel].add(nullptr);
+      }
+    }
+  }
+}
+#endif
+
+#if UPLINK_SERIES
+SeriesRow seriesRows[BATCH_MAX];
+SeriesEncoder seriesEncoder;
+
+/* Same content as the JSON batch, one time column for the whole batch */
+bool sendSeriesBatch(const Reading* readings, size_t count, bool sameBoot) {
+  uint64_t now = monotonicMs();
+  bool haveEpoch = false;
+  for (size_t i = 0; i < count; i++) {
+    const Reading& reading = readings[i];
+    SeriesRow& row = seriesRows[i];
+    uint32_t age = (uint32_t)now - reading.capturedAtMs;
+    uint64_t epoch = reading.epochMs;
+    if (epoch == 0 && sameBoot) {
+      epoch = epochMsAt(now - age);
+    }
+    haveEpoch |= epoch != 0;
+    row.timeMs = (int64_t)epoch;  // 0 = unknown, stored at arrival
+    row.sequence = reading.sequence;
+    row.suppressed = reading.suppressed;
+    row.status = reading.status;
+    row.flags = reading.flags;
+    row.values[0] = reading.temperature;
+    row.values[1] = reading.humidity;
+    row.values[2] = reading.co2;
+    row.values[3] = reading.ammonia;
+    row.values[4] = reading.methane;
+    row.values[5] = reading.ethylene;
+    row.values[6] = reading.h2s;
+  }
+
+  // Not synced yet: send ages instead, they only mean something within this boot
+  SeriesTimeMode mode = haveEpoch ? SERIES_TIME_EPOCH : (sameBoot ? SERIES_TIME_AGE : SERIES_TIME_NONE);
+  if (mode == SERIES_TIME_AGE) {
+    for (size_t i = 0; i < count; i++) {
+      seriesRows[i].timeMs = (uint32_t)now - readings[i].capturedAtMs;
+    }
+  }
+
+  seriesEncoder.begin(payload, PAYLOAD_MAX, mode, farmerId, deviceId);
+  for (uint8_t c = 2; c < SERIES_CHANNELS; c++) {
+    seriesEncoder.setPrecision(c, SERIES_GAS_MANTISSA_BITS);
+  }
+  for (size_t i = 0; i < count; i++) {
+    seriesEncoder.add(seriesRows[i]);
+  }
+  size_t length = seriesEncoder.finish();
+  if (length == 0) {
+    logError("❌ Payload too large, dropping %u readings\n", (unsigned)count);
+    return true;
+  }
+
+  logDebug("📋 Series: %u bytes (%u per reading)\n", (unsigned)length, (unsigned)(length / count));
+  return deliverToBackend(batchHead, length, "readings", count);
+}
+#endif
+
+/* Sends the oldest buffered aggregates, true if they left the buffer (delivered or rejected) */
+bool sendAggregatesToBackend() {
+  size_t count = pendingAggregates.size() < AGGREGATE_BATCH_MAX ? pendingAggregates.size() : AGGREGATE_BATCH_MAX;
+  logInfo("\n📤 Sending %u aggregates to Backend: http://%s:%d/api/storage/aggregates/batch\n",
+          (unsigned)count, backendHost, backendPort);
+
+  jsonArena.reset();
+  JsonDocument doc(&jsonArena);
+  doc["farmerId"] = farmerId;
+  doc["deviceId"] = deviceId;
+  JsonArray items = doc["aggregates"].to<JsonArray>();
+
+  static const char* const channelKeys[READING_CHANNELS] = {
+    "temperature", "humidity", "CO2", "ammonia", "methane", "ethylene", "H2S"
+  };
+
+  uint64_t now = monotonicMs();
+  for (size_t i = 0; i < count; i++) {
+    const AggregateRecord& record = pendingAggregates.at(i);
+    JsonObject item = items.add<JsonObject>();
+
+    // Windows opened before the first SNTP sync are stamped like readings
+    uint32_t age = (uint32_t)now - record.startMs;
+    uint64_t epoch = record.startEpochMs != 0 ? record.startEpochMs : epochMsAt(now - age);
+    if (epoch != 0) {
+      item["ts"] = epoch;
+    } else {
+      item["ageMs"] = age;
+    }
+    item["durationMs"] = record.durationMs;
+    item["count"] = record.count;
+
+    // [min, max, mean, stddev], channels without a valid sample are left out
+    for (int c = 0; c < READING_CHANNELS; c++) {
+      const ChannelSummary& summary = record.channels[c];
+      if (isnan(summary.mean)) {
+        continue;
+      }
+      JsonArray values = item[channelKeys[c]].to<JsonArray>();
+      values.add(summary.min);
+      values.add(summary.max);
+      values.add(summary.mean);
+      values.add(summary.stddev);
+    }
+  }
+
+  if (!postToBackend(aggregateHead, doc, "aggregates", count)) {
+    return false;
+  }
+  pendingAggregates.discard(count);
+  return true;
+}
+
+/* Serializes and POSTs one batch, true unless it is worth retrying later */
+bool postToBackend(const HttpRequestHead& head, JsonDocument& doc, const char* what, size_t count) {
+#if UPLINK_MSGPACK
+  size_t needed = measureMsgPack(doc);
+#else
+  size_t needed = measureJson(doc);
+#endif
+  if (doc.overflowed() || needed >= PAYLOAD_MAX) {
+    logError("❌ Payload too large (%u bytes), dropping %u %s\n", (unsigned)needed, (unsigned)count, what);
+    return true;
+  }
+
+#if UPLINK_MSGPACK
+  size_t length = serializeMsgPack(doc, payload, PAYLOAD_MAX);
+#else
+  size_t length = serializeJson(doc, (char*)payload, PAYLOAD_MAX);
+#endif
+
+  logDebug("📋 %s: %u bytes\n", UPLINK_FORMAT_NAME, (unsigned)length);
+  return deliverToBackend(head, length, what, count);
+}
+
+/* POSTs the first length bytes of payload, true unless it is worth retrying later */
+bool deliverToBackend(const HttpRequestHead& head, size_t length, const char* what, size_t count) {
+  int httpCode = backendUplink.send(head, payload, length);
+  backendUplink.printStats();
+  backendReachable = httpCode > 0 && httpCode < 500;
+
+  if (httpCode >= 200 && httpCode < 300) {
+    logInfo("✅ Backend response: %d\n", httpCode);
+    logDebug("📥 Response: %s\n", backendUplink.response());
+    return true;
+  }
+
+  if (httpCode >= 400 && httpCode < 500) {
+    // Retrying a rejected payload would block the buffer forever
+    logError("❌ Backend rejected batch: %d, dropping %u %s\n", httpCode, (unsigned)count, what);
+    return true;
+  }
+
+  if (httpCode > 0) {
+    logError("❌ Backend response: %d, keeping %u %s\n", httpCode, (unsigned)count, what);
   } else {
-    Serial.printf("❌ Backend error: %s\n", http.errorToString(httpCode).c_str());
+    logError("❌ Backend error: %s, keeping %u %s\n",
+                  HTTPClient::errorToString(httpCode).c_str(), (unsigned)count, what);
   }
-  
-  http.end();
+  return false;
+}
+
+/* Boot: the stored config replaces the compiled endpoint, profile, R0 and sampling bounds */
+void applyStoredConfig() {
+  const DeviceConfig& config = remoteConfig.current();
+  if (config.backendHost[0] != '\0' || config.backendPort != 0) {
+    if (config.backendHost[0] != '\0') {
+      strcpy(configuredHost, config.backendHost);  // Own copy, a later poll rewrites the config
+      backendHost = configuredHost;
+    }
+    if (config.backendPort != 0) {
+      backendPort = config.backendPort;
+    }
+    backendUplink.setEndpoint(backendHost, backendPort);
+    alertUplink.setEndpoint(backendHost, backendPort);
+  }
+  applyCropProfile(config.cropProfile[0] != '\0' ? config.cropProfile : cropProfile);
+  if (config.r0 > 0.0f) {
+    gasCalibration.setR0(config.r0);
+  }
+#if !POWER_PROFILE_DEEP_SLEEP
+  setSamplingBounds(samplingBounds(config, CONTINUOUS_RATE_BOUNDS));  // The sampler is not running yet
+#endif
+  if (config.etag[0] != '\0') {
+    logDebug("⚙️ Config %s: backend %s:%d, profile %s, R0 %.1f kOhm\n", config.etag, backendHost, backendPort,
+            classifier.profile().name, gasCalibration.r0());
+  }
+}
+
+/* Switching profile restarts the hysteresis, so only do it when it really changed */
+void applyCropProfile(const char* name) {
+  const CropProfile* profile = findCropProfile(name);
+  if (profile == nullptr) {
+    logWarn("⚠️ Unknown crop profile '%s', using '%s'\n", name, classifier.profile().name);
+  } else if (profile != &classifier.profile()) {
+    classifier.setProfile(*profile);
+    logInfo("📦 Crop profile: %s\n", profile->name);
+  }
+}
+
+/* One conditional GET on the backend connection; unchanged, it is a 304 without a body */
+void pollRemoteConfig() {
+  HttpResponse response = { configBody, sizeof(configBody), 0, configEtag, sizeof(configEtag), nullptr };
+  int status = backendUplink.fetch(configHead, remoteConfig.etag(), response);
+
+  uint8_t changed = 0;
+  switch (remoteConfig.receive((uint32_t)monotonicMs(), status, configBody, response.length, configEtag, changed)) {
+    case CONFIG_APPLIED:
+      logInfo("⚙️ Config %s applied\n", configEtag);
+      if (changed & CONFIG_CHANGED_ENDPOINT) {
+        logWarn("⚙️ Backend endpoint changes take effect after a restart\n");
+      }
+#if !POWER_PROFILE_DEEP_SLEEP
+      publishConfig(remoteConfig.current());
+#endif
+      break;
+    case CONFIG_REJECTED:
+      logError("❌ Config %s rejected (%u bytes), keeping the current one\n", configEtag, (unsigned)response.length);
+      break;
+    case CONFIG_FAILED:
+      logWarn("⚠️ Config poll failed: %d\n", status);
+      break;
+    case CONFIG_UNCHANGED:
+      logDebug("⚙️ Config unchanged (%d)\n", status);
+      break;
+  }
+
+  const char* version = remoteConfig.current().firmwareVersion;
+  if ((status == 200 || status == 304) && version[0] != '\0' && strcmp(version, FIRMWARE_VERSION) != 0 &&
+      strcmp(version, failedFirmware) != 0) {
+    updateFirmware(version);
+  }
+}
+
+/* Patches the inactive slot while the download runs, restarts into it once the image checks out */
+void updateFirmware(const char* version) {
+  char path[96];
+  snprintf(path, sizeof(path), "/api/storage/firmware/%s/%s", FIRMWARE_VERSION, version);
+  if (!backendUplink.prepare(firmwareHead, "GET", path, "application/octet-stream") || !firmwareUpdate.begin()) {
+    logError("❌ No OTA slot for firmware %s, check the partition table\n", version);
+    strcpy(failedFirmware, version);
+    return;
+  }
+
+  logInfo("⬇️ Firmware %s -> %s into %s\n", FIRMWARE_VERSION, version, firmwareUpdate.slot());
+  uint32_t started = millis();
+  HttpResponse response = { nullptr, 0, 0, nullptr, 0, &firmwareUpdate };
+  int status = backendUplink.fetch(firmwareHead, nullptr, response);
+  if (status != 200) {
+    firmwareUpdate.abort();
+    logWarn("⚠️ No firmware patch %s -> %s yet (%d)\n", FIRMWARE_VERSION, version, status);
+    return;
+  }
+  if (!firmwareUpdate.finish()) {
+    DeltaStatus result = firmwareUpdate.status();
+    if (result == DELTA_DONE || result == DELTA_WRITE_FAILED) {
+      logError("❌ Firmware %s not written: %s\n", version, esp_err_to_name(firmwareUpdate.error()));
+    } else {
+      logError("❌ Firmware patch %s after %u bytes: %s\n", version, firmwareUpdate.patchBytes(), deltaStatusName(result));
+    }
+    // A dropped download or a flash hiccup is retried at the next poll, a patch that does not fit is not
+    if (result != DELTA_TRUNCATED && result != DELTA_READ_FAILED && result != DELTA_WRITE_FAILED) {
+      strcpy(failedFirmware, version);
+    }
+    return;
+  }
+
+  uint32_t elapsed = millis() - started;
+  logInfo("✅ Firmware %s: %u bytes from a %u byte patch in %ums, restarting\n", version, firmwareUpdate.written(),
+          firmwareUpdate.patchBytes(), elapsed);
+  spillToJournal(pendingReadings.size());  // Replayed by the new firmware
+  backendUplink.stop();
+  logFlush();
+  ESP.restart();
+}
+
+void publishConfig(const DeviceConfig& config) {
+  portENTER_CRITICAL(&configLock);
+  publishedConfig = config;
+  configGeneration = configGeneration + 1;
+  portEXIT_CRITICAL(&configLock);
+}
+
+/* Copy of the published config if it is newer than the caller has seen */
+bool takeConfig(uint32_t& seen, DeviceConfig& config) {
+  if (seen == configGeneration) {
+    return false;
+  }
+  portENTER_CRITICAL(&configLock);
+  config = publishedConfig;
+  seen = configGeneration;
+  portEXIT_CRITICAL(&configLock);
+  return true;
 }
 
-void sendToFirebase(float temp, float hum, float co2, float ammonia, float methane, float ethylene, float h2s) {
-  HTTPClient http;
+/* Runs on the alert sink worker, sees every reading */
+void detectSpoilage(const Reading& reading) {
+  uint8_t tripped = gasDetector.update(reading);
+  recentReadings.push(reading);
+  if (tripped == 0) {
+    return;
+  }
+
+  // The window of a new alert ends at the reading that tripped it
+  if (pendingAlert.channels == 0) {
+    pendingAlert.attempts = 0;
+    pendingAlert.windowCount = recentReadings.size();
+    for (size_t i = 0; i < recentReadings.size(); i++) {
+      pendingAlert.window[i] = recentReadings.at(i);
+    }
+  }
+  pendingAlert.channels |= tripped;
+  pendingAlert.reading = reading;
+
+  for (int i = 0; i < GAS_CHANNELS; i++) {
+    if (tripped & (1 << i)) {
+      GasChannel channel = (GasChannel)i;
+      logWarn("🚨 %s rising: %.1f ppm, baseline %.1f ppm\n", gasChannelName(channel),
+              gasReading(reading, channel), gasDetector.baselinePpm(channel));
+    }
+  }
+}
+
+/* Sends the pending alert, if any */
+SinkResult flushAlert() {
+  if (pendingAlert.channels == 0) {
+    return SINK_IDLE;
+  }
+  pendingAlert.attempts++;
+
+  // The channel furthest above its baseline leads the message
+  const Reading& reading = pendingAlert.reading;
+  GasChannel lead = GAS_CO2;
+  float leadRatio = 0;
+  for (int i = 0; i < GAS_CHANNELS; i++) {
+    GasChannel channel = (GasChannel)i;
+    float ratio = gasReading(reading, channel) / gasDetector.baselinePpm(channel);
+    if ((pendingAlert.channels & (1 << i)) && ratio > leadRatio) {
+      lead = channel;
+      leadRatio = ratio;
+    }
+  }
+
+  alertArena.reset();
+  JsonDocument doc(&alertArena);
+  doc["farmerId"] = farmerId;
+  doc["deviceId"] = deviceId;
+  doc["alertType"] = "gas";
+  doc["severity"] = leadRatio >= DETECTOR_CRITICAL_RATIO ? "critical" : "warning";
 
-  String url = String(firebaseHost) + "/sensor.json?auth=" + firebaseAuth;
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
+  char message[128];
+  snprintf(message, sizeof(message), "%s rising: %.1f ppm, %.1fx its usual level",
+           gasChannelName(lead), gasReading(reading, lead), leadRatio);
+  doc["message"] = message;
 
-  String json = "{";
-  json += "\"temperature\":" + String(temp) + ",";
-  json += "\"humidity\":" + String(hum) + ",";
-  json += "\"CO2\":" + String(co2) + ",";
-  json += "\"ammonia\":" + String(ammonia) + ",";
-  json += "\"methane\":" + String(methane) + ",";
-  json += "\"ethylene\":" + String(ethylene) + ",";
-  json += "\"H2S\":" + String(h2s) + ",";
-  json += "\"lastUpdate\":" + String(millis());
-  json += "}";
+  JsonArray channels = doc["channels"].to<JsonArray>();
+  for (int i = 0; i < GAS_CHANNELS; i++) {
+    if (pendingAlert.channels & (1 << i)) {
+      channels.add(gasChannelName((GasChannel)i));
+    }
+  }
+  JsonObject threshold = doc["threshold"].to<JsonObject>();
+  threshold["parameter"] = gasChannelName(lead);
+  threshold["expected"] = gasDetector.baselinePpm(lead);
+  threshold["actual"] = gasReading(reading, lead);
 
-  int httpCode = http.PUT(json);
+  uint64_t now = monotonicMs();
+  uint32_t age = (uint32_t)now - reading.capturedAtMs;
+  uint64_t epoch = reading.epochMs != 0 ? reading.epochMs : epochMsAt(now - age);
+  if (epoch != 0) {
+    doc["ts"] = epoch;
+  } else {
+    doc["ageMs"] = age;
+  }
+
+  JsonObject current = doc["currentReadings"].to<JsonObject>();
+  current["temperature"] = reading.temperature;
+  current["humidity"] = reading.humidity;
+  JsonObject gasLevels = current["gasLevels"].to<JsonObject>();
+  for (int i = 0; i < GAS_CHANNELS; i++) {
+    gasLevels[gasChannelName((GasChannel)i)] = gasReading(reading, (GasChannel)i);
+  }
+
+  // Readings up to the trip, oldest first, so the backend sees the rise itself
+  JsonArray window = doc["window"].to<JsonArray>();
+  for (uint8_t i = 0; i < pendingAlert.windowCount; i++) {
+    const Reading& sample = pendingAlert.window[i];
+    JsonObject item = window.add<JsonObject>();
+    item["ageMs"] = (uint32_t)now - sample.capturedAtMs;
+    for (int c = 0; c < GAS_CHANNELS; c++) {
+      item[gasChannelName((GasChannel)c)] = gasReading(sample, (GasChannel)c);
+    }
+  }
+
+  size_t length = serializeJson(doc, alertPayload, ALERT_PAYLOAD_MAX);
+  if (doc.overflowed() || length >= ALERT_PAYLOAD_MAX - 1) {
+    logError("❌ Alert payload too large, dropping alert\n");
+    pendingAlert.channels = 0;
+    return SINK_SENT;
+  }
+
+  logInfo("\n🚨 Sending alert to Backend: %s\n", message);
+  int httpCode = alertUplink.send(alertHead, (const uint8_t*)alertPayload, length);
+  if (httpCode >= 200 && httpCode < 500) {
+    if (httpCode >= 400) {
+      logError("❌ Backend rejected alert: %d\n", httpCode);
+    }
+    pendingAlert.channels = 0;
+    return SINK_SENT;
+  }
+  logError("❌ Alert not delivered (%d), retrying\n", httpCode);
+  return SINK_FAILED;
+}
+
+bool sendToFirebase(const Reading& reading) {
+  int length = snprintf(firebaseBody, sizeof(firebaseBody),
+                        "{\"temperature\":%.2f,\"humidity\":%.2f,\"CO2\":%.2f,\"ammonia\":%.2f,"
+                        "\"methane\":%.2f,\"ethylene\":%.2f,\"H2S\":%.2f,\"status\":\"%s\",\"lastUpdate\":%u}",
+                        reading.temperature, reading.humidity, reading.co2, reading.ammonia,
+                        reading.methane, reading.ethylene, reading.h2s,
+                        storageStatusName((StorageStatus)reading.status), reading.capturedAtMs);
+  if (length < 0 || length >= (int)sizeof(firebaseBody)) {
+    return true;  // Cannot be sent, retrying would not help
+  }
+
+  int httpCode = firebaseUplink.send(firebaseHead, (const uint8_t*)firebaseBody, length);
   
+  firebaseUplink.printStats();
   if (httpCode > 0) {
-    Serial.println("✅ Firebase updated");
+    logDebug("✅ Firebase updated\n");
   }
-  
-  http.end();
+  return httpCode > 0 && httpCode < 500;
 }
@@ -0,0 +1,26 @@
+#include <Preferences.h>
+#include "nvs_config.h"
+
+#define CONFIG_NVS_NAMESPACE "config"
+#define CONFIG_NVS_KEY "device"
+
+bool NvsConfigStore::load(DeviceConfig& config) {
+  Preferences preferences;
+  if (!preferences.begin(CONFIG_NVS_NAMESPACE, true)) {
+    return false;
+  }
+  bool loaded = preferences.getBytesLength(CONFIG_NVS_KEY) == sizeof(config) &&
+                preferences.getBytes(CONFIG_NVS_KEY, &config, sizeof(config)) == sizeof(config);
+  preferences.end();
+  return loaded;
+}
+
+bool NvsConfigStore::save(const DeviceConfig& config) {
+  Preferences preferences;
+  if (!preferences.begin(CONFIG_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  bool saved = preferences.putBytes(CONFIG_NVS_KEY, &config, sizeof(config)) == sizeof(config);
+  preferences.end();
+  return saved;
+}
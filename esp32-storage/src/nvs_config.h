@@ -0,0 +1,10 @@
+#pragma once
+
+#include "remote_config.h"
+
+/* ConfigStore in NVS: one blob, so a power cut leaves either the old or the new config */
+class NvsConfigStore : public ConfigStore {
+ public:
+  bool load(DeviceConfig& config) override;
+  bool save(const DeviceConfig& config) override;
+};
@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "pipeline.h"
+#include "esp_clock.h"
+#include "adaptive_rate.h"
+#include "log.h"
+
+static QueueHandle_t readingQueue = nullptr;
+static SampleFn sampleFn = nullptr;
+static LinkFn linkFn = nullptr;
+static UploadFn uploadFn = nullptr;
+static FlushFn flushFn = nullptr;
+
+/* Counters are only ever written by one task each, read by anyone */
+static volatile uint32_t sampledCount = 0;
+static volatile uint32_t uploadedCount = 0;
+static volatile uint32_t droppedCount = 0;
+static volatile uint32_t sensorErrorCount = 0;
+static volatile uint32_t queueHighWater = 0;
+static const SampleScheduler* sampleSchedule = nullptr;
+static AdaptiveRate sampleRate;  // Sampler task only writes
+
+static void pushReading(const Reading& reading) {
+  if (xQueueSendToBack(readingQueue, &reading, 0) != pdPASS) {
+    // Queue full: evict the oldest reading so the newest one always fits
+    Reading evicted;
+    if (xQueueReceive(readingQueue, &evicted, 0) == pdPASS) {
+      droppedCount = droppedCount + 1;
+    }
+    xQueueSendToBack(readingQueue, &reading, 0);
+  }
+  sampledCount = sampledCount + 1;
+
+  uint32_t depth = uxQueueMessagesWaiting(readingQueue);
+  if (depth > queueHighWater) {
+    queueHighWater = depth;
+  }
+}
+
+static void samplerTask(void* param) {
+  uint32_t sequence = 0;
+  EspTimerClock clock;
+  SampleScheduler schedule(clock, SAMPLE_PERIOD_MS * 1000UL);
+  sampleSchedule = &schedule;
+
+  for (;;) {
+    // Fixed cadence on the esp_timer grid regardless of how long the read took
+    schedule.waitNext();
+
+    Reading reading = {};
+    if (sampleFn(reading)) {
+      reading.sequence = sequence++;
+      pushReading(reading);
+      schedule.setPeriodUs(sampleRate.update(reading) * 1000UL);
+    } else {
+      sensorErrorCount = sensorErrorCount + 1;
+    }
+  }
+}
+
+static void uploaderTask(void* param) {
+  for (;;) {
+    // Keep draining the queue into the upload path even while the link is down
+    Reading reading;
+    if (xQueueReceive(readingQueue, &reading, pdMS_TO_TICKS(UPLOADER_POLL_MS)) == pdPASS) {
+      uploadFn(reading);
+      uploadedCount = uploadedCount + 1;
+    }
+
+    if (linkFn()) {
+      flushFn();
+    }
+  }
+}
+
+void startPipeline(SampleFn sample, LinkFn link, UploadFn upload, FlushFn flush) {
+  sampleFn = sample;
+  linkFn = link;
+  uploadFn = upload;
+  flushFn = flush;
+
+  readingQueue = xQueueCreate(READING_QUEUE_LENGTH, sizeof(Reading));
+
+  xTaskCreatePinnedToCore(samplerTask, "sampler", SAMPLER_STACK_SIZE, nullptr,
+                          SAMPLER_PRIORITY, nullptr, SAMPLER_CORE);
+  xTaskCreatePinnedToCore(uploaderTask, "uploader", UPLOADER_STACK_SIZE, nullptr,
+                          UPLOADER_PRIORITY, nullptr, UPLOADER_CORE);
+}
+
+PipelineStats getPipelineStats() {
+  PipelineStats stats;
+  stats.sampled = sampledCount;
+  stats.uploaded = uploadedCount;
+  stats.dropped = droppedCount;
+  stats.sensorErrors = sensorErrorCount;
+  stats.queueDepth = readingQueue ? uxQueueMessagesWaiting(readingQueue) : 0;
+  stats.queueHighWater = queueHighWater;
+  stats.missedTicks = sampleSchedule ? sampleSchedule->stats().missed : 0;
+  stats.maxLateUs = sampleSchedule ? sampleSchedule->stats().maxLateUs : 0;
+  stats.intervalMs = sampleSchedule ? sampleSchedule->period() / 1000 : SAMPLE_PERIOD_MS;
+  stats.samplesPerMinute = sampleRate.samplesPerMinute();
+  return stats;
+}
+
+void setSamplingBounds(const AdaptiveBounds& bounds) {
+  sampleRate.setBounds(bounds);
+}
+
+uint32_t uplinkIntervalMs() {
+  return sampleRate.uplinkIntervalMs();
+}
+
+void printPipelineStats() {
+  PipelineStats stats = getPipelineStats();
+  logInfo("📈 Pipeline: sampled=%u uploaded=%u dropped=%u sensorErrors=%u queue=%u/%u (max %u) missed=%u late(max)=%uus\n",
+                stats.sampled, stats.uploaded, stats.dropped, stats.sensorErrors,
+                stats.queueDepth, READING_QUEUE_LENGTH, stats.queueHighWater,
+                stats.missedTicks, stats.maxLateUs);
+  logInfo("⏱️ Sampling every %ums (%.2f/min effective), uplink every %us\n",
+          stats.intervalMs, stats.samplesPerMinute, uplinkIntervalMs() / 1000);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include "reading.h"
+#include "adaptive_rate.h"
+
+/*
+ * Sampling / upload pipeline
+ *
+ * A sampling task pinned to the APP core reads the sensors on an esp_timer
+ * driven SampleScheduler (sample_clock.h), its period set after every read
+ * by an AdaptiveRate (adaptive_rate.h), and pushes Reading records into a bounded queue. An uploader
+ * task on the PRO core (where the WiFi stack runs) drains the queue into
+ * the uplink sinks and keeps WiFi up, so a slow backend never pushes back
+ * the next sample. When the queue is full the oldest reading is dropped to
+ * keep the freshest data.
+ */
+
+#define SAMPLE_PERIOD_MS 5000      // First period, then between CONTINUOUS_RATE_BOUNDS
+#define READING_QUEUE_LENGTH 32    // ~1 minute of readings at the fastest rate
+#define UPLOADER_POLL_MS 100       // Upper bound between link checks, the WiFi reconnect granularity
+
+#define SAMPLER_CORE APP_CPU_NUM
+#define UPLOADER_CORE PRO_CPU_NUM
+#define SAMPLER_PRIORITY 3
+#define UPLOADER_PRIORITY 2
+#define SAMPLER_STACK_SIZE 4096
+#define UPLOADER_STACK_SIZE 4096  // HTTP runs on the sink workers (uplink_manager.h)
+
+/* Fills a reading, returns false if the sensors could not be read */
+typedef bool (*SampleFn)(Reading& reading);
+
+/* Returns true once the uplink is usable, should not block */
+typedef bool (*LinkFn)();
+
+/* Hands one reading to the upload path, called from the uploader task */
+typedef void (*UploadFn)(const Reading& reading);
+
+/* Periodic work, called at least every UPLOADER_POLL_MS while the link is up */
+typedef void (*FlushFn)();
+
+struct PipelineStats {
+  uint32_t sampled;         // Readings pushed into the queue
+  uint32_t uploaded;        // Readings handed to the upload function
+  uint32_t dropped;         // Oldest readings evicted because the queue was full
+  uint32_t sensorErrors;    // Sampling periods skipped on a failed sensor read
+  uint32_t queueDepth;      // Readings currently waiting
+  uint32_t queueHighWater;  // Deepest the queue has been since boot
+  uint32_t missedTicks;     // Sampling periods skipped because a read overran
+  uint32_t maxLateUs;       // Worst wake-up latency of the sampler
+  uint32_t intervalMs;      // Current adaptive sampling interval
+  float samplesPerMinute;   // Effective sampling rate
+};
+
+void startPipeline(SampleFn sample, LinkFn link, UploadFn upload, FlushFn flush);
+PipelineStats getPipelineStats();
+
+/* Replaces CONTINUOUS_RATE_BOUNDS; call before startPipeline() or from the sample function */
+void setSamplingBounds(const AdaptiveBounds& bounds);
+
+/* How often a batch should go out, follows the sampling rate */
+uint32_t uplinkIntervalMs();
+void printPipelineStats();
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+ * Power profile: build with -DPOWER_PROFILE_DEEP_SLEEP=1 for battery operation.
+ * The device then wakes on a timer, takes one reading into RTC memory and
+ * sleeps again; see runDeepSleepCycle() in main.cpp.
+ */
+#ifndef POWER_PROFILE_DEEP_SLEEP
+#define POWER_PROFILE_DEEP_SLEEP 0
+#endif
+
+#if POWER_PROFILE_DEEP_SLEEP
+#include <esp_attr.h>
+#define RETAINED RTC_DATA_ATTR  // Kept in RTC slow memory through deep sleep
+#else
+#define RETAINED
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * One sample of the storage room, passed by value between tasks.
+ * Fixed size so it can live in a FreeRTOS queue without heap allocation.
+ * status and flags took the upper half of the old 32-bit suppressed count,
+ * so journal segments from older builds still read back (as unclassified).
+ */
+
+#define READING_STATUS_CHANGED 0x01  // First reading with a new status
+#define READING_STATUS_ONLY 0x02     // Heartbeat: only the status and time need sending
+
+struct Reading {
+  uint64_t epochMs;       // Wall-clock capture time (UTC), 0 if SNTP had not synced yet
+  uint32_t sequence;      // Monotonic sample counter since boot
+  uint32_t capturedAtMs;  // monotonicMs() when the sensors were read
+  uint16_t suppressed;    // Readings held back since the previous one sent
+  uint8_t status;         // StorageStatus (status_classifier.h), 0 if not classified
+  uint8_t flags;          // READING_* bits above
+  float temperature;
+  float humidity;
+  float co2;
+  float ammonia;
+  float methane;
+  float ethylene;
+  float h2s;
+};
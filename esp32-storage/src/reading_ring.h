@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+
+/*
+ * Fixed-capacity FIFO of readings (or other plain records) in RAM.
+ * When full, push() overwrites the oldest reading and reports it.
+ *
+ * No constructor on purpose: it must live in zero-initialized static
+ * storage, which also lets it sit in RTC memory (RTC_DATA_ATTR) and keep
+ * its contents through deep sleep.
+ */
+template <size_t Capacity, typename Item = Reading>
+class ReadingRing {
+ public:
+  /* Returns false if the oldest reading had to be overwritten */
+  bool push(const Item& reading) {
+    bool fit = count < Capacity;
+    items[(head + count) % Capacity] = reading;
+    if (fit) {
+      count++;
+    } else {
+      head = (head + 1) % Capacity;
+      overwritten++;
+    }
+    return fit;
+  }
+
+  /* i = 0 is the oldest buffered reading */
+  const Item& at(size_t i) const { return items[(head + i) % Capacity]; }
+
+  /* Removes the n oldest readings, e.g. once they were acknowledged */
+  void discard(size_t n) {
+    if (n > count) {
+      n = count;
+    }
+    head = (head + n) % Capacity;
+    count -= n;
+  }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == Capacity; }
+  size_t capacity() const { return Capacity; }
+  uint32_t overwrittenCount() const { return overwritten; }
+
+ private:
+  Item items[Capacity];
+  size_t head;
+  size_t count;
+  uint32_t overwritten;
+};
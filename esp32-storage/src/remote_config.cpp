@@ -0,0 +1,218 @@
+#include "remote_config.h"
+#include <ArduinoJson.h>
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+#include "arena_allocator.h"
+#include "status_classifier.h"
+
+#define CONFIG_MAGIC 0x48434632  // "HCF2"
+#define CONFIG_ARENA_SIZE 3072   // Filter and config document
+
+static ArenaAllocator<CONFIG_ARENA_SIZE> configArena;
+
+/* Letters, digits and the given punctuation, at least one character */
+static bool validName(const char* name, const char* punctuation) {
+  if (name[0] == '\0') {
+    return false;
+  }
+  for (const char* c = name; *c != '\0'; c++) {
+    if (!isalnum((unsigned char)*c) && strchr(punctuation, *c) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Copies a string value if present, false if it is not a string or does not fit */
+static bool copyString(JsonVariantConst value, char* out, size_t capacity) {
+  if (value.isNull()) {
+    return true;
+  }
+  const char* text = value.as<const char*>();
+  if (text == nullptr || strlen(text) >= capacity) {
+    return false;
+  }
+  strcpy(out, text);
+  return true;
+}
+
+/* Unsigned integer in [low, high] if present */
+static bool copyUnsigned(JsonVariantConst value, uint32_t low, uint32_t high, uint32_t& out) {
+  if (value.isNull()) {
+    return true;
+  }
+  if (!value.is<uint32_t>()) {
+    return false;
+  }
+  uint32_t number = value.as<uint32_t>();
+  if (number < low || number > high) {
+    return false;
+  }
+  out = number;
+  return true;
+}
+
+bool parseDeviceConfig(const char* body, size_t length, DeviceConfig& config) {
+  memset(&config, 0, sizeof(config));
+  config.magic = CONFIG_MAGIC;
+
+  configArena.reset();
+  JsonDocument filter(&configArena);
+  JsonObject keys = filter["data"].to<JsonObject>();
+  keys["minIntervalMs"] = true;
+  keys["maxIntervalMs"] = true;
+  keys["uplinkSamples"] = true;
+  keys["pollIntervalMs"] = true;
+  keys["r0"] = true;
+  keys["cropProfile"] = true;
+  keys["backendHost"] = true;
+  keys["backendPort"] = true;
+  keys["firmwareVersion"] = true;
+
+  JsonDocument doc(&configArena);
+  if (deserializeJson(doc, body, length, DeserializationOption::Filter(filter)) != DeserializationError::Ok ||
+      !doc["data"].is<JsonObject>()) {
+    return false;
+  }
+  JsonObjectConst data = doc["data"];
+
+  uint32_t port = 0;
+  if (!copyUnsigned(data["minIntervalMs"], CONFIG_MIN_INTERVAL_MS, CONFIG_MAX_INTERVAL_MS, config.minIntervalMs) ||
+      !copyUnsigned(data["maxIntervalMs"], CONFIG_MIN_INTERVAL_MS, CONFIG_MAX_INTERVAL_MS, config.maxIntervalMs) ||
+      !copyUnsigned(data["uplinkSamples"], 1, 100, config.uplinkSamples) ||
+      !copyUnsigned(data["pollIntervalMs"], CONFIG_MIN_POLL_MS, CONFIG_MAX_POLL_MS, config.pollIntervalMs) ||
+      !copyUnsigned(data["backendPort"], 1, 65535, port) ||
+      !copyString(data["cropProfile"], config.cropProfile, sizeof(config.cropProfile)) ||
+      !copyString(data["backendHost"], config.backendHost, sizeof(config.backendHost)) ||
+      !copyString(data["firmwareVersion"], config.firmwareVersion, sizeof(config.firmwareVersion))) {
+    return false;
+  }
+  config.backendPort = (uint16_t)port;
+
+  if (!data["r0"].isNull()) {
+    if (!data["r0"].is<float>()) {
+      return false;
+    }
+    config.r0 = data["r0"].as<float>();
+    if (!(config.r0 > 0.0f && config.r0 < 10000.0f)) {
+      return false;
+    }
+  }
+
+  // Cross-field checks: the pair must make sense together
+  if (config.minIntervalMs != 0 && config.maxIntervalMs != 0 && config.minIntervalMs > config.maxIntervalMs) {
+    return false;
+  }
+  if (config.cropProfile[0] != '\0' && findCropProfile(config.cropProfile) == nullptr) {
+    return false;
+  }
+  if (config.backendHost[0] != '\0' && !validName(config.backendHost, ".-")) {
+    return false;
+  }
+  // Goes into the patch URL
+  if (config.firmwareVersion[0] != '\0' && !validName(config.firmwareVersion, "._-")) {
+    return false;
+  }
+  return true;
+}
+
+AdaptiveBounds samplingBounds(const DeviceConfig& config, const AdaptiveBounds& defaults) {
+  AdaptiveBounds bounds = defaults;
+  if (config.minIntervalMs != 0) {
+    bounds.minIntervalMs = config.minIntervalMs;
+  }
+  if (config.maxIntervalMs != 0) {
+    bounds.maxIntervalMs = config.maxIntervalMs;
+  }
+  // Only one side configured and past the default of the other: the configured one wins
+  if (bounds.minIntervalMs > bounds.maxIntervalMs) {
+    if (config.minIntervalMs != 0) {
+      bounds.maxIntervalMs = bounds.minIntervalMs;
+    } else {
+      bounds.minIntervalMs = bounds.maxIntervalMs;
+    }
+  }
+  if (config.uplinkSamples != 0) {
+    bounds.uplinkSamples = config.uplinkSamples;
+  }
+  return bounds;
+}
+
+void RemoteConfig::begin(ConfigStore& configStore) {
+  store = &configStore;
+  if (active.magic == CONFIG_MAGIC) {
+    return;
+  }
+
+  DeviceConfig stored;
+  if (store->load(stored) && stored.magic == CONFIG_MAGIC) {
+    active = stored;
+  } else {
+    memset(&active, 0, sizeof(active));
+    active.magic = CONFIG_MAGIC;
+  }
+}
+
+uint32_t RemoteConfig::pollIntervalMs() const {
+  return active.pollIntervalMs != 0 ? active.pollIntervalMs : CONFIG_POLL_MS;
+}
+
+bool RemoteConfig::due(uint32_t nowMs) const {
+  return !polled || nowMs - lastPollMs >= pollIntervalMs();
+}
+
+ConfigResult RemoteConfig::receive(uint32_t nowMs, int status, const char* body, size_t length, const char* etag,
+                                   uint8_t& changed) {
+  polled = true;
+  lastPollMs = nowMs;
+  polls++;
+  changed = 0;
+
+  if (status == 304) {
+    return CONFIG_UNCHANGED;
+  }
+  if (status != 200) {
+    return CONFIG_FAILED;
+  }
+
+  DeviceConfig candidate;
+  if (length >= CONFIG_BODY_MAX || !parseDeviceConfig(body, length, candidate)) {
+    // Remember the ETag, so the server answers 304 until the document is fixed
+    strncpy(rejectedEtag, etag, sizeof(rejectedEtag) - 1);
+    rejectedEtag[sizeof(rejectedEtag) - 1] = '\0';
+    rejected++;
+    return CONFIG_REJECTED;
+  }
+  rejectedEtag[0] = '\0';
+  strncpy(candidate.etag, etag, sizeof(candidate.etag) - 1);
+
+  if (candidate.minIntervalMs != active.minIntervalMs || candidate.maxIntervalMs != active.maxIntervalMs ||
+      candidate.uplinkSamples != active.uplinkSamples) {
+    changed |= CONFIG_CHANGED_SAMPLING;
+  }
+  if (strcmp(candidate.cropProfile, active.cropProfile) != 0) {
+    changed |= CONFIG_CHANGED_PROFILE;
+  }
+  if (candidate.r0 != active.r0) {
+    changed |= CONFIG_CHANGED_R0;
+  }
+  if (candidate.backendPort != active.backendPort || strcmp(candidate.backendHost, active.backendHost) != 0) {
+    changed |= CONFIG_CHANGED_ENDPOINT;
+  }
+  if (candidate.pollIntervalMs != active.pollIntervalMs) {
+    changed |= CONFIG_CHANGED_POLL;
+  }
+  if (strcmp(candidate.firmwareVersion, active.firmwareVersion) != 0) {
+    changed |= CONFIG_CHANGED_FIRMWARE;
+  }
+
+  // Stored even when only the ETag moved, so the next boot does not fetch it again
+  active = candidate;
+  store->save(active);
+  if (changed == 0) {
+    return CONFIG_UNCHANGED;
+  }
+  applied++;
+  return CONFIG_APPLIED;
+}
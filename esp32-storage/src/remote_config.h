@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "adaptive_rate.h"
+
+/*
+ * Runtime configuration pulled from the backend.
+ *
+ * The device polls GET /api/storage/devices/<deviceId>/config with the
+ * ETag of what it has; an unchanged config is a 304 without a body. A 200
+ * is parsed with a filter, so only the known keys under "data" take RAM:
+ *
+ *   { "data": { "minIntervalMs": 5000, "maxIntervalMs": 120000,
+ *               "uplinkSamples": 4, "cropProfile": "potato", "r0": 41.5,
+ *               "backendHost": "10.0.0.2", "backendPort": 5000,
+ *               "pollIntervalMs": 300000, "firmwareVersion": "1.2.0" } }
+ *
+ * A missing key means the compiled default. The document is applied as a
+ * whole or not at all: one invalid value rejects it, and the previous
+ * config stays. An accepted config is saved to the ConfigStore (NVS) in
+ * one write, so the device boots with it before any network is up.
+ *
+ * Hardware independent; the HTTP exchange and the store are the caller's.
+ */
+
+#define CONFIG_BODY_MAX 1024          // Larger documents are refused
+#define CONFIG_ETAG_MAX 64
+#define CONFIG_PROFILE_MAX 16
+#define CONFIG_HOST_MAX 64
+#define CONFIG_VERSION_MAX 24
+#define CONFIG_POLL_MS 300000         // Default poll interval, 5 minutes...
+#define CONFIG_MIN_POLL_MS 60000      // ...configurable between a minute...
+#define CONFIG_MAX_POLL_MS 86400000   // ...and a day
+#define CONFIG_MIN_INTERVAL_MS 1000   // The DHT11 answers at most once a second
+#define CONFIG_MAX_INTERVAL_MS 3600000
+
+/* Which parts of the config changed, tells each consumer whether to act */
+#define CONFIG_CHANGED_SAMPLING 0x01
+#define CONFIG_CHANGED_PROFILE 0x02
+#define CONFIG_CHANGED_R0 0x04
+#define CONFIG_CHANGED_ENDPOINT 0x08  // Applied on the next boot
+#define CONFIG_CHANGED_POLL 0x10
+#define CONFIG_CHANGED_FIRMWARE 0x20
+
+/* Plain bytes, stored as one NVS blob; 0 / "" = compiled default */
+struct DeviceConfig {
+  uint32_t magic;          // CONFIG_MAGIC, a layout change invalidates stored configs
+  uint32_t minIntervalMs;
+  uint32_t maxIntervalMs;
+  uint32_t uplinkSamples;
+  uint32_t pollIntervalMs;
+  float r0;                // kOhm
+  uint16_t backendPort;
+  char cropProfile[CONFIG_PROFILE_MAX];
+  char backendHost[CONFIG_HOST_MAX];
+  char firmwareVersion[CONFIG_VERSION_MAX];  // Release the device should run
+  char etag[CONFIG_ETAG_MAX];  // Of the document this came from, "" for the compiled defaults
+};
+
+class ConfigStore {
+ public:
+  virtual ~ConfigStore() {}
+  virtual bool load(DeviceConfig& config) = 0;
+  virtual bool save(const DeviceConfig& config) = 0;
+};
+
+enum ConfigResult {
+  CONFIG_UNCHANGED,  // 304, or the same values under a new ETag
+  CONFIG_APPLIED,
+  CONFIG_REJECTED,   // Unparseable, too large or out of range; the old config stays
+  CONFIG_FAILED      // Transport error or unexpected status, retried at the next poll
+};
+
+/* Parses a config response body into config (defaults first), false if any value is invalid */
+bool parseDeviceConfig(const char* body, size_t length, DeviceConfig& config);
+
+/* defaults with the configured interval bounds and uplink cadence laid over them */
+AdaptiveBounds samplingBounds(const DeviceConfig& config, const AdaptiveBounds& defaults);
+
+/* No constructor, so it can sit in RTC memory and keep its poll timer through deep sleep */
+class RemoteConfig {
+ public:
+  /* Loads the stored config (once, a deep sleep wake keeps it), the compiled defaults if there is none */
+  void begin(ConfigStore& store);
+
+  const DeviceConfig& current() const { return active; }
+
+  /* ETag for If-None-Match: of the active config, or of the last rejected one so it is not fetched again */
+  const char* etag() const { return rejectedEtag[0] ? rejectedEtag : active.etag; }
+
+  /* True once the poll interval has passed since the last receive() */
+  bool due(uint32_t nowMs) const;
+
+  /*
+   * Outcome of one poll: status is the HTTP status (negative on transport
+   * errors), body and etag the response. changed gets CONFIG_CHANGED_* bits.
+   */
+  ConfigResult receive(uint32_t nowMs, int status, const char* body, size_t length, const char* etag,
+                       uint8_t& changed);
+
+  uint32_t pollIntervalMs() const;
+  uint32_t pollCount() const { return polls; }
+  uint32_t appliedCount() const { return applied; }
+  uint32_t rejectedCount() const { return rejected; }
+
+ private:
+  ConfigStore* store;
+  DeviceConfig active;
+  char rejectedEtag[CONFIG_ETAG_MAX];
+  bool polled;
+  uint32_t lastPollMs;
+  uint32_t polls;
+  uint32_t applied;
+  uint32_t rejected;
+};
@@ -0,0 +1,69 @@
+#include "sample_clock.h"
+
+#define EPOCH_MIN_RATE_SPAN_MS 600000ULL  // Syncs closer than 10 minutes say little about the rate
+#define EPOCH_MAX_DRIFT 0.001             // 1000 ppm, anything beyond is a clock step, not drift
+
+SampleScheduler::SampleScheduler(MonotonicClock& clock, uint32_t periodUs)
+    : clock(clock), periodUs(periodUs), started(false), nextUs(0), counters() {}
+
+uint64_t SampleScheduler::waitNext() {
+  uint64_t now = clock.nowUs();
+  if (!started) {
+    started = true;
+    nextUs = now;
+  } else {
+    nextUs += periodUs;
+    if (now >= nextUs + periodUs) {
+      // Overran by whole periods: skip those ticks, stay on the grid
+      uint64_t skipped = (now - nextUs) / periodUs;
+      counters.missed += skipped;
+      nextUs += skipped * periodUs;
+    }
+  }
+
+  clock.sleepUntilUs(nextUs);
+
+  uint64_t late = clock.nowUs() - nextUs;
+  counters.lastLateUs = late > UINT32_MAX ? UINT32_MAX : (uint32_t)late;
+  if (counters.lastLateUs > counters.maxLateUs) {
+    counters.maxLateUs = counters.lastLateUs;
+  }
+  counters.ticks++;
+  return nextUs;
+}
+
+void EpochClock::sync(uint64_t epochMs, uint64_t monotonicMs) {
+  if (syncs == 0) {
+    rateEpochMs = epochMs;
+    rateMonotonicMs = monotonicMs;
+  } else {
+    if (monotonicMs == anchorMonotonicMs) {
+      return;  // Same instant twice, nothing to learn
+    }
+    int64_t error = (int64_t)epochMs - (int64_t)toEpochMs(monotonicMs);
+    correction = error > INT32_MAX ? INT32_MAX : error < INT32_MIN ? INT32_MIN : (int32_t)error;
+
+    // The rate is measured against an older sync so that SNTP jitter is small next to the span
+    uint64_t span = monotonicMs - rateMonotonicMs;
+    if (span >= EPOCH_MIN_RATE_SPAN_MS) {
+      double rate = (double)((int64_t)(epochMs - rateEpochMs) - (int64_t)span) / span;
+      if (rate > -EPOCH_MAX_DRIFT && rate < EPOCH_MAX_DRIFT) {
+        drift = drift != 0 ? drift + (rate - drift) * 0.5 : rate;
+      }
+      rateEpochMs = epochMs;
+      rateMonotonicMs = monotonicMs;
+    }
+  }
+
+  anchorEpochMs = epochMs;
+  anchorMonotonicMs = monotonicMs;
+  syncs++;
+}
+
+uint64_t EpochClock::toEpochMs(uint64_t monotonicMs) const {
+  if (syncs == 0) {
+    return 0;
+  }
+  int64_t elapsed = (int64_t)(monotonicMs - anchorMonotonicMs);
+  return anchorEpochMs + elapsed + (int64_t)(elapsed * drift);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Time keeping for sampling.
+ *
+ * SampleScheduler produces ticks on an exact period grid: each deadline is
+ * the previous deadline plus the period, never "now + period", so the
+ * time spent reading sensors or uploading does not accumulate as drift.
+ * Ticks that could not be served are skipped, keeping the phase.
+ *
+ * EpochClock maps the monotonic clock to wall-clock time. Every SNTP sync
+ * re-anchors it and refines the estimated rate error of the local
+ * oscillator, so readings taken between syncs still get accurate epoch
+ * timestamps.
+ *
+ * Hardware independent: the clock is an interface, with a VirtualClock
+ * for running schedules on a PC.
+ */
+
+class MonotonicClock {
+ public:
+  virtual ~MonotonicClock() {}
+  virtual uint64_t nowUs() = 0;
+
+  /* Returns at (or as soon as possible after) the given time */
+  virtual void sleepUntilUs(uint64_t deadlineUs) = 0;
+};
+
+/* Time only moves when someone sleeps or calls advance() */
+class VirtualClock : public MonotonicClock {
+ public:
+  explicit VirtualClock(uint64_t startUs = 0) : now(startUs) {}
+
+  uint64_t nowUs() override { return now; }
+  void sleepUntilUs(uint64_t deadlineUs) override {
+    if (deadlineUs > now) {
+      now = deadlineUs;
+    }
+  }
+  void advance(uint64_t us) { now += us; }
+
+ private:
+  uint64_t now;
+};
+
+struct ScheduleStats {
+  uint32_t ticks;        // Ticks served
+  uint32_t missed;       // Ticks skipped because the previous one overran
+  uint32_t lastLateUs;   // How late the last tick was served
+  uint32_t maxLateUs;
+};
+
+class SampleScheduler {
+ public:
+  SampleScheduler(MonotonicClock& clock, uint32_t periodUs);
+
+  /* Sleeps until the next tick, returns its scheduled time */
+  uint64_t waitNext();
+
+  /* Takes effect from the next tick, counted from the last one served */
+  void setPeriodUs(uint32_t period) { periodUs = period; }
+  uint32_t period() const { return periodUs; }
+
+  const ScheduleStats& stats() const { return counters; }
+
+ private:
+  MonotonicClock& clock;
+  uint32_t periodUs;
+  bool started;
+  uint64_t nextUs;
+  ScheduleStats counters;
+};
+
+/*
+ * No constructor on purpose: zero-initialized means "never synced", and
+ * it can live in RTC memory through deep sleep.
+ */
+class EpochClock {
+ public:
+  /* An SNTP result: epochMs was the wall-clock time at monotonicMs */
+  void sync(uint64_t epochMs, uint64_t monotonicMs);
+
+  bool synced() const { return syncs > 0; }
+
+  /* Wall-clock time of a monotonic timestamp, 0 if never synced */
+  uint64_t toEpochMs(uint64_t monotonicMs) const;
+
+  uint32_t syncCount() const { return syncs; }
+
+  /* Local clock rate error, positive when it runs slow */
+  float driftPpm() const { return drift * 1e6f; }
+
+  /* Prediction error corrected by the last sync, in ms */
+  int32_t lastCorrectionMs() const { return correction; }
+
+ private:
+  uint64_t anchorEpochMs;      // Last sync, what timestamps are extrapolated from
+  uint64_t anchorMonotonicMs;
+  uint64_t rateEpochMs;        // Sync the rate is measured against
+  uint64_t rateMonotonicMs;
+  double drift;
+  uint32_t syncs;
+  int32_t correction;
+};
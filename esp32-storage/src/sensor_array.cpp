@@ -0,0 +1,184 @@
+#include <math.h>
+#include "sensor_array.h"
+
+#define SLOW_SHARED_COST 1000  // Two DHT reads in one slot, only if nothing else is left
+#define SLOW_FAST_COST 8       // An ADC read behind a DHT read is late by one DHT read
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+SensorArray::SensorArray() : started(false), sharedSlots(0), latest(), counters() {}
+
+bool SensorArray::add(Probe& probe, const ProbeSpec& spec) {
+  size_t index = latest.count;
+  if (index >= SENSOR_MAX_PROBES || started) {
+    return false;
+  }
+  uint32_t slots = (spec.periodMs + SENSOR_SLOT_MS / 2) / SENSOR_SLOT_MS;
+  if (slots == 0) {
+    slots = 1;
+  }
+  bool slow = spec.kind == PROBE_CLIMATE;
+
+  // Probes meet when their phases are equal modulo the gcd of their periods
+  uint32_t best = 0;
+  uint32_t bestCost = UINT32_MAX;
+  uint32_t bestShared = 0;
+  for (uint32_t candidate = 0; candidate < slots && bestCost > 0; candidate++) {
+    uint32_t cost = 0;
+    uint32_t shared = 0;
+    for (size_t j = 0; j < index; j++) {
+      uint32_t common = gcd(slots, period[j]);
+      if (candidate % common != phase[j] % common) {
+        continue;
+      }
+      bool otherSlow = latest.kind[j] == PROBE_CLIMATE;
+      if (slow && otherSlow) {
+        shared++;
+        cost += SLOW_SHARED_COST;
+      } else {
+        cost += slow || otherSlow ? SLOW_FAST_COST : 1;
+      }
+    }
+    if (cost < bestCost) {
+      best = candidate;
+      bestCost = cost;
+      bestShared = shared;
+    }
+  }
+
+  probes[index] = &probe;
+  period[index] = slots;
+  phase[index] = best;
+  sharedSlots += bestShared;
+  counters[index] = {};
+
+  latest.name[index] = spec.name;
+  latest.kind[index] = spec.kind;
+  latest.periodMs[index] = slots * SENSOR_SLOT_MS;
+  latest.readAtMs[index] = 0;
+  latest.temperature[index] = NAN;
+  latest.humidity[index] = NAN;
+  latest.gasCode[index] = NAN;
+  latest.count++;
+  return true;
+}
+
+bool SensorArray::poll(uint32_t nowMs) {
+  if (!started) {
+    for (size_t i = 0; i < latest.count; i++) {
+      nextMs[i] = nowMs + phase[i] * SENSOR_SLOT_MS;
+    }
+    started = true;
+  }
+
+  // The most overdue first, the others are read on the next calls
+  size_t due = latest.count;
+  int32_t mostLate = -1;
+  for (size_t i = 0; i < latest.count; i++) {
+    int32_t late = (int32_t)(nowMs - nextMs[i]);
+    if (late > mostLate) {
+      due = i;
+      mostLate = late;
+    }
+  }
+  if (due == latest.count) {
+    return false;
+  }
+
+  ProbeStats& stats = counters[due];
+  if ((uint32_t)mostLate > stats.maxLateMs) {
+    stats.maxLateMs = mostLate;
+  }
+  read(due, nowMs);
+
+  // Stay on the probe's grid, periods that already went by are skipped
+  uint32_t periodMs = latest.periodMs[due];
+  nextMs[due] += periodMs;
+  if ((int32_t)(nowMs - nextMs[due]) >= 0) {
+    uint32_t behind = (nowMs - nextMs[due]) / periodMs + 1;
+    stats.skipped += behind;
+    nextMs[due] += behind * periodMs;
+  }
+  return true;
+}
+
+uint32_t SensorArray::dueInMs(uint32_t nowMs) const {
+  if (!started) {
+    return 0;
+  }
+  uint32_t wait = SENSOR_SLOT_MS;  // Nothing registered: check back soon
+  for (size_t i = 0; i < latest.count; i++) {
+    int32_t left = (int32_t)(nextMs[i] - nowMs);
+    if (left <= 0) {
+      return 0;
+    }
+    if (i == 0 || (uint32_t)left < wait) {
+      wait = left;
+    }
+  }
+  return wait;
+}
+
+void SensorArray::readAll(uint32_t nowMs) {
+  for (size_t i = 0; i < latest.count; i++) {
+    read(i, nowMs);
+  }
+}
+
+void SensorArray::read(size_t index, uint32_t nowMs) {
+  float values[2] = { NAN, NAN };
+  ProbeStats& stats = counters[index];
+  stats.reads++;
+  if (!probes[index]->read(values)) {
+    stats.failures++;
+    return;  // The last good values stay until they go stale
+  }
+
+  if (latest.kind[index] == PROBE_CLIMATE) {
+    latest.temperature[index] = values[0];
+    latest.humidity[index] = values[1];
+  } else {
+    latest.gasCode[index] = values[0];
+  }
+  latest.readAtMs[index] = nowMs != 0 ? nowMs : 1;  // 0 means never read
+}
+
+bool probeFresh(const SensorFrame& frame, size_t index, uint32_t nowMs) {
+  return frame.readAtMs[index] != 0 &&
+         (int32_t)(nowMs - frame.readAtMs[index]) <= (int32_t)(SENSOR_STALE_PERIODS * frame.periodMs[index]);
+}
+
+bool combineFrame(const SensorFrame& frame, uint32_t nowMs, RoomValues& room) {
+  float temperature = 0.0f;
+  float humidity = 0.0f;
+  room.gasCode = NAN;
+  room.climateProbes = 0;
+  room.gasProbes = 0;
+
+  for (size_t i = 0; i < frame.count; i++) {
+    if (!probeFresh(frame, i, nowMs)) {
+      continue;
+    }
+    if (frame.kind[i] == PROBE_CLIMATE) {
+      temperature += frame.temperature[i];
+      humidity += frame.humidity[i];
+      room.climateProbes++;
+    } else {
+      if (room.gasProbes == 0 || frame.gasCode[i] > room.gasCode) {
+        room.gasCode = frame.gasCode[i];
+      }
+      room.gasProbes++;
+    }
+  }
+
+  room.temperature = room.climateProbes > 0 ? temperature / room.climateProbes : NAN;
+  room.humidity = room.climateProbes > 0 ? humidity / room.climateProbes : NAN;
+  return room.climateProbes > 0 && room.gasProbes > 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Registry and scheduler for several probes in one room.
+ *
+ * Every probe is read on its own period. Time is cut into SENSOR_SLOT_MS
+ * slots and each probe gets a phase within its period, picked when it is
+ * registered so that no two slow probes (DHT: ~25 ms with interrupts off
+ * for part of it) ever land in the same slot, whatever their periods:
+ * probes i and j meet only if their phases are equal modulo the gcd of
+ * their periods, so the phase is chosen to differ there from every slow
+ * probe already placed. Fast probes (an ADC read) are spread the same way
+ * but may share a slot.
+ *
+ * The latest value of every probe lands in one SensorFrame, a struct of
+ * arrays: a room reading is combined from it (climate averaged over the
+ * fresh probes, gas from the worst one), and the uplink serializes it
+ * column by column once per upload instead of per reading.
+ *
+ * Hardware independent, probes are read through the Probe interface.
+ * Not thread-safe: poll() and readAll() update the frame in place.
+ */
+
+#define SENSOR_MAX_PROBES 8
+#define SENSOR_SLOT_MS 50          // Longest read (DHT: 18 ms start pulse + ~5 ms of data) fits in a slot
+#define SENSOR_STALE_PERIODS 3     // A probe not read for this many periods is left out
+
+enum ProbeKind {
+  PROBE_CLIMATE,  // Temperature and humidity (DHT), slow
+  PROBE_GAS       // One analog MQ135 code, fast
+};
+
+/* One physical sensor */
+class Probe {
+ public:
+  virtual ~Probe() {}
+
+  /* CLIMATE: values[0] temperature, values[1] humidity; GAS: values[0] the ADC code. False on a failed read */
+  virtual bool read(float* values) = 0;
+};
+
+struct ProbeSpec {
+  const char* name;
+  ProbeKind kind;
+  uint32_t periodMs;  // Rounded to whole slots
+};
+
+/* Latest value of every probe, one array per field */
+struct SensorFrame {
+  uint8_t count;
+  const char* name[SENSOR_MAX_PROBES];
+  uint8_t kind[SENSOR_MAX_PROBES];
+  uint32_t periodMs[SENSOR_MAX_PROBES];
+  uint32_t readAtMs[SENSOR_MAX_PROBES];  // Of the last good read, 0 = none yet
+  float temperature[SENSOR_MAX_PROBES];  // NAN where the probe has no such value
+  float humidity[SENSOR_MAX_PROBES];
+  float gasCode[SENSOR_MAX_PROBES];
+};
+
+/* The room as one value per channel */
+struct RoomValues {
+  float temperature;  // Mean of the fresh climate probes
+  float humidity;
+  float gasCode;      // Highest of the fresh gas probes: spoilage starts in one spot
+  uint8_t climateProbes;
+  uint8_t gasProbes;
+};
+
+struct ProbeStats {
+  uint32_t reads;
+  uint32_t failures;
+  uint32_t skipped;     // Periods passed over because a read came too late for them
+  uint32_t maxLateMs;   // Worst delay behind the probe's slot
+};
+
+/* Fresh probes of the frame combined, false if there is no fresh climate or no fresh gas probe */
+bool combineFrame(const SensorFrame& frame, uint32_t nowMs, RoomValues& room);
+
+/* Fresh within SENSOR_STALE_PERIODS of its period */
+bool probeFresh(const SensorFrame& frame, size_t index, uint32_t nowMs);
+
+class SensorArray {
+ public:
+  SensorArray();
+
+  /* Adds a probe and picks its phase, false when full; register all before the first poll() */
+  bool add(Probe& probe, const ProbeSpec& spec);
+
+  /* Reads the probe most overdue at nowMs, false if none is due */
+  bool poll(uint32_t nowMs);
+
+  /* Ms until the next probe is due, 0 if one is due now */
+  uint32_t dueInMs(uint32_t nowMs) const;
+
+  /* Reads every probe once, for a deep sleep wake */
+  void readAll(uint32_t nowMs);
+
+  const SensorFrame& frame() const { return latest; }
+  const ProbeStats& stats(size_t index) const { return counters[index]; }
+  size_t count() const { return latest.count; }
+  uint32_t phaseMs(size_t index) const { return phase[index] * SENSOR_SLOT_MS; }
+
+  /* Pairs of slow probes that had to share a slot, 0 unless too many were registered */
+  uint32_t collisions() const { return sharedSlots; }
+
+ private:
+  void read(size_t index, uint32_t nowMs);
+
+  Probe* probes[SENSOR_MAX_PROBES];
+  uint32_t period[SENSOR_MAX_PROBES];  // In slots
+  uint32_t phase[SENSOR_MAX_PROBES];   // In slots, below period
+  uint32_t nextMs[SENSOR_MAX_PROBES];
+  bool started;
+  uint32_t sharedSlots;
+  SensorFrame latest;
+  ProbeStats counters[SENSOR_MAX_PROBES];
+};
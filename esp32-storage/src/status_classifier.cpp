@@ -0,0 +1,70 @@
+#include <string.h>
+#include "status_classifier.h"
+
+const CropProfile* findCropProfile(const char* name) {
+  for (size_t i = 0; i < CROP_PROFILE_COUNT; i++) {
+    if (strcmp(CROP_PROFILES[i].name, name) == 0) {
+      return &CROP_PROFILES[i];
+    }
+  }
+  return nullptr;
+}
+
+const char* storageStatusName(StorageStatus status) {
+  switch (status) {
+    case STATUS_NORMAL: return "normal";
+    case STATUS_WARNING: return "warning";
+    case STATUS_CRITICAL: return "critical";
+    default: return "unknown";
+  }
+}
+
+/* Level of value against the rule's bounds, each pulled inwards by margin */
+static uint8_t ruleLevel(const StatusRule& rule, float value, float margin) {
+  if (value < rule.criticalLow + margin || value > rule.criticalHigh - margin) {
+    return STATUS_CRITICAL;
+  }
+  if (value < rule.warningLow + margin || value > rule.warningHigh - margin) {
+    return STATUS_WARNING;
+  }
+  return STATUS_NORMAL;
+}
+
+void StatusClassifier::setProfile(const CropProfile& profile) {
+  active = &profile;
+  memset(levels, 0, sizeof(levels));
+}
+
+StorageStatus StatusClassifier::classify(const Reading& reading) {
+  const CropProfile& rules = profile();
+  uint8_t worst = STATUS_NORMAL;
+
+  for (uint8_t i = 0; i < rules.ruleCount; i++) {
+    const StatusRule& rule = rules.rules[i];
+    float value = readingChannel(reading, rule.channel);
+
+    // A failed read keeps the last level; the first valid one sets it outright
+    if (isfinite(value)) {
+      uint8_t level = ruleLevel(rule, value, 0);
+      if (levels[i] == STATUS_UNKNOWN || level >= levels[i]) {
+        levels[i] = level;
+      } else {
+        uint8_t settled = ruleLevel(rule, value, rule.hysteresis);
+        if (settled < levels[i]) {
+          levels[i] = settled;
+        }
+      }
+    }
+    if (levels[i] > worst) {
+      worst = levels[i];
+    }
+  }
+
+  if (worst != current) {
+    if (current != STATUS_UNKNOWN) {
+      transitions++;
+    }
+    current = (StorageStatus)worst;
+  }
+  return current;
+}
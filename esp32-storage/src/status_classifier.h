@@ -0,0 +1,109 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include "reading.h"
+#include "deadband.h"
+
+/*
+ * Storage status of every reading, decided on the device.
+ *
+ * A crop profile is a table of rules, one per channel it cares about:
+ * outside [warningLow, warningHigh] is a warning, outside
+ * [criticalLow, criticalHigh] critical. The reading's status is the worst
+ * level of any rule.
+ *
+ * Each rule escalates as soon as a bound is crossed but only steps down
+ * once the value is back inside by its hysteresis margin, so a value
+ * sitting on a bound does not flap between two states (and send a reading
+ * for every flip).
+ *
+ * Hardware independent; no constructor, so it can sit in RTC memory.
+ */
+
+#define STATUS_MAX_RULES 6
+
+enum StorageStatus {
+  STATUS_UNKNOWN,   // Not classified, the backend decides
+  STATUS_NORMAL,
+  STATUS_WARNING,
+  STATUS_CRITICAL
+};
+
+struct StatusRule {
+  ReadingChannel channel;
+  float criticalLow;
+  float warningLow;
+  float warningHigh;
+  float criticalHigh;
+  float hysteresis;  // Same unit as the channel
+};
+
+struct CropProfile {
+  const char* name;
+  uint8_t ruleCount;
+  StatusRule rules[STATUS_MAX_RULES];
+};
+
+/* Gas limits shared by every profile (MQ135 scaled ppm) */
+#define GAS_STATUS_RULES \
+  { CHANNEL_CO2, -INFINITY, -INFINITY, 2000.0f, 5000.0f, 100.0f }, \
+  { CHANNEL_AMMONIA, -INFINITY, -INFINITY, 25.0f, 50.0f, 2.0f }, \
+  { CHANNEL_ETHYLENE, -INFINITY, -INFINITY, 10.0f, 50.0f, 1.0f }
+
+constexpr CropProfile CROP_PROFILES[] = {
+  // Same temperature and humidity limits the backend applies to unclassified readings
+  { "default", 5, {
+    { CHANNEL_TEMPERATURE, 0.0f, 5.0f, 25.0f, 30.0f, 1.0f },
+    { CHANNEL_HUMIDITY, 20.0f, 30.0f, 85.0f, 95.0f, 3.0f },
+    GAS_STATUS_RULES } },
+  // Cool and very humid; CO2 above 1% damages tubers
+  { "potato", 5, {
+    { CHANNEL_TEMPERATURE, 1.0f, 3.0f, 12.0f, 20.0f, 1.0f },
+    { CHANNEL_HUMIDITY, 75.0f, 85.0f, 98.0f, 100.0f, 2.0f },
+    { CHANNEL_CO2, -INFINITY, -INFINITY, 5000.0f, 10000.0f, 200.0f },
+    { CHANNEL_AMMONIA, -INFINITY, -INFINITY, 25.0f, 50.0f, 2.0f },
+    { CHANNEL_ETHYLENE, -INFINITY, -INFINITY, 10.0f, 50.0f, 1.0f } } },
+  // Dry storage, sprouting and rot above 75% humidity
+  { "onion", 5, {
+    { CHANNEL_TEMPERATURE, -2.0f, 0.0f, 30.0f, 35.0f, 1.0f },
+    { CHANNEL_HUMIDITY, 45.0f, 55.0f, 75.0f, 85.0f, 3.0f },
+    GAS_STATUS_RULES } },
+  // Chilling injury below 10°C
+  { "tomato", 5, {
+    { CHANNEL_TEMPERATURE, 5.0f, 10.0f, 21.0f, 27.0f, 1.0f },
+    { CHANNEL_HUMIDITY, 70.0f, 80.0f, 95.0f, 98.0f, 2.0f },
+    GAS_STATUS_RULES } },
+  // Grain: moisture and warmth drive mould and insects, which show as CO2
+  { "grain", 4, {
+    { CHANNEL_TEMPERATURE, -INFINITY, -INFINITY, 25.0f, 35.0f, 1.0f },
+    { CHANNEL_HUMIDITY, -INFINITY, -INFINITY, 70.0f, 80.0f, 3.0f },
+    { CHANNEL_CO2, -INFINITY, -INFINITY, 1500.0f, 3000.0f, 100.0f },
+    { CHANNEL_AMMONIA, -INFINITY, -INFINITY, 25.0f, 50.0f, 2.0f } } },
+};
+
+constexpr size_t CROP_PROFILE_COUNT = sizeof(CROP_PROFILES) / sizeof(CROP_PROFILES[0]);
+
+/* Profile by name, nullptr if there is none */
+const CropProfile* findCropProfile(const char* name);
+
+const char* storageStatusName(StorageStatus status);
+
+class StatusClassifier {
+ public:
+  /* Switches profile, levels start over; the first profile is used until this is called */
+  void setProfile(const CropProfile& profile);
+
+  /* Level of every rule after this reading, worst of them returned */
+  StorageStatus classify(const Reading& reading);
+
+  StorageStatus status() const { return current; }
+  const CropProfile& profile() const { return active ? *active : CROP_PROFILES[0]; }
+  uint32_t transitionCount() const { return transitions; }
+
+ private:
+  const CropProfile* active;  // Points to flash, stays valid across deep sleep
+  uint8_t levels[STATUS_MAX_RULES];
+  StorageStatus current;
+  uint32_t transitions;
+};
@@ -0,0 +1,168 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "uplink_manager.h"
+#include "heap_probe.h"
+#include "log.h"
+
+struct SinkSlot {
+  UplinkSink* sink;
+  SinkPolicy policy;
+  LinkUpFn linkUp;
+  QueueHandle_t queue;
+  CircuitBreaker breaker;  // Worker only
+
+  /* Written by the publisher (queued, dropped) or the worker (the rest) only */
+  volatile uint32_t queued;
+  volatile uint32_t dropped;
+  volatile uint32_t sent;
+  volatile uint32_t failed;
+  volatile uint32_t lastLatencyMs;
+  volatile uint32_t maxLatencyMs;
+  volatile uint32_t totalLatencyMs;
+  volatile uint32_t flushAllocations;
+  volatile uint32_t allocatingFlushes;
+};
+
+static SinkSlot slots[MAX_UPLINK_SINKS];
+static volatile size_t slotCount = 0;
+
+static void sinkTask(void* param) {
+  SinkSlot& slot = *(SinkSlot*)param;
+  if (slot.policy.probeHeap) {
+    heapProbeAttach();
+  }
+
+  uint32_t nextAttemptMs = millis();
+  for (;;) {
+    Reading reading;
+    if (xQueueReceive(slot.queue, &reading, pdMS_TO_TICKS(SINK_POLL_MS)) == pdPASS) {
+      slot.sink->take(reading);
+    }
+
+    // While the breaker is open readings only go to the sink's local buffer
+    if ((int32_t)(millis() - nextAttemptMs) < 0 || !slot.linkUp() || !slot.breaker.allow(millis())) {
+      continue;
+    }
+
+    uint32_t allocationsBefore = heapProbeCount();
+    uint32_t started = millis();
+    SinkResult result = slot.sink->flush();
+    if (result == SINK_IDLE) {
+      slot.breaker.recordIdle();
+      continue;
+    }
+
+    uint32_t latency = millis() - started;
+    slot.lastLatencyMs = latency;
+    slot.totalLatencyMs = slot.totalLatencyMs + latency;
+    if (latency > slot.maxLatencyMs) {
+      slot.maxLatencyMs = latency;
+    }
+    slot.flushAllocations = heapProbeCount() - allocationsBefore;
+    if (slot.flushAllocations > 0) {
+      slot.allocatingFlushes = slot.allocatingFlushes + 1;
+    }
+
+    if (result == SINK_SENT) {
+      slot.sent = slot.sent + 1;
+      slot.breaker.recordSuccess();
+      nextAttemptMs = started + slot.policy.minIntervalMs;
+    } else {
+      slot.failed = slot.failed + 1;
+      BreakerState before = slot.breaker.state();
+      slot.breaker.recordFailure(millis());
+      if (before == BREAKER_CLOSED && slot.breaker.state() == BREAKER_OPEN) {
+        logWarn("🔌 Sink %s: %u failures in a row, breaker open for %ums\n", slot.policy.name,
+                slot.policy.failureThreshold, slot.breaker.stats().lastDelayMs);
+      }
+    }
+  }
+}
+
+bool addUplinkSink(UplinkSink& sink, const SinkPolicy& policy, LinkUpFn linkUp) {
+  if (slotCount >= MAX_UPLINK_SINKS) {
+    return false;
+  }
+
+  SinkSlot& slot = slots[slotCount];
+  slot.sink = &sink;
+  slot.policy = policy;
+  slot.linkUp = linkUp;
+  slot.breaker.configure(policy.retryDelayMs, policy.maxRetryDelayMs, policy.failureThreshold,
+                         esp_random() ^ slotCount);  // Differs per device, spreads a fleet's retries
+  slot.queue = xQueueCreate(policy.queueLength, sizeof(Reading));
+  if (slot.queue == nullptr) {
+    return false;
+  }
+  slotCount = slotCount + 1;
+
+  xTaskCreatePinnedToCore(sinkTask, policy.name, policy.stackSize, &slot,
+                          policy.priority, nullptr, policy.core);
+  return true;
+}
+
+void publishReading(const Reading& reading) {
+  for (size_t i = 0; i < slotCount; i++) {
+    SinkSlot& slot = slots[i];
+    slot.queued = slot.queued + 1;
+
+    if (slot.policy.queueLength == 1) {
+      // Latest-value sink: an unsent reading is simply replaced
+      if (uxQueueMessagesWaiting(slot.queue) > 0) {
+        slot.dropped = slot.dropped + 1;
+      }
+      xQueueOverwrite(slot.queue, &reading);
+      continue;
+    }
+
+    if (xQueueSendToBack(slot.queue, &reading, 0) != pdPASS) {
+      // Worker stuck in a long flush: evict the oldest so the newest always fits
+      Reading evicted;
+      if (xQueueReceive(slot.queue, &evicted, 0) == pdPASS) {
+        slot.dropped = slot.dropped + 1;
+      }
+      xQueueSendToBack(slot.queue, &reading, 0);
+    }
+  }
+}
+
+size_t uplinkSinkCount() {
+  return slotCount;
+}
+
+SinkStats getSinkStats(size_t index) {
+  const SinkSlot& slot = slots[index];
+  SinkStats stats;
+  stats.queued = slot.queued;
+  stats.dropped = slot.dropped;
+  stats.queueDepth = uxQueueMessagesWaiting(slot.queue);
+  stats.sent = slot.sent;
+  stats.failed = slot.failed;
+  stats.breaker = slot.breaker.state();
+  stats.retryInMs = slot.breaker.retryInMs(millis());
+  stats.breakerOpens = slot.breaker.stats().opens;
+  stats.lastLatencyMs = slot.lastLatencyMs;
+  stats.maxLatencyMs = slot.maxLatencyMs;
+  stats.totalLatencyMs = slot.totalLatencyMs;
+  stats.flushAllocations = slot.flushAllocations;
+  stats.allocatingFlushes = slot.allocatingFlushes;
+  return stats;
+}
+
+void printUplinkStats() {
+  for (size_t i = 0; i < slotCount; i++) {
+    SinkStats stats = getSinkStats(i);
+    uint32_t flushes = stats.sent + stats.failed;
+    logInfo("📮 Sink %s: sent=%u failed=%u dropped=%u queue=%u/%u breaker=%s (retry in %ums, opened %u) latency last=%ums avg=%ums max=%ums\n",
+              slots[i].policy.name, stats.sent, stats.failed, stats.dropped,
+              stats.queueDepth, slots[i].policy.queueLength,
+              breakerStateName(stats.breaker), stats.retryInMs, stats.breakerOpens,
+              stats.lastLatencyMs, flushes ? stats.totalLatencyMs / flushes : 0, stats.maxLatencyMs);
+    if (slots[i].policy.probeHeap && heapProbeEnabled()) {
+      logInfo("🧮 Heap: %u allocations last flush, %u allocating flushes since boot, %u bytes free\n",
+                stats.flushAllocations, stats.allocatingFlushes, ESP.getFreeHeap());
+    }
+  }
+}
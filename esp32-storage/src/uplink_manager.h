@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+#include "circuit_breaker.h"
+
+/*
+ * Fan-out of readings to independent uplink sinks.
+ *
+ * Every sink gets its own queue and worker task, so sinks run
+ * concurrently and a slow or failing one (Firebase over TLS) never holds
+ * up another (the backend). The worker hands queued readings to the sink,
+ * then asks it to flush, honouring the sink's rate limit and its circuit
+ * breaker (circuit_breaker.h): after failureThreshold failed flushes in a
+ * row flushing stops for a jittered, growing delay, while take() keeps
+ * feeding the sink's local buffer.
+ */
+
+#define MAX_UPLINK_SINKS 4
+#define SINK_POLL_MS 1000  // Upper bound between flush checks
+
+enum SinkResult {
+  SINK_IDLE,    // Nothing was due
+  SINK_SENT,    // Delivered (or permanently rejected, nothing left to retry)
+  SINK_FAILED   // Kept, try again after the retry delay
+};
+
+class UplinkSink {
+ public:
+  virtual ~UplinkSink() {}
+
+  /* Called on the sink's worker for every reading published */
+  virtual void take(const Reading& reading) = 0;
+
+  /* Sends whatever is due, called on the sink's worker while the link is up */
+  virtual SinkResult flush() = 0;
+};
+
+struct SinkPolicy {
+  const char* name;
+  uint8_t queueLength;      // 1 = only the latest reading matters, new ones overwrite
+  uint32_t minIntervalMs;   // Rate limit between deliveries
+  uint32_t retryDelayMs;    // Backoff ceiling when the breaker opens, doubles on every failed probe...
+  uint32_t maxRetryDelayMs; // ...up to this; the actual delay is uniformly random below the ceiling
+  uint8_t failureThreshold; // Failed flushes in a row that open the breaker
+  uint8_t core;
+  uint8_t priority;
+  uint32_t stackSize;
+  bool probeHeap;           // Count this worker's heap allocations (HEAP_PROBE builds)
+};
+
+struct SinkStats {
+  uint32_t queued;          // Readings published to this sink
+  uint32_t dropped;         // Readings evicted or overwritten before the worker took them
+  uint32_t queueDepth;
+  uint32_t sent;            // Successful flushes
+  uint32_t failed;          // Failed flushes
+  BreakerState breaker;
+  uint32_t retryInMs;       // Until the next probe while the breaker is open
+  uint32_t breakerOpens;
+  uint32_t lastLatencyMs;
+  uint32_t maxLatencyMs;
+  uint32_t totalLatencyMs;  // Over sent + failed flushes
+  uint32_t flushAllocations;    // Heap allocations made by the last flush
+  uint32_t allocatingFlushes;   // Flushes that allocated at all
+};
+
+/* Non-blocking, true while deliveries can be attempted */
+typedef bool (*LinkUpFn)();
+
+/* Registers a sink and starts its worker, false if there is no room left */
+bool addUplinkSink(UplinkSink& sink, const SinkPolicy& policy, LinkUpFn linkUp);
+
+/* Hands a reading to every sink without blocking */
+void publishReading(const Reading& reading);
+
+size_t uplinkSinkCount();
+SinkStats getSinkStats(size_t index);
+void printUplinkStats();
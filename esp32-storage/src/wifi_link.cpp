@@ -0,0 +1,109 @@
+#include <string.h>
+#include "wifi_link.h"
+
+const uint32_t WIFI_HISTOGRAM_LIMITS[WIFI_HISTOGRAM_BUCKETS - 1] = { 250, 500, 1000, 2000, 5000, 10000 };
+
+static bool sameCache(const WifiCache& a, const WifiCache& b) {
+  return memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 && a.channel == b.channel && a.ip == b.ip &&
+         a.gateway == b.gateway && a.subnet == b.subnet && a.dns == b.dns;
+}
+
+WifiLink::WifiLink(WifiRadio& radio, WifiCacheStore& store)
+    : radio(radio), store(store), cache(), cacheStored(false), fastJoin(false), linkState(WIFI_DOWN),
+      stateSinceMs(0), downSinceMs(0), backoffMs(WIFI_BACKOFF_MS), counters() {}
+
+void WifiLink::begin() {
+  cacheStored = store.load(cache);
+  fastJoin = cacheStored;
+}
+
+bool WifiLink::poll(uint32_t nowMs) {
+  uint32_t elapsed = nowMs - stateSinceMs;
+
+  switch (linkState) {
+    case WIFI_DOWN:
+      downSinceMs = nowMs;
+      if (fastJoin) {
+        radio.join(&cache);
+        enter(WIFI_FAST_JOIN, nowMs);
+      } else {
+        radio.join(nullptr);
+        enter(WIFI_FULL_JOIN, nowMs);
+      }
+      break;
+
+    case WIFI_FAST_JOIN:
+      if (radio.connected()) {
+        counters.fastJoins++;
+        connectedAt(nowMs);
+      } else if (elapsed >= WIFI_FAST_JOIN_MS) {
+        // Access point moved or the lease is gone: do it the slow way, and only that until it works again
+        radio.cancel();
+        fastJoin = false;
+        radio.join(nullptr);
+        enter(WIFI_FULL_JOIN, nowMs);
+      }
+      break;
+
+    case WIFI_FULL_JOIN:
+      if (radio.connected()) {
+        connectedAt(nowMs);
+      } else if (elapsed >= WIFI_FULL_JOIN_MS) {
+        radio.cancel();
+        counters.failedJoins++;
+        enter(WIFI_BACKOFF, nowMs);
+      }
+      break;
+
+    case WIFI_BACKOFF:
+      if (elapsed >= backoffMs) {
+        backoffMs = backoffMs * 2 < WIFI_MAX_BACKOFF_MS ? backoffMs * 2 : WIFI_MAX_BACKOFF_MS;
+        uint32_t since = downSinceMs;
+        enter(WIFI_DOWN, nowMs);
+        poll(nowMs);
+        downSinceMs = since;  // Join time counts from when the link went down
+      }
+      break;
+
+    case WIFI_UP:
+      if (!radio.connected()) {
+        counters.drops++;
+        enter(WIFI_DOWN, nowMs);
+        poll(nowMs);
+      }
+      break;
+  }
+  return linkState == WIFI_UP;
+}
+
+void WifiLink::enter(WifiLinkState state, uint32_t nowMs) {
+  linkState = state;
+  stateSinceMs = nowMs;
+}
+
+void WifiLink::connectedAt(uint32_t nowMs) {
+  uint32_t joinMs = nowMs - downSinceMs;
+  counters.connects++;
+  counters.lastJoinMs = joinMs;
+  if (joinMs > counters.maxJoinMs) {
+    counters.maxJoinMs = joinMs;
+  }
+  int bucket = 0;
+  while (bucket < WIFI_HISTOGRAM_BUCKETS - 1 && joinMs >= WIFI_HISTOGRAM_LIMITS[bucket]) {
+    bucket++;
+  }
+  counters.histogram[bucket]++;
+
+  backoffMs = WIFI_BACKOFF_MS;
+  enter(WIFI_UP, nowMs);
+
+  // Only write flash when the access point or lease actually changed
+  WifiCache now = {};
+  if (radio.current(now)) {
+    if (!cacheStored || !sameCache(now, cache)) {
+      cache = now;
+      cacheStored = store.save(cache);
+    }
+    fastJoin = true;
+  }
+}
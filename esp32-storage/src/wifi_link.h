@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Non-blocking WiFi reconnect state machine.
+ *
+ * The last good BSSID, channel and DHCP lease are cached (NVS on the
+ * device). A reconnect first tries a fast join straight to that access
+ * point with the cached static IP, skipping the scan and DHCP, which
+ * brings the link back in a fraction of a second. If that does not work
+ * within WIFI_FAST_JOIN_MS it falls back to a full scan with DHCP, then
+ * backs off. poll() never blocks, so it can run between other work.
+ *
+ * Hardware independent: the radio and the cache store are interfaces.
+ */
+
+#define WIFI_FAST_JOIN_MS 1500       // Cached BSSID + channel + static IP
+#define WIFI_FULL_JOIN_MS 10000      // Scan + DHCP
+#define WIFI_BACKOFF_MS 5000         // After a failed full join, doubling...
+#define WIFI_MAX_BACKOFF_MS 60000    // ...up to this
+#define WIFI_HISTOGRAM_BUCKETS 7
+
+struct WifiCache {
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+class WifiRadio {
+ public:
+  virtual ~WifiRadio() {}
+
+  /* Starts joining; cache = nullptr means scan for the SSID and use DHCP */
+  virtual void join(const WifiCache* cache) = 0;
+  virtual bool connected() = 0;
+
+  /* Access point and lease of the current connection */
+  virtual bool current(WifiCache& cache) = 0;
+
+  /* Abandons a join attempt */
+  virtual void cancel() = 0;
+};
+
+class WifiCacheStore {
+ public:
+  virtual ~WifiCacheStore() {}
+  virtual bool load(WifiCache& cache) = 0;
+  virtual bool save(const WifiCache& cache) = 0;
+};
+
+enum WifiLinkState {
+  WIFI_DOWN,       // Nothing in progress, next poll() starts a join
+  WIFI_FAST_JOIN,
+  WIFI_FULL_JOIN,
+  WIFI_BACKOFF,
+  WIFI_UP
+};
+
+struct WifiLinkStats {
+  uint32_t connects;      // Successful joins, first one included
+  uint32_t fastJoins;     // ...of which with the cached access point
+  uint32_t drops;         // Times an established link went down
+  uint32_t failedJoins;   // Full joins that timed out
+  uint32_t lastJoinMs;    // Link down (or first attempt) until connected
+  uint32_t maxJoinMs;
+  uint32_t histogram[WIFI_HISTOGRAM_BUCKETS];  // Join times, see WIFI_HISTOGRAM_LIMITS
+};
+
+/* Upper bounds of the histogram buckets in ms, the last bucket is open-ended */
+extern const uint32_t WIFI_HISTOGRAM_LIMITS[WIFI_HISTOGRAM_BUCKETS - 1];
+
+class WifiLink {
+ public:
+  WifiLink(WifiRadio& radio, WifiCacheStore& store);
+
+  /* Loads the cached access point */
+  void begin();
+
+  /* Advances the state machine, returns true while the link is up */
+  bool poll(uint32_t nowMs);
+
+  WifiLinkState state() const { return linkState; }
+  const WifiLinkStats& stats() const { return counters; }
+
+ private:
+  void enter(WifiLinkState state, uint32_t nowMs);
+  void connectedAt(uint32_t nowMs);
+
+  WifiRadio& radio;
+  WifiCacheStore& store;
+  WifiCache cache;
+  bool cacheStored;  // cache is what the store holds
+  bool fastJoin;     // Try the cached access point first
+  WifiLinkState linkState;
+  uint32_t stateSinceMs;
+  uint32_t downSinceMs;
+  uint32_t backoffMs;
+  WifiLinkStats counters;
+};
@@ -0,0 +1,171 @@
+#include <math.h>
+#include <string.h>
+#include "window_aggregate.h"
+
+void RunningStats::add(float value) {
+  if (!isfinite(value)) {
+    return;
+  }
+  count++;
+  if (count == 1) {
+    mean = value;
+    m2 = 0;
+    min = value;
+    max = value;
+    return;
+  }
+  float delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+  if (value < min) min = value;
+  if (value > max) max = value;
+}
+
+float RunningStats::stddev() const {
+  return count > 1 ? sqrtf(m2 / (count - 1)) : 0.0f;
+}
+
+void WindowAggregator::setWindows(const uint32_t* durationsMs, size_t count) {
+  if (count > AGGREGATE_WINDOWS) {
+    count = AGGREGATE_WINDOWS;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (i >= windowCount || durations[i] != durationsMs[i]) {
+      windows[i].open = false;
+    }
+    durations[i] = durationsMs[i];
+  }
+  windowCount = count;
+}
+
+size_t WindowAggregator::add(const Reading& reading, AggregateRecord* closed) {
+  size_t closedNow = 0;
+  bool epochAligned = reading.epochMs != 0;
+  uint64_t time = epochAligned ? reading.epochMs : reading.capturedAtMs;
+
+  for (size_t i = 0; i < windowCount; i++) {
+    Window& window = windows[i];
+    uint64_t key = time / durations[i];
+
+    // The first reading of the next window (or a jump onto the synced clock) closes it
+    if (window.open && (key != window.key || epochAligned != window.epochAligned)) {
+      close(window, durations[i], closed[closedNow++]);
+      if (i == windowCount - 1) {
+        memcpy(previousLongest, window.stats, sizeof(previousLongest));
+      }
+      window.open = false;
+    }
+
+    if (!window.open) {
+      memset(window.stats, 0, sizeof(window.stats));
+      window.open = true;
+      window.epochAligned = epochAligned;
+      window.key = key;
+      uint32_t offsetMs = (uint32_t)(time - key * durations[i]);
+      window.startEpochMs = epochAligned ? key * durations[i] : 0;
+      window.startMs = reading.capturedAtMs - offsetMs;
+    }
+
+    for (int c = 0; c < READING_CHANNELS; c++) {
+      window.stats[c].add(readingChannel(reading, (ReadingChannel)c));
+    }
+  }
+  return closedNow;
+}
+
+void WindowAggregator::close(Window& window, uint32_t durationMs, AggregateRecord& record) {
+  record.startEpochMs = window.startEpochMs;
+  record.startMs = window.startMs;
+  record.durationMs = durationMs;
+  record.count = 0;
+  for (int c = 0; c < READING_CHANNELS; c++) {
+    const RunningStats& stats = window.stats[c];
+    if (stats.count > record.count) {
+      record.count = stats.count;
+    }
+    if (stats.count == 0) {
+      record.channels[c] = { NAN, NAN, NAN, NAN };
+    } else {
+      record.channels[c] = { stats.min, stats.max, stats.mean, stats.stddev() };
+    }
+  }
+  closedTotal++;
+}
+
+bool WindowAggregator::isAnomaly(const Reading& reading) const {
+  if (windowCount == 0) {
+    return false;
+  }
+  const Window& longest = windows[windowCount - 1];
+
+  for (int c = 0; c < READING_CHANNELS; c++) {
+    // Early in a window its spread means little, fall back on the previous one
+    const RunningStats* stats = &longest.stats[c];
+    if (!longest.open || stats->count < AGGREGATE_ANOMALY_MIN_SAMPLES) {
+      stats = &previousLongest[c];
+    }
+    if (stats->count < AGGREGATE_ANOMALY_MIN_SAMPLES) {
+      continue;
+    }
+
+    float value = readingChannel(reading, (ReadingChannel)c);
+    if (!isfinite(value)) {
+      continue;
+    }
+    float band = DEFAULT_DEADBANDS[c].relative * fabsf(stats->mean);
+    if (band < DEFAULT_DEADBANDS[c].absolute) {
+      band = DEFAULT_DEADBANDS[c].absolute;
+    }
+    float spread = AGGREGATE_ANOMALY_SIGMAS * stats->stddev();
+    if (fabsf(value - stats->mean) > (band > spread ? band : spread)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t RawSampleGate::admit(const Reading& reading, bool anomaly, Reading* out) {
+  size_t count = 0;
+  bool heartbeat = !haveSent || reading.capturedAtMs - lastSentMs >= DEADBAND_HEARTBEAT_MS;
+  bool statusOnly = false;
+
+  if (anomaly) {
+    // Context before the anomaly, oldest first
+    uint8_t first = (contextHead + AGGREGATE_RAW_CONTEXT - contextCount) % AGGREGATE_RAW_CONTEXT;
+    for (uint8_t i = 0; i < contextCount; i++) {
+      Reading& previous = context[(first + i) % AGGREGATE_RAW_CONTEXT];
+      previous.suppressed = pending - (contextCount - i);
+      out[count++] = previous;
+      pending = contextCount - i - 1;
+    }
+    held -= contextCount;
+    after = AGGREGATE_RAW_CONTEXT;
+  } else if (after > 0) {
+    after--;
+  } else if (!heartbeat) {
+    // Not sent (yet): keep it as context for a later anomaly
+    context[contextHead] = reading;
+    contextHead = (contextHead + 1) % AGGREGATE_RAW_CONTEXT;
+    if (contextCount < AGGREGATE_RAW_CONTEXT) {
+      contextCount++;
+    }
+    pending++;
+    held++;
+    return 0;
+  } else {
+    statusOnly = haveSent;  // Nothing happened, the backend only needs to know that; the first one is full
+  }
+
+  out[count] = reading;
+  out[count].suppressed = pending;
+  if (statusOnly) {
+    out[count].flags |= READING_STATUS_ONLY;
+  }
+  count++;
+  contextCount = 0;
+  pending = 0;
+  haveSent = true;
+  lastSentMs = reading.capturedAtMs;
+  sent += count;
+  return count;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+#include "deadband.h"
+
+/*
+ * Windowed aggregates for long-term history.
+ *
+ * Every channel is summarized per window (min, max, mean, standard
+ * deviation) with Welford's running update: O(1) memory and numerically
+ * stable, no samples kept. Windows are aligned to wall-clock time once SNTP
+ * has synced (a 15 min window starts at :00, :15, ...), to the monotonic
+ * clock before that, and close when the first reading of the next window
+ * arrives.
+ *
+ * Raw readings are only sent around anomalies: a reading further from the
+ * mean of the longest window than its deadband and AGGREGATE_ANOMALY_SIGMAS
+ * standard deviations, plus AGGREGATE_RAW_CONTEXT readings before and after.
+ * Otherwise a status-only heartbeat (READING_STATUS_ONLY) goes out per
+ * DEADBAND_HEARTBEAT_MS so the backend still sees the device alive.
+ *
+ * Hardware independent; no constructors, so both can sit in RTC memory.
+ */
+
+#define AGGREGATE_WINDOWS 2            // Window lengths run side by side, e.g. 1 and 15 minutes
+#define AGGREGATE_ANOMALY_SIGMAS 4.0f
+#define AGGREGATE_ANOMALY_MIN_SAMPLES 8 // Fewer samples say too little about the spread
+#define AGGREGATE_RAW_CONTEXT 3        // Raw readings sent before and after an anomaly
+
+struct RunningStats {
+  uint32_t count;
+  float mean;
+  float m2;  // Sum of squared deviations from the mean
+  float min;
+  float max;
+
+  void add(float value);
+  float stddev() const;
+};
+
+struct ChannelSummary {
+  float min;
+  float max;
+  float mean;
+  float stddev;
+};
+
+struct AggregateRecord {
+  uint64_t startEpochMs;  // Wall-clock window start, 0 if the clock was not synced
+  uint32_t startMs;       // monotonicMs() of the window start
+  uint32_t durationMs;
+  uint32_t count;         // Readings in the window
+  ChannelSummary channels[READING_CHANNELS];  // NaN channels (failed reads) are left out
+};
+
+class WindowAggregator {
+ public:
+  /* Window lengths, at most AGGREGATE_WINDOWS, longest last; takes effect from the next reading */
+  void setWindows(const uint32_t* durationsMs, size_t count);
+
+  /* Adds a reading; windows it closed are copied to closed[], returns how many */
+  size_t add(const Reading& reading, AggregateRecord* closed);
+
+  /* Far outside the spread of the longest window so far (or the last one, early in a window) */
+  bool isAnomaly(const Reading& reading) const;
+
+  uint32_t closedCount() const { return closedTotal; }
+
+ private:
+  struct Window {
+    bool open;
+    bool epochAligned;
+    uint64_t key;       // Window number: start time / duration
+    uint64_t startEpochMs;
+    uint32_t startMs;
+    RunningStats stats[READING_CHANNELS];
+  };
+
+  void close(Window& window, uint32_t durationMs, AggregateRecord& record);
+
+  size_t windowCount;
+  uint32_t durations[AGGREGATE_WINDOWS];
+  Window windows[AGGREGATE_WINDOWS];
+  RunningStats previousLongest[READING_CHANNELS];
+  uint32_t closedTotal;
+};
+
+/* Decides which raw readings go out next to the aggregates */
+class RawSampleGate {
+ public:
+  /*
+   * Feeds every reading; the ones to send (context before an anomaly
+   * first, oldest first) are copied to out[], at most AGGREGATE_RAW_CONTEXT + 1.
+   * Reading::suppressed counts the readings not sent in between. Pass
+   * anomaly for any reading that must go out with its context, e.g. a
+   * status change.
+   */
+  size_t admit(const Reading& reading, bool anomaly, Reading* out);
+
+  uint32_t sentCount() const { return sent; }
+  uint32_t heldCount() const { return held; }
+
+ private:
+  Reading context[AGGREGATE_RAW_CONTEXT];
+  uint8_t contextCount;
+  uint8_t contextHead;
+  uint8_t after;      // Readings still to send after the last anomaly
+  bool haveSent;
+  uint32_t lastSentMs;
+  uint32_t pending;   // Held back since the last reading sent
+  uint32_t sent;
+  uint32_t held;
+};
@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <vector>
+#include "adaptive_rate.h"
+#include "../../tools/room_trace.h"
+
+/*
+ * AdaptiveRate replayed over the synthetic room day of room_trace.h at
+ * 1 s resolution: each reading is taken from the row the last returned
+ * interval points at, as the sampler does. The day's spoilage ramps are
+ * exponential, which a relative deadband sees as a steady ~30 s pace, so
+ * a fast linear leak is laid over the stable hours for the ramp case.
+ */
+
+#define LEAK_ONSET_S 7200
+#define LEAK_PPM_PER_S 0.2f
+#define STABLE_END_S (15 * 3600)
+
+static std::vector<TraceRow> day;
+
+static Reading toReading(const TraceRow& row) {
+  Reading reading = {};
+  reading.capturedAtMs = row.second * 1000;
+  reading.temperature = row.values[0];
+  reading.humidity = row.values[1];
+  reading.co2 = row.values[2];
+  reading.ammonia = row.values[3];
+  reading.methane = row.values[4];
+  reading.ethylene = row.values[5];
+  reading.h2s = row.values[6];
+  return reading;
+}
+
+struct Sample {
+  uint32_t second;
+  uint32_t intervalMs;
+};
+
+/* Samples the trace from second until untilS the way the sampler would, second is left at the next sample */
+static std::vector<Sample> replay(AdaptiveRate& rate, const std::vector<TraceRow>& rows, uint32_t& second, uint32_t untilS) {
+  std::vector<Sample> samples;
+  while (second < untilS && second < rows.size()) {
+    uint32_t intervalMs = rate.update(toReading(rows[second]));
+    samples.push_back({ second, intervalMs });
+    second += intervalMs / 1000;
+  }
+  return samples;
+}
+
+void setUp(void) {
+  if (day.empty()) {
+    day = syntheticRoomTrace(1);
+  }
+}
+
+void tearDown(void) {}
+
+static void test_interval_stays_within_bounds() {
+  static const AdaptiveBounds DEEP_SLEEP = { 30000, 300000, 15, 60000, 900000 };
+  for (const AdaptiveBounds& bounds : { CONTINUOUS_RATE_BOUNDS, DEEP_SLEEP }) {
+    AdaptiveRate rate = {};
+    rate.setBounds(bounds);
+    uint32_t second = 0;
+    std::vector<Sample> samples = replay(rate, day, second, TRACE_DAY_S);
+    TEST_ASSERT_GREATER_THAN(TRACE_DAY_S / (bounds.maxIntervalMs / 1000), samples.size());
+    for (const Sample& sample : samples) {
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(bounds.minIntervalMs, sample.intervalMs);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(bounds.maxIntervalMs, sample.intervalMs);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(bounds.minUplinkMs, rate.uplinkIntervalMs());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(bounds.maxUplinkMs, rate.uplinkIntervalMs());
+  }
+}
+
+static void test_flat_room_relaxes_by_at_most_doubling() {
+  // A perfectly steady reading: no trend yet, then doubling up to the maximum
+  AdaptiveRate steady = {};
+  TraceRow flat = day[0];
+  static const uint32_t EXPECTED_MS[] = { 2000, 2000, 4000, 8000, 16000, 32000, 60000, 60000 };
+  uint32_t second = 0;
+  for (uint32_t expected : EXPECTED_MS) {
+    flat.second = second;
+    uint32_t intervalMs = steady.update(toReading(flat));
+    TEST_ASSERT_EQUAL_UINT32(expected, intervalMs);
+    second += intervalMs / 1000;
+  }
+
+  // The stable hours of the day, DHT11 flicker and gas noise included
+  AdaptiveRate rate = {};
+  second = 0;
+  std::vector<Sample> samples = replay(rate, day, second, STABLE_END_S);
+  for (size_t i = 1; i < samples.size(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * samples[i - 1].intervalMs, samples[i].intervalMs);
+  }
+  TEST_ASSERT_TRUE(rate.samplesPerMinute() < 1.5f);  // Against 12 at a fixed 5 s
+  TEST_ASSERT_EQUAL_UINT32(0, rate.surpriseCount());
+}
+
+static void test_spike_drops_to_min() {
+  AdaptiveRate rate = {};
+  uint32_t second = 0;
+  replay(rate, day, second, TRACE_CO2_SPIKE_S);
+  TEST_ASSERT_EQUAL_UINT32(CONTINUOUS_RATE_BOUNDS.maxIntervalMs, rate.intervalMs());
+
+  // The first reading that sees the CO2 spike samples as fast as allowed
+  std::vector<Sample> samples = replay(rate, day, second, TRACE_CO2_SPIKE_S + 600);
+  size_t first = 0;
+  while (day[samples[first].second].values[2] < 600.0f) {
+    first++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(CONTINUOUS_RATE_BOUNDS.minIntervalMs, samples[first].intervalMs);
+  TEST_ASSERT_EQUAL_UINT32(1, rate.surpriseCount());
+  TEST_ASSERT_EQUAL(CHANNEL_CO2, rate.drivingChannel());
+}
+
+static void test_ramp_drops_to_min() {
+  // Ethylene leaking in at 0.2 ppm/s from the stable baseline of 2 ppm
+  std::vector<TraceRow> leak(day.begin(), day.begin() + LEAK_ONSET_S + 1800);
+  for (uint32_t s = LEAK_ONSET_S; s < leak.size(); s++) {
+    leak[s].values[5] += LEAK_PPM_PER_S * (s - LEAK_ONSET_S);
+  }
+  AdaptiveRate rate = {};
+  uint32_t second = 0;
+  replay(rate, leak, second, LEAK_ONSET_S);
+  std::vector<Sample> samples = replay(rate, leak, second, leak.size());
+
+  // Down to the minimum within a minute of the onset, and held there while the band is absolute
+  size_t first = 0;
+  while (samples[first].intervalMs > CONTINUOUS_RATE_BOUNDS.minIntervalMs) {
+    first++;
+  }
+  TEST_ASSERT_LESS_THAN_UINT32(LEAK_ONSET_S + 120, samples[first].second);
+  for (size_t i = first; i < samples.size() && leak[samples[i].second].values[5] < 15.0f; i++) {
+    TEST_ASSERT_EQUAL_UINT32(CONTINUOUS_RATE_BOUNDS.minIntervalMs, samples[i].intervalMs);
+  }
+
+  // The day's doubling ramp keeps a steady pace well above the stable one
+  AdaptiveRate spoiling = {};
+  second = 0;
+  samples = replay(spoiling, day, second, 18 * 3600);
+  uint32_t rampSamples = 0;
+  for (const Sample& sample : samples) {
+    rampSamples += sample.second >= 17 * 3600;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(90, rampSamples);
+  TEST_ASSERT_EQUAL(CHANNEL_ETHYLENE, spoiling.drivingChannel());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_interval_stays_within_bounds);
+  RUN_TEST(test_flat_room_relaxes_by_at_most_doubling);
+  RUN_TEST(test_spike_drops_to_min);
+  RUN_TEST(test_ramp_drops_to_min);
+  return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <unity.h>
+#include <math.h>
+#include <random>
+#include "adc_filter.h"
+
+/*
+ * AdcFilter on an MQ135 trace as the acquisition task sees it: bursts of
+ * 256 codes four times a second, Gaussian noise of sigma 15 codes, and
+ * 1 % of the codes hit by a +/-600 code spike (WiFi TX coupling into the
+ * ADC).
+ */
+
+#define BURST 256
+#define BURSTS_PER_S 4
+#define NOISE_SIGMA 15.0
+#define SPIKE_RATE 0.01
+#define SPIKE_CODES 600
+
+static std::mt19937 noise(11);
+
+static uint16_t sample(double level, bool spikes) {
+  std::normal_distribution<double> gauss(0.0, NOISE_SIGMA);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double code = level + gauss(noise);
+  if (spikes && uniform(noise) < SPIKE_RATE) {
+    code += uniform(noise) < 0.5 ? -SPIKE_CODES : SPIKE_CODES;
+  }
+  return (uint16_t)fmin(4095.0, fmax(0.0, round(code)));
+}
+
+void setUp(void) {
+  noise.seed(11);
+}
+
+void tearDown(void) {}
+
+static void test_median_rejects_spikes() {
+  // Up to four spikes in a window of nine leave the median on the level
+  const uint16_t window[ADC_MEDIAN_WINDOW] = { 1500, 2100, 1502, 900, 1499, 2100, 1501, 4095, 1500 };
+  AdcFilter filter;
+  filter.add(window, ADC_MEDIAN_WINDOW);
+  TEST_ASSERT_TRUE(filter.ready());
+  TEST_ASSERT_EQUAL_FLOAT(1501.0f, filter.value());
+
+  // A whole minute of noisy, spiky codes at one level
+  filter.reset();
+  double worst = 0;
+  for (int burst = 0; burst < 60 * BURSTS_PER_S; burst++) {
+    for (int i = 0; i < BURST; i++) {
+      filter.add(sample(1500, true));
+    }
+    if (burst >= BURSTS_PER_S) {
+      worst = fmax(worst, fabs(filter.value() - 1500.0));
+    }
+  }
+  TEST_ASSERT_TRUE(worst < 5.0);
+}
+
+static void test_iir_settles_on_a_step() {
+  AdcFilter filter;
+  uint16_t level[ADC_MEDIAN_WINDOW];
+  for (int i = 0; i < ADC_MEDIAN_WINDOW; i++) {
+    level[i] = 1500;
+  }
+  filter.add(level, ADC_MEDIAN_WINDOW);
+
+  for (int i = 0; i < ADC_MEDIAN_WINDOW; i++) {
+    level[i] = 1800;
+  }
+  float previous = filter.value();
+  for (int median = 1; median <= 150; median++) {
+    filter.add(level, ADC_MEDIAN_WINDOW);
+    // Approaches the new level from below, never past it
+    TEST_ASSERT_TRUE(filter.value() > previous);
+    TEST_ASSERT_TRUE(filter.value() <= 1800.0f);
+    previous = filter.value();
+
+    // First order: 1 - (1 - alpha)^n of the step after n medians
+    float expected = 1800.0f - 300.0f * powf(1.0f - ADC_IIR_ALPHA, median);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, expected, filter.value());
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 1800.0f, filter.value());
+}
+
+static void test_spread_tracks_injected_noise() {
+  AdcFilter filter;
+  for (int burst = 0; burst < 60 * BURSTS_PER_S; burst++) {
+    for (int i = 0; i < BURST; i++) {
+      filter.add(sample(1500, true));
+    }
+  }
+  // MAD of nine codes reads a little low, but the spikes do not inflate it
+  TEST_ASSERT_FLOAT_WITHIN(0.2 * NOISE_SIGMA, NOISE_SIGMA, filter.noise());
+  TEST_ASSERT_EQUAL_UINT32(60 * BURSTS_PER_S * BURST, filter.samples());
+}
+
+static void test_drifting_level_is_tracked_far_better_than_single_reads() {
+  // 60 s drifting 1500 -> 1560: the filtered code against one analogRead()-style code per burst
+  AdcFilter filter;
+  double filteredSquares = 0;
+  double singleSquares = 0;
+  int readings = 0;
+  for (int burst = 0; burst < 60 * BURSTS_PER_S; burst++) {
+    double level = 1500.0 + 60.0 * burst / (60 * BURSTS_PER_S);
+    uint16_t single = 0;
+    for (int i = 0; i < BURST; i++) {
+      uint16_t code = sample(level, true);
+      if (i == 0) {
+        single = code;
+      }
+      filter.add(code);
+    }
+    if (burst >= BURSTS_PER_S) {
+      filteredSquares += (filter.value() - level) * (filter.value() - level);
+      singleSquares += (single - level) * (single - level);
+      readings++;
+    }
+  }
+  double filteredRms = sqrt(filteredSquares / readings);
+  double singleRms = sqrt(singleSquares / readings);
+  TEST_ASSERT_TRUE(filteredRms < 3.0);
+  TEST_ASSERT_TRUE(singleRms > 5 * filteredRms);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_rejects_spikes);
+  RUN_TEST(test_iir_settles_on_a_step);
+  RUN_TEST(test_spread_tracks_injected_noise);
+  RUN_TEST(test_drifting_level_is_tracked_far_better_than_single_reads);
+  return UNITY_END();
+}
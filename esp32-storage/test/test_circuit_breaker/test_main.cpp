@@ -0,0 +1,232 @@
+#include <unity.h>
+#include <string.h>
+#include "circuit_breaker.h"
+
+/*
+ * CircuitBreaker on a fake clock, with the backend sink's policy: 3
+ * failures open it, 5 s base delay, 300 s cap.
+ */
+
+#define BASE_DELAY_MS 5000
+#define MAX_DELAY_MS 300000
+#define FAILURES_TO_OPEN 3
+#define SEED 0x1234567UL
+
+#define FLEET 100
+#define BATCH_INTERVAL_MS 60000  // A closed breaker sends one batch a minute
+#define SINK_POLL_MS 10
+#define OUTAGE_MS 600000         // Backend refuses everything for the first 10 min
+#define BUCKET_MS 5000
+
+static uint32_t now;
+
+static void configure(CircuitBreaker& breaker, uint32_t seed) {
+  memset(&breaker, 0, sizeof(breaker));  // Zero-initialized like a sink slot
+  breaker.configure(BASE_DELAY_MS, MAX_DELAY_MS, FAILURES_TO_OPEN, seed);
+}
+
+/* Fails FAILURES_TO_OPEN requests in a row */
+static void trip(CircuitBreaker& breaker) {
+  for (int i = 0; i < FAILURES_TO_OPEN; i++) {
+    TEST_ASSERT_TRUE(breaker.allow(now));
+    breaker.recordFailure(now);
+  }
+}
+
+void setUp(void) {
+  now = 1000;
+}
+
+void tearDown(void) {}
+
+static void test_closed_open_half_open_closed() {
+  CircuitBreaker breaker;
+  configure(breaker, SEED);
+  TEST_ASSERT_EQUAL(BREAKER_CLOSED, breaker.state());
+
+  // Below the threshold it stays closed
+  for (int i = 0; i < FAILURES_TO_OPEN - 1; i++) {
+    TEST_ASSERT_TRUE(breaker.allow(now));
+    breaker.recordFailure(now);
+    TEST_ASSERT_EQUAL(BREAKER_CLOSED, breaker.state());
+  }
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  breaker.recordFailure(now);
+  TEST_ASSERT_EQUAL(BREAKER_OPEN, breaker.state());
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().opens);
+
+  // Nothing goes through until the delay runs out
+  uint32_t delay = breaker.retryInMs(now);
+  TEST_ASSERT_EQUAL_UINT32(breaker.stats().lastDelayMs, delay);
+  if (delay > 0) {
+    now += delay - 1;
+    TEST_ASSERT_FALSE(breaker.allow(now));
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.retryInMs(now));
+    now++;
+  }
+
+  // One probe only
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  TEST_ASSERT_EQUAL(BREAKER_HALF_OPEN, breaker.state());
+  TEST_ASSERT_FALSE(breaker.allow(now));
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().probes);
+
+  breaker.recordSuccess();
+  TEST_ASSERT_EQUAL(BREAKER_CLOSED, breaker.state());
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  TEST_ASSERT_EQUAL_UINT32(0, breaker.retryInMs(now));
+
+  // Closed again means the full threshold is needed to reopen
+  breaker.recordFailure(now);
+  TEST_ASSERT_EQUAL(BREAKER_CLOSED, breaker.state());
+}
+
+static void test_failed_probe_reopens_with_longer_ceiling() {
+  CircuitBreaker breaker;
+  configure(breaker, SEED);
+  trip(breaker);
+
+  uint32_t ceiling = BASE_DELAY_MS;
+  for (int probe = 0; probe < 12; probe++) {
+    now += breaker.retryInMs(now);
+    TEST_ASSERT_TRUE(breaker.allow(now));
+    breaker.recordFailure(now);
+    TEST_ASSERT_EQUAL(BREAKER_OPEN, breaker.state());
+
+    ceiling = ceiling * 2 < MAX_DELAY_MS ? ceiling * 2 : MAX_DELAY_MS;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(ceiling, breaker.stats().lastDelayMs);
+  }
+  // Failed probes do not count as new opens
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().opens);
+}
+
+static void test_unused_probe_goes_to_the_next_caller() {
+  CircuitBreaker breaker;
+  configure(breaker, SEED);
+  trip(breaker);
+  now += breaker.retryInMs(now);
+
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  breaker.recordIdle();
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  TEST_ASSERT_EQUAL(BREAKER_HALF_OPEN, breaker.state());
+}
+
+static void test_open_delay_survives_clock_wrap() {
+  CircuitBreaker breaker;
+  configure(breaker, SEED);
+  now = 0xFFFFFFFFUL - 100;
+  trip(breaker);
+
+  uint32_t delay = breaker.retryInMs(now);
+  TEST_ASSERT_GREATER_THAN_UINT32(100, delay);  // Holds for this seed, the wrap is inside the delay
+  now += 200;
+  TEST_ASSERT_FALSE(breaker.allow(now));
+  TEST_ASSERT_EQUAL_UINT32(delay - 200, breaker.retryInMs(now));
+}
+
+static void test_reconfigure_keeps_state() {
+  CircuitBreaker breaker;
+  configure(breaker, SEED);
+  trip(breaker);
+  uint32_t delay = breaker.retryInMs(now);
+
+  breaker.configure(BASE_DELAY_MS, MAX_DELAY_MS, FAILURES_TO_OPEN, SEED + 1);
+  TEST_ASSERT_EQUAL(BREAKER_OPEN, breaker.state());
+  TEST_ASSERT_EQUAL_UINT32(delay, breaker.retryInMs(now));
+}
+
+static void test_jitter_stays_within_bounds() {
+  // Every delay is in [0, min(max, base * 2^attempt)], and over many devices fills that range
+  uint64_t sum[8] = {};
+  uint32_t lowest[8];
+  uint32_t highest[8] = {};
+  for (int i = 0; i < 8; i++) {
+    lowest[i] = 0xFFFFFFFFUL;
+  }
+
+  for (uint32_t device = 0; device < 1000; device++) {
+    CircuitBreaker breaker;
+    configure(breaker, SEED * (device + 1));
+    trip(breaker);
+    for (int attempt = 0; attempt < 8; attempt++) {
+      uint64_t ceiling = (uint64_t)BASE_DELAY_MS << attempt;
+      if (ceiling > MAX_DELAY_MS) {
+        ceiling = MAX_DELAY_MS;
+      }
+      uint32_t delay = breaker.stats().lastDelayMs;
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32((uint32_t)ceiling, delay);
+      TEST_ASSERT_EQUAL_UINT32(delay, breaker.retryInMs(now));
+      sum[attempt] += delay;
+      if (delay < lowest[attempt]) lowest[attempt] = delay;
+      if (delay > highest[attempt]) highest[attempt] = delay;
+
+      now += delay;
+      TEST_ASSERT_TRUE(breaker.allow(now));
+      breaker.recordFailure(now);
+    }
+  }
+
+  for (int attempt = 0; attempt < 8; attempt++) {
+    uint32_t ceiling = (uint64_t)BASE_DELAY_MS << attempt > MAX_DELAY_MS ? MAX_DELAY_MS : BASE_DELAY_MS << attempt;
+    // Full jitter: mean near half the ceiling, both ends reached
+    TEST_ASSERT_UINT32_WITHIN(ceiling / 10, ceiling / 2, (uint32_t)(sum[attempt] / 1000));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(ceiling / 20, lowest[attempt]);
+    TEST_ASSERT_GREATER_THAN_UINT32(ceiling - ceiling / 20, highest[attempt]);
+  }
+}
+
+static void test_fleet_comes_back_spread_out() {
+  // A fleet that booted together after a power cut, against a backend that is down for 10 min
+  static CircuitBreaker breakers[FLEET];
+  uint32_t nextBatch[FLEET];
+  uint32_t recoveredAt[FLEET] = {};
+  uint32_t perBucket[MAX_DELAY_MS / BUCKET_MS + 1] = {};
+
+  for (int device = 0; device < FLEET; device++) {
+    configure(breakers[device], SEED * (device + 1));
+    nextBatch[device] = 0;
+  }
+
+  uint32_t lastRecovery = 0;
+  int recovered = 0;
+  for (now = 0; recovered < FLEET && now < OUTAGE_MS + 2 * MAX_DELAY_MS; now += SINK_POLL_MS) {
+    bool backendUp = now >= OUTAGE_MS;
+    for (int device = 0; device < FLEET; device++) {
+      CircuitBreaker& breaker = breakers[device];
+      bool due = breaker.state() != BREAKER_CLOSED || now >= nextBatch[device];
+      if (recoveredAt[device] != 0 || !due || !breaker.allow(now)) {
+        continue;
+      }
+      if (!backendUp) {
+        breaker.recordFailure(now);
+        nextBatch[device] = now + BATCH_INTERVAL_MS;
+        continue;
+      }
+      breaker.recordSuccess();
+      recoveredAt[device] = now;
+      perBucket[(now - OUTAGE_MS) / BUCKET_MS]++;
+      lastRecovery = now;
+      recovered++;
+    }
+  }
+
+  // Everyone is back within one full ceiling, not all in the same moment
+  TEST_ASSERT_EQUAL(FLEET, recovered);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_DELAY_MS, lastRecovery - OUTAGE_MS);
+  for (uint32_t bucket = 0; bucket <= MAX_DELAY_MS / BUCKET_MS; bucket++) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(FLEET / 10, perBucket[bucket]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_closed_open_half_open_closed);
+  RUN_TEST(test_failed_probe_reopens_with_longer_ceiling);
+  RUN_TEST(test_unused_probe_goes_to_the_next_caller);
+  RUN_TEST(test_open_delay_survives_clock_wrap);
+  RUN_TEST(test_reconfigure_keeps_state);
+  RUN_TEST(test_jitter_stays_within_bounds);
+  RUN_TEST(test_fleet_comes_back_spread_out);
+  return UNITY_END();
+}
@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <math.h>
+#include <random>
+#include "gas_detector.h"
+
+/*
+ * GasDetector on generated gas levels: a stable room with sensor noise
+ * and a daily swing must never trip, a spike or a doubling ramp must trip
+ * within a few readings, and a trip is reported once.
+ */
+
+#define NOISE 0.015          // Relative sensor noise per reading
+#define DAILY_SWING 0.10     // +/-10 % over a day
+#define DAY_S 86400
+
+static const float BASELINE_PPM[GAS_CHANNELS] = { 420.0f, 5.0f, 3.0f, 2.0f, 0.5f };
+
+static std::mt19937 noise(7);
+static GasDetector detector;
+static uint32_t nowS;
+static double swing;  // Amplitude of the daily swing
+
+/* One reading at nowS, every gas at its baseline times the given factor, with noise */
+static uint8_t feed(uint32_t stepS, const float factor[GAS_CHANNELS]) {
+  std::normal_distribution<double> gauss(0.0, 1.0);
+  float ppm[GAS_CHANNELS];
+  double daily = 1.0 + swing * sin(2 * M_PI * nowS / DAY_S);
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    ppm[gas] = BASELINE_PPM[gas] * factor[gas] * daily * (1.0 + NOISE * gauss(noise));
+  }
+
+  Reading reading = {};
+  reading.capturedAtMs = nowS * 1000;
+  reading.temperature = 24.0f;
+  reading.humidity = 60.0f;
+  reading.co2 = ppm[GAS_CO2];
+  reading.ammonia = ppm[GAS_AMMONIA];
+  reading.methane = ppm[GAS_METHANE];
+  reading.ethylene = ppm[GAS_ETHYLENE];
+  reading.h2s = ppm[GAS_H2S];
+
+  nowS += stepS;
+  return detector.update(reading);
+}
+
+static uint8_t feedStable(uint32_t stepS) {
+  static const float STABLE[GAS_CHANNELS] = { 1, 1, 1, 1, 1 };
+  return feed(stepS, STABLE);
+}
+
+/* Readings of a stable room until the baseline has settled */
+static void warmUp(uint32_t stepS) {
+  for (uint32_t s = 0; s < 2 * 3600; s += stepS) {
+    TEST_ASSERT_EQUAL(0, feedStable(stepS));
+  }
+}
+
+void setUp(void) {
+  detector = GasDetector();
+  noise.seed(7);
+  nowS = 0;
+  swing = DAILY_SWING;
+}
+
+void tearDown(void) {}
+
+static void test_stable_room_never_trips() {
+  // 30 days at the deep sleep interval, and one at the continuous one
+  for (uint32_t s = 0; s < 30 * DAY_S; s += 60) {
+    TEST_ASSERT_EQUAL(0, feedStable(60));
+  }
+  setUp();
+  for (uint32_t s = 0; s < DAY_S; s += 5) {
+    TEST_ASSERT_EQUAL(0, feedStable(5));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, detector.tripCount());
+}
+
+static void test_spike_trips_within_two_readings() {
+  warmUp(5);
+  float factor[GAS_CHANNELS] = { 2.5f, 1, 1, 1, 1 };
+  uint8_t tripped = feed(5, factor) | feed(5, factor);
+  TEST_ASSERT_EQUAL(1 << GAS_CO2, tripped);
+  TEST_ASSERT_TRUE(detector.alarmed(GAS_CO2));
+  TEST_ASSERT_FLOAT_WITHIN(40.0f, 420.0f, detector.baselinePpm(GAS_CO2));
+}
+
+static void test_doubling_ramp_trips_early() {
+  // Ethylene doubling every 20 minutes, sampled every 5 s and every 60 s
+  for (uint32_t stepS : { 5u, 60u }) {
+    setUp();
+    warmUp(stepS);
+    float factor[GAS_CHANNELS] = { 1, 1, 1, 1, 1 };
+    uint32_t readings = 0;
+    uint8_t tripped = 0;
+    while (tripped == 0 && readings < 100) {
+      factor[GAS_ETHYLENE] = pow(2.0, readings * stepS / 1200.0);
+      tripped = feed(stepS, factor);
+      readings++;
+    }
+    TEST_ASSERT_EQUAL(1 << GAS_ETHYLENE, tripped);
+    // Long before the level doubles: under +30 %
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(stepS == 5 ? 80 : 7, readings);
+  }
+}
+
+static void test_trip_is_reported_once_and_clears() {
+  swing = 0;  // The baseline lags the swing by about a sigma, too close to the clearing band
+  warmUp(60);
+  float high[GAS_CHANNELS] = { 1, 3.0f, 1, 1, 1 };
+  int trips = 0;
+  for (int i = 0; i < 30; i++) {
+    trips += feed(60, high) != 0;
+  }
+  TEST_ASSERT_EQUAL(1, trips);
+  TEST_ASSERT_TRUE(detector.alarmed(GAS_AMMONIA));
+
+  // Back to the old level: cleared once DETECTOR_CLEAR_SAMPLES in a row sit within a sigma, then a new rise alerts again
+  for (int i = 0; i < 5 * DETECTOR_CLEAR_SAMPLES && detector.alarmed(GAS_AMMONIA); i++) {
+    TEST_ASSERT_EQUAL(0, feedStable(60));
+  }
+  TEST_ASSERT_FALSE(detector.alarmed(GAS_AMMONIA));
+  for (int i = 0; i < 3 && trips < 2; i++) {
+    trips += feed(60, high) != 0;
+  }
+  TEST_ASSERT_EQUAL(2, trips);
+}
+
+static void test_new_level_becomes_baseline_after_an_hour() {
+  warmUp(60);
+  float high[GAS_CHANNELS] = { 1, 1, 1, 1, 3.0f };
+  int trips = 0;
+  for (uint32_t s = 0; s < DETECTOR_REARM_MS / 1000 + 2 * 3600; s += 60) {
+    trips += feed(60, high) != 0;
+  }
+  // Tripped once; after the re-arm the raised level is the new normal
+  TEST_ASSERT_EQUAL(1, trips);
+  TEST_ASSERT_FALSE(detector.alarmed(GAS_H2S));
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, 1.5f, detector.baselinePpm(GAS_H2S));
+}
+
+static void test_failed_reads_are_ignored() {
+  warmUp(60);
+  float broken[GAS_CHANNELS] = { NAN, 0, INFINITY, -1, 1 };
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL(0, feed(60, broken));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(40.0f, 420.0f, detector.baselinePpm(GAS_CO2));
+  TEST_ASSERT_EQUAL(0, feedStable(60));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_stable_room_never_trips);
+  RUN_TEST(test_spike_trips_within_two_readings);
+  RUN_TEST(test_doubling_ramp_trips_early);
+  RUN_TEST(test_trip_is_reported_once_and_clears);
+  RUN_TEST(test_new_level_becomes_baseline_after_an_hour);
+  RUN_TEST(test_failed_reads_are_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include <unity.h>
+#include <math.h>
+#include "gas_table.h"
+
+/*
+ * The compile-time table and GasCalibration against the pow() formula
+ * readSensors() used before, over the whole 12-bit ADC range.
+ */
+
+#define MAX_RELATIVE_ERROR 2e-4  // Table vs pow(), integer codes and fractional codes 64..4000
+#define CALIBRATED_R0 35.0f
+
+/* The old per-sample conversion */
+static void referencePpm(double code, double r0, double ppm[GAS_CHANNELS]) {
+  double voltage = code * (3.3 / 4095.0);
+  double rs = ((3.3 - voltage) / voltage) * MQ135_RL;
+  double ratio = rs / r0;
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    ppm[gas] = GAS_CURVES[gas].a * pow(ratio, GAS_CURVES[gas].b) * GAS_SCALE;
+  }
+}
+
+static double relativeError(const float actual[GAS_CHANNELS], const double expected[GAS_CHANNELS]) {
+  double worst = 0.0;
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    double error = fabs(actual[gas] - expected[gas]) / expected[gas];
+    if (error > worst) {
+      worst = error;
+    }
+  }
+  return worst;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_table_matches_pow_for_every_code() {
+  float ppm[GAS_CHANNELS];
+  double expected[GAS_CHANNELS];
+  double worst = 0.0;
+  for (int code = 1; code < ADC_CODES - 1; code++) {
+    gasPpmFromCode(code, ppm);
+    referencePpm(code, MQ135_R0, expected);
+    worst = fmax(worst, relativeError(ppm, expected));
+  }
+  TEST_ASSERT_TRUE(worst <= MAX_RELATIVE_ERROR);
+}
+
+static void test_calibrated_r0_matches_pow_for_every_code() {
+  GasCalibration calibration;
+  calibration.setR0(CALIBRATED_R0);
+
+  float ppm[GAS_CHANNELS];
+  double expected[GAS_CHANNELS];
+  double worst = 0.0;
+  for (int code = 1; code < ADC_CODES - 1; code++) {
+    calibration.convert(code, ppm);
+    referencePpm(code, CALIBRATED_R0, expected);
+    worst = fmax(worst, relativeError(ppm, expected));
+  }
+  TEST_ASSERT_TRUE(worst <= MAX_RELATIVE_ERROR);
+}
+
+static void test_fractional_codes_interpolate_away_from_the_rails() {
+  GasCalibration calibration;
+  calibration.setR0(CALIBRATED_R0);
+
+  float ppm[GAS_CHANNELS];
+  double expected[GAS_CHANNELS];
+  double worst = 0.0;
+  for (float code = 64.5f; code < 4000.0f; code += 1.0f) {
+    calibration.convert(code, ppm);
+    referencePpm(code, CALIBRATED_R0, expected);
+    worst = fmax(worst, relativeError(ppm, expected));
+  }
+  TEST_ASSERT_TRUE(worst <= MAX_RELATIVE_ERROR);
+}
+
+static void test_rails_stay_finite() {
+  float ppm[GAS_CHANNELS];
+  float last[GAS_CHANNELS];
+
+  // No current through the sensor
+  gasPpmFromCode(0, ppm);
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, ppm[gas]);
+  }
+
+  // A saturated ADC reads like the last finite code instead of ~1e27
+  gasPpmFromCode(ADC_CODES - 1, ppm);
+  gasPpmFromCode(ADC_CODES - 2, last);
+  for (int gas = 0; gas < GAS_CHANNELS; gas++) {
+    TEST_ASSERT_EQUAL_FLOAT(last[gas], ppm[gas]);
+  }
+
+  // Out of range and NaN codes are clamped
+  GasCalibration calibration;
+  calibration.convert(NAN, ppm);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, ppm[GAS_CO2]);
+  calibration.convert(5000.0f, ppm);
+  TEST_ASSERT_EQUAL_FLOAT(last[GAS_CO2], ppm[GAS_CO2]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_matches_pow_for_every_code);
+  RUN_TEST(test_calibrated_r0_matches_pow_for_every_code);
+  RUN_TEST(test_fractional_codes_interpolate_away_from_the_rails);
+  RUN_TEST(test_rails_stay_finite);
+  return UNITY_END();
+}
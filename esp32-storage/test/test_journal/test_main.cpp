@@ -0,0 +1,320 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+
+/*
+ * Journal against files in a temporary directory. The storage can be cut
+ * off after a given number of written bytes, leaving the write in
+ * progress torn, like a power loss mid-write; the backend drops every
+ * third request.
+ */
+
+#define BATCH 24
+#define CUT_STEP 211  // Bytes between simulated power cuts, not a multiple of any record or header size
+
+class FileStorage : public JournalStorage {
+ public:
+  explicit FileStorage(const std::string& root) : root(root), budget(-1), powered(true) {}
+
+  /* Power fails once this many more bytes were written, -1 never */
+  void cutAfter(long bytes) {
+    budget = bytes;
+    powered = true;
+  }
+  bool on() const { return powered; }
+
+  int32_t fileSize(const char* path) override {
+    struct stat st;
+    if (!powered || stat(full(path).c_str(), &st) != 0) {
+      return -1;
+    }
+    return st.st_size;
+  }
+
+  bool readAt(const char* path, uint32_t offset, void* data, size_t length) override {
+    FILE* file = powered ? fopen(full(path).c_str(), "rb") : nullptr;
+    if (file == nullptr) {
+      return false;
+    }
+    bool ok = fseek(file, offset, SEEK_SET) == 0 && fread(data, 1, length, file) == length;
+    fclose(file);
+    return ok;
+  }
+
+  bool append(const char* path, const void* data, size_t length) override {
+    return write(path, "ab", data, length);
+  }
+
+  bool writeFile(const char* path, const void* data, size_t length) override {
+    return write(path, "wb", data, length);
+  }
+
+  bool remove(const char* path) override {
+    return powered && ::remove(full(path).c_str()) == 0;
+  }
+
+ private:
+  std::string full(const char* path) const { return root + path; }
+
+  bool write(const char* path, const char* mode, const void* data, size_t length) {
+    if (!powered) {
+      return false;
+    }
+    size_t kept = length;
+    if (budget >= 0 && (long)length > budget) {
+      kept = budget;  // Torn: only the start reaches flash
+      powered = false;
+    }
+    FILE* file = fopen(full(path).c_str(), mode);
+    if (file == nullptr) {
+      return false;
+    }
+    bool ok = fwrite(data, 1, kept, file) == kept;
+    fclose(file);
+    if (budget >= 0) {
+      budget -= kept;
+    }
+    return ok && powered;
+  }
+
+  std::string root;
+  long budget;
+  bool powered;
+};
+
+/* Accepts two requests out of three */
+class DroppingBackend {
+ public:
+  DroppingBackend() : requests(0) {}
+
+  bool post(const Reading* readings, size_t count, std::vector<uint32_t>& received) {
+    if (++requests % 3 == 0) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      received.push_back(readings[i].sequence);
+    }
+    return true;
+  }
+
+ private:
+  uint32_t requests;
+};
+
+static char directory[64];
+
+void setUp(void) {
+  snprintf(directory, sizeof(directory), "/tmp/journal_test_XXXXXX");
+  TEST_ASSERT_NOT_NULL(mkdtemp(directory));
+}
+
+void tearDown(void) {
+  std::string command = std::string("rm -rf ") + directory;
+  system(command.c_str());
+}
+
+static void clearDirectory() {
+  tearDown();
+  mkdir(directory, 0700);
+}
+
+static Reading reading(uint32_t sequence) {
+  Reading reading = {};
+  reading.sequence = sequence;
+  reading.temperature = 4.0f + sequence * 0.01f;
+  return reading;
+}
+
+/* One replay attempt: a batch from the replay cursor, consumed only if the backend took it */
+static bool replayBatch(Journal& journal, DroppingBackend& backend, std::vector<uint32_t>& received) {
+  Reading batch[BATCH];
+  uint32_t session = 0;
+  size_t count = journal.peek(batch, BATCH, session);
+  if (count == 0) {
+    return false;
+  }
+  if (backend.post(batch, count, received)) {
+    journal.commit(count);
+  }
+  return true;
+}
+
+static void drain(Journal& journal, DroppingBackend& backend, std::vector<uint32_t>& received) {
+  for (int attempt = 0; attempt < 10000 && replayBatch(journal, backend, received); attempt++) {
+  }
+}
+
+static void assertIncreasing(const std::vector<uint32_t>& sequences) {
+  for (size_t i = 1; i < sequences.size(); i++) {
+    TEST_ASSERT_GREATER_THAN_UINT32(sequences[i - 1], sequences[i]);
+  }
+}
+
+void test_replay_keeps_order_with_dropping_backend(void) {
+  FileStorage storage(directory);
+  Journal journal(storage);
+  TEST_ASSERT_TRUE(journal.begin());
+  DroppingBackend backend;
+  std::vector<uint32_t> received;
+
+  const uint32_t total = JOURNAL_RECORDS_PER_SEGMENT * 3 + 17;
+  for (uint32_t sequence = 0; sequence < total; sequence++) {
+    TEST_ASSERT_TRUE(journal.append(reading(sequence), 1));
+    if (sequence % 7 == 6) {
+      replayBatch(journal, backend, received);
+    }
+  }
+  drain(journal, backend, received);
+
+  TEST_ASSERT_EQUAL_UINT32(total, received.size());
+  assertIncreasing(received);
+  TEST_ASSERT_EQUAL_UINT32(0, journal.pending());
+  TEST_ASSERT_EQUAL_UINT32(0, journal.stats().dropped);
+}
+
+void test_batches_split_at_boot_sessions(void) {
+  FileStorage storage(directory);
+  Journal journal(storage);
+  journal.begin();
+  for (uint32_t sequence = 0; sequence < 10; sequence++) {
+    journal.append(reading(sequence), sequence < 4 ? 1 : 2);
+  }
+
+  Reading batch[BATCH];
+  uint32_t session = 0;
+  TEST_ASSERT_EQUAL_UINT32(4, journal.peek(batch, BATCH, session));
+  TEST_ASSERT_EQUAL_UINT32(1, session);
+  journal.commit(4);
+  TEST_ASSERT_EQUAL_UINT32(6, journal.peek(batch, BATCH, session));
+  TEST_ASSERT_EQUAL_UINT32(2, session);
+  TEST_ASSERT_EQUAL_UINT32(4, batch[0].sequence);
+}
+
+void test_power_cut_loses_nothing(void) {
+  const uint32_t appends = JOURNAL_RECORDS_PER_SEGMENT * 2 + 40;
+  uint32_t cuts = 0;
+
+  for (long cut = 0; ; cut += CUT_STEP) {
+    clearDirectory();
+    FileStorage storage(directory);
+    storage.cutAfter(cut);
+    DroppingBackend backend;
+    std::vector<uint32_t> before;  // Acknowledged by the backend before the cut
+    std::vector<uint32_t> stored;  // append() returned true
+
+    {
+      Journal journal(storage);
+      journal.begin();
+      for (uint32_t sequence = 0; sequence < appends && storage.on(); sequence++) {
+        if (journal.append(reading(sequence), 1)) {
+          stored.push_back(sequence);
+        }
+        if (sequence % 5 == 4) {
+          replayBatch(journal, backend, before);
+        }
+      }
+    }
+    if (storage.on()) {
+      break;  // The whole run fit under the budget, every cut point was tried
+    }
+    cuts++;
+
+    // Power back: recover from what reached the files and replay everything
+    storage.cutAfter(-1);
+    Journal rebooted(storage);
+    TEST_ASSERT_TRUE(rebooted.begin());
+    TEST_ASSERT_TRUE(rebooted.append(reading(appends), 2));
+    std::vector<uint32_t> after;
+    drain(rebooted, backend, after);
+
+    assertIncreasing(before);
+    assertIncreasing(after);  // A lost meta write repeats readings, never reorders them
+    TEST_ASSERT_EQUAL_UINT32(appends, after.back());
+    for (uint32_t sequence : stored) {
+      bool delivered = false;
+      for (uint32_t seen : before) {
+        delivered |= seen == sequence;
+      }
+      for (uint32_t seen : after) {
+        delivered |= seen == sequence;
+      }
+      if (!delivered) {
+        char message[80];
+        snprintf(message, sizeof(message), "reading %u lost after a cut at byte %ld", sequence, cut);
+        TEST_FAIL_MESSAGE(message);
+      }
+    }
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(100, cuts);
+  char message[48];
+  snprintf(message, sizeof(message), "%u power cuts recovered", cuts);
+  TEST_MESSAGE(message);
+}
+
+void test_torn_record_is_skipped(void) {
+  FileStorage storage(directory);
+  {
+    Journal journal(storage);
+    journal.begin();
+    for (uint32_t sequence = 0; sequence < 5; sequence++) {
+      journal.append(reading(sequence), 1);
+    }
+  }
+
+  // Flip a byte in the middle of the third record of the first segment, after its 12 byte header
+  std::string path = std::string(directory) + "/journal0.bin";
+  struct stat st;
+  TEST_ASSERT_EQUAL_INT(0, stat(path.c_str(), &st));
+  long record = (st.st_size - 12) / 5;
+  FILE* file = fopen(path.c_str(), "r+b");
+  TEST_ASSERT_NOT_NULL(file);
+  fseek(file, 12 + 2 * record + record / 2, SEEK_SET);
+  fputc(0x55, file);
+  fclose(file);
+
+  Journal journal(storage);
+  journal.begin();
+  DroppingBackend backend;
+  std::vector<uint32_t> received;
+  drain(journal, backend, received);
+  TEST_ASSERT_EQUAL_UINT32(4, received.size());
+  TEST_ASSERT_EQUAL_UINT32(3, received[2]);
+  TEST_ASSERT_EQUAL_UINT32(1, journal.stats().corrupt);
+}
+
+void test_full_journal_drops_oldest_and_spreads_wear(void) {
+  FileStorage storage(directory);
+  Journal journal(storage);
+  journal.begin();
+  const uint32_t capacity = JOURNAL_SEGMENTS * JOURNAL_RECORDS_PER_SEGMENT;
+  for (uint32_t sequence = 0; sequence < capacity * 3; sequence++) {
+    TEST_ASSERT_TRUE(journal.append(reading(sequence), 1));
+  }
+
+  JournalStats stats = journal.stats();
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(capacity, stats.pending);
+  TEST_ASSERT_EQUAL_UINT32(capacity * 3, stats.pending + stats.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, stats.maxWear - stats.minWear);
+
+  // The newest readings survived
+  DroppingBackend backend;
+  std::vector<uint32_t> received;
+  drain(journal, backend, received);
+  assertIncreasing(received);
+  TEST_ASSERT_EQUAL_UINT32(capacity * 3 - 1, received.back());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_keeps_order_with_dropping_backend);
+  RUN_TEST(test_batches_split_at_boot_sessions);
+  RUN_TEST(test_power_cut_loses_nothing);
+  RUN_TEST(test_torn_record_is_skipped);
+  RUN_TEST(test_full_journal_drops_oldest_and_spreads_wear);
+  return UNITY_END();
+}
@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <math.h>
+#include <stdint.h>
+#include <string>
+#include "lan_api.h"
+
+/*
+ * LanApi against a socket stand-in: the request comes from a string, the
+ * response is collected in another, and the client can stop taking bytes
+ * after a given count. 500 readings at 5 s go in, the ring keeps the last
+ * LAN_HISTORY_READINGS of them.
+ */
+
+#define READINGS 500
+#define FIRST_HELD (READINGS - LAN_HISTORY_READINGS + 1)
+#define NOW_MS 4000000
+#define EPOCH_START_MS 1760000000000ULL
+
+class StringSocket : public LanSocket {
+ public:
+  explicit StringSocket(const std::string& request) : writes(0), request(request), position(0), limit(SIZE_MAX) {}
+
+  /* The client stops reading after this many response bytes */
+  void stopAfter(size_t bytes) { limit = bytes; }
+
+  int read() override {
+    return position < request.size() ? (uint8_t)request[position++] : -1;
+  }
+
+  size_t write(const uint8_t* data, size_t length) override {
+    writes++;
+    size_t taken = response.size() + length > limit ? limit - response.size() : length;
+    response.append((const char*)data, taken);
+    return taken;
+  }
+
+  std::string body() const {
+    size_t end = response.find("\r\n\r\n");
+    return end == std::string::npos ? std::string() : response.substr(end + 4);
+  }
+
+  bool hasStatus(const char* statusLine) const { return response.rfind(statusLine, 0) == 0; }
+
+  std::string response;
+  int writes;
+
+ private:
+  std::string request;
+  size_t position;
+  size_t limit;
+};
+
+static LanApi api;
+static const uint32_t WINDOWS_MS[] = { 60000, 900000 };
+
+/* Synced once the device has run 100 s */
+static uint64_t epochAt(uint64_t monotonicMs) {
+  return monotonicMs >= 100000 ? EPOCH_START_MS + monotonicMs : 0;
+}
+
+static StringSocket get(const char* target, const char* headers = "") {
+  StringSocket socket(std::string("GET ") + target + " HTTP/1.1\r\nHost: esp\r\n" + headers + "\r\n");
+  api.handle(socket, NOW_MS);
+  return socket;
+}
+
+static StringSocket send(const std::string& request) {
+  StringSocket socket(request);
+  api.handle(socket, NOW_MS);
+  return socket;
+}
+
+void setUp(void) {
+  api = LanApi();
+  api.configure("ESP32_\"001", WINDOWS_MS, 2, epochAt);
+  for (uint32_t i = 1; i <= READINGS; i++) {
+    Reading reading = {};
+    reading.sequence = i;
+    reading.capturedAtMs = i * 5000;
+    reading.status = 1 + (i / 100) % 3;
+    reading.temperature = 4 + 0.1f * (i % 7);
+    reading.humidity = 90;
+    reading.co2 = 450 + i;
+    reading.ammonia = 12;
+    reading.methane = 8;
+    reading.ethylene = 3;
+    reading.h2s = i == 250 ? NAN : 1.5f;
+    api.add(reading);
+  }
+}
+
+void tearDown(void) {}
+
+static void test_readings_are_served_oldest_first() {
+  TEST_ASSERT_EQUAL(LAN_HISTORY_READINGS, api.readingCount());
+
+  StringSocket socket = get("/api/readings");
+  TEST_ASSERT_TRUE(socket.hasStatus("HTTP/1.1 200 OK\r\nContent-Type: application/json"));
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, socket.body()) == DeserializationError::Ok);
+  JsonArray readings = doc["readings"];
+  TEST_ASSERT_EQUAL_STRING("ESP32_\"001", doc["deviceId"]);
+  TEST_ASSERT_EQUAL(LAN_HISTORY_READINGS, readings.size());
+  TEST_ASSERT_EQUAL_UINT32(FIRST_HELD, readings[0]["seq"]);
+  TEST_ASSERT_EQUAL_UINT32(READINGS, readings[LAN_HISTORY_READINGS - 1]["seq"]);
+  TEST_ASSERT_TRUE(readings[0]["ts"] == EPOCH_START_MS + FIRST_HELD * 5000ULL);
+  TEST_ASSERT_EQUAL_STRING("warning", readings[0]["status"]);
+  TEST_ASSERT_TRUE(readings[250 - FIRST_HELD]["H2S"].isNull());  // A NaN is left out, not sent as invalid JSON
+
+  // Streamed through the write buffer, not written byte by byte or held in full
+  TEST_ASSERT_LESS_OR_EQUAL(socket.response.size() / LAN_WRITE_BUFFER + 2, socket.writes);
+}
+
+static void test_since_and_limit_page_through() {
+  JsonDocument doc;
+  deserializeJson(doc, get("/api/readings?since=490&limit=5").body());
+  TEST_ASSERT_EQUAL(5, doc["readings"].size());
+  TEST_ASSERT_EQUAL_UINT32(491, doc["readings"][0]["seq"]);
+  TEST_ASSERT_EQUAL_UINT32(495, doc["readings"][4]["seq"]);
+
+  deserializeJson(doc, get("/api/readings?since=500").body());
+  TEST_ASSERT_EQUAL(0, doc["readings"].size());
+}
+
+static void test_msgpack_matches_json() {
+  StringSocket json = get("/api/readings?since=300");
+  StringSocket query = get("/api/readings?since=300&format=msgpack");
+  StringSocket accept = get("/api/readings?since=300", "accept: application/json, application/msgpack\r\n");
+  TEST_ASSERT_TRUE(query.response.find("Content-Type: application/msgpack") != std::string::npos);
+  TEST_ASSERT_TRUE(query.body() == accept.body());
+  TEST_ASSERT_LESS_THAN(json.body().size(), query.body().size());
+
+  JsonDocument fromJson;
+  JsonDocument fromMsgPack;
+  TEST_ASSERT_TRUE(deserializeJson(fromJson, json.body()) == DeserializationError::Ok);
+  TEST_ASSERT_TRUE(deserializeMsgPack(fromMsgPack, query.body()) == DeserializationError::Ok);
+  std::string a;
+  std::string b;
+  serializeJson(fromJson, a);
+  serializeJson(fromMsgPack, b);
+  TEST_ASSERT_EQUAL_STRING(a.c_str(), b.c_str());
+}
+
+static void test_aggregates_and_status() {
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, get("/api/aggregates").body()) == DeserializationError::Ok);
+  TEST_ASSERT_GREATER_THAN(0, api.aggregateCount());
+  TEST_ASSERT_EQUAL(api.aggregateCount(), doc["aggregates"].size());
+
+  TEST_ASSERT_TRUE(deserializeMsgPack(doc, get("/api/aggregates?limit=2&format=msgpack").body()) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL(2, doc["aggregates"].size());
+
+  deserializeJson(doc, get("/api/status").body());
+  TEST_ASSERT_EQUAL_UINT32(READINGS, doc["lastSeq"]);
+  TEST_ASSERT_EQUAL_UINT32(FIRST_HELD, doc["firstSeq"]);
+  TEST_ASSERT_EQUAL_STRING("critical", doc["status"]);
+  TEST_ASSERT_EQUAL(LAN_HISTORY_READINGS, doc["readings"]);
+}
+
+static void test_bad_requests_are_refused() {
+  TEST_ASSERT_TRUE(get("/nope").hasStatus("HTTP/1.1 404"));
+  TEST_ASSERT_TRUE(send("POST /api/readings HTTP/1.1\r\n\r\n").hasStatus("HTTP/1.1 405"));
+  TEST_ASSERT_TRUE(send("GET /api/readings HTTP/1.1\r\nHost: x\r\n").hasStatus("HTTP/1.1 400"));  // Head never ends
+  TEST_ASSERT_TRUE(send("garbage\r\n\r\n").hasStatus("HTTP/1.1 400"));
+  TEST_ASSERT_TRUE(send("GET /" + std::string(1000, 'a') + " HTTP/1.1\r\n\r\n").hasStatus("HTTP/1.1 400"));
+
+  std::string headers = "GET /api/status HTTP/1.1\r\n";
+  for (int i = 0; i < LAN_HEADER_LINES_MAX + 8; i++) {
+    headers += "X: y\r\n";
+  }
+  TEST_ASSERT_TRUE(send(headers + "\r\n").hasStatus("HTTP/1.1 400"));
+
+  // Errors use the backend's {success, message} shape
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, get("/nope").body()) == DeserializationError::Ok);
+  TEST_ASSERT_FALSE(doc["success"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(7, api.stats().rejected);
+}
+
+static void test_client_that_stops_reading_is_cut_off() {
+  StringSocket socket("GET /api/readings HTTP/1.1\r\n\r\n");
+  socket.stopAfter(1000);
+  api.handle(socket, NOW_MS);
+
+  TEST_ASSERT_EQUAL(1000, socket.response.size());
+  TEST_ASSERT_EQUAL_UINT32(1, api.stats().aborted);
+  TEST_ASSERT_LESS_OR_EQUAL(3, socket.writes);  // Nothing more is tried after the short write
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_readings_are_served_oldest_first);
+  RUN_TEST(test_since_and_limit_page_through);
+  RUN_TEST(test_msgpack_matches_json);
+  RUN_TEST(test_aggregates_and_status);
+  RUN_TEST(test_bad_requests_are_refused);
+  RUN_TEST(test_client_that_stops_reading_is_cut_off);
+  return UNITY_END();
+}
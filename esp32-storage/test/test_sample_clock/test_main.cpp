@@ -0,0 +1,141 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <random>
+#include "sample_clock.h"
+
+/*
+ * SampleScheduler and EpochClock on a VirtualClock: 24 h of 5 s ticks
+ * with 20-400 ms of sensor reads and the odd long stall, and a local
+ * oscillator running 40 ppm slow against SNTP synced hourly with 10 ms of
+ * jitter.
+ */
+
+#define PERIOD_US 5000000ULL
+#define DAY_US 86400000000ULL
+#define STALL_EVERY 1000
+#define STALL_US 12000000ULL
+#define SLOW_PPM 40.0
+#define SYNC_JITTER_MS 10
+#define EPOCH_START_MS 1760000000000ULL
+
+static std::mt19937 noise(3);
+
+void setUp(void) {
+  noise.seed(3);
+}
+
+void tearDown(void) {}
+
+static void test_ticks_stay_on_the_grid() {
+  std::uniform_int_distribution<uint64_t> readUs(20000, 400000);
+  VirtualClock clock(PERIOD_US * 1000);
+  SampleScheduler scheduler(clock, PERIOD_US);
+
+  uint64_t first = scheduler.waitNext();
+  uint64_t previous = first;
+  uint32_t lateTicks = 0;
+  uint32_t stalls = 0;
+  while (previous - first < DAY_US) {
+    clock.advance(readUs(noise));
+    if (scheduler.stats().ticks % STALL_EVERY == 0) {
+      clock.advance(STALL_US);
+      stalls++;
+    }
+    uint64_t tick = scheduler.waitNext();
+
+    // On the grid of the first tick, and never two ticks for one period
+    TEST_ASSERT_TRUE((tick - first) % PERIOD_US == 0);
+    TEST_ASSERT_TRUE(tick >= previous + PERIOD_US);
+    lateTicks += scheduler.stats().lastLateUs > 0;
+    previous = tick;
+  }
+
+  // Each stall costs one tick, served late once; everything else is on time
+  TEST_ASSERT_EQUAL_UINT32(17, stalls);
+  TEST_ASSERT_EQUAL_UINT32(stalls, scheduler.stats().missed);
+  TEST_ASSERT_EQUAL_UINT32(stalls, lateTicks);
+  TEST_ASSERT_LESS_THAN_UINT32(PERIOD_US, scheduler.stats().maxLateUs);
+  TEST_ASSERT_EQUAL_UINT32(DAY_US / PERIOD_US + 1, scheduler.stats().ticks + scheduler.stats().missed);
+}
+
+static void test_long_stall_does_not_burst() {
+  VirtualClock clock;
+  SampleScheduler scheduler(clock, PERIOD_US);
+  TEST_ASSERT_TRUE(scheduler.waitNext() == 0);
+
+  // A minute lost: the next tick is the latest grid point, then the grid carries on
+  clock.advance(60 * 1000000ULL + 1234);
+  TEST_ASSERT_TRUE(scheduler.waitNext() == 60 * 1000000ULL);
+  TEST_ASSERT_EQUAL_UINT32(11, scheduler.stats().missed);
+  TEST_ASSERT_EQUAL_UINT32(1234, scheduler.stats().lastLateUs);
+
+  TEST_ASSERT_TRUE(scheduler.waitNext() == 65 * 1000000ULL);
+  TEST_ASSERT_TRUE(clock.nowUs() == 65 * 1000000ULL);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats().lastLateUs);
+  TEST_ASSERT_EQUAL_UINT32(3, scheduler.stats().ticks);
+}
+
+static void test_period_change_counts_from_the_last_tick() {
+  VirtualClock clock;
+  SampleScheduler scheduler(clock, PERIOD_US);
+  scheduler.waitNext();
+  scheduler.waitNext();
+  scheduler.setPeriodUs(60 * 1000000);
+  TEST_ASSERT_TRUE(scheduler.waitNext() == 65 * 1000000ULL);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats().missed);
+}
+
+/* Monotonic ms of a local clock running SLOW_PPM slow, at a true elapsed time */
+static uint64_t slowMonotonicMs(uint64_t trueMs) {
+  return (uint64_t)(trueMs * (1.0 - SLOW_PPM * 1e-6));
+}
+
+static void test_drift_estimate_converges() {
+  std::uniform_int_distribution<int> jitter(-SYNC_JITTER_MS, SYNC_JITTER_MS);
+  EpochClock epoch = {};
+  TEST_ASSERT_FALSE(epoch.synced());
+  TEST_ASSERT_TRUE(epoch.toEpochMs(1000) == 0);
+
+  int64_t worst = 0;
+  int64_t worstUnmodelled = 0;  // Re-anchored on every sync, but no rate model
+  for (uint64_t hour = 0; hour < 48; hour++) {
+    uint64_t syncMs = hour * 3600000;
+    uint64_t syncEpochMs = EPOCH_START_MS + syncMs + jitter(noise);
+    epoch.sync(syncEpochMs, slowMonotonicMs(syncMs));
+    if (hour < 6) {
+      continue;  // Rate still being learned
+    }
+    // Readings every 5 minutes until the next sync
+    for (uint64_t trueMs = syncMs; trueMs < syncMs + 3600000; trueMs += 300000) {
+      uint64_t monotonicMs = slowMonotonicMs(trueMs);
+      int64_t error = (int64_t)(epoch.toEpochMs(monotonicMs) - (EPOCH_START_MS + trueMs));
+      int64_t unmodelled = (int64_t)(syncEpochMs + (monotonicMs - slowMonotonicMs(syncMs)) - (EPOCH_START_MS + trueMs));
+      worst = llabs(error) > worst ? llabs(error) : worst;
+      worstUnmodelled = llabs(unmodelled) > worstUnmodelled ? llabs(unmodelled) : worstUnmodelled;
+    }
+  }
+
+  TEST_ASSERT_FLOAT_WITHIN(2.0f, (float)SLOW_PPM, epoch.driftPpm());
+  TEST_ASSERT_EQUAL_UINT32(48, epoch.syncCount());
+  TEST_ASSERT_GREATER_THAN(120, worstUnmodelled);  // ~40 ppm of an hour
+  TEST_ASSERT_LESS_THAN(4 * SYNC_JITTER_MS, worst);
+}
+
+static void test_clock_steps_are_not_drift() {
+  EpochClock epoch = {};
+  epoch.sync(EPOCH_START_MS, 0);
+  epoch.sync(EPOCH_START_MS + 3600000 + 5000, 3600000);  // The server stepped 5 s
+  TEST_ASSERT_EQUAL(5000, epoch.lastCorrectionMs());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, epoch.driftPpm());
+  TEST_ASSERT_TRUE(epoch.toEpochMs(3600000 + 1000) == EPOCH_START_MS + 3600000 + 5000 + 1000);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ticks_stay_on_the_grid);
+  RUN_TEST(test_long_stall_does_not_burst);
+  RUN_TEST(test_period_change_counts_from_the_last_tick);
+  RUN_TEST(test_drift_estimate_converges);
+  RUN_TEST(test_clock_steps_are_not_drift);
+  return UNITY_END();
+}
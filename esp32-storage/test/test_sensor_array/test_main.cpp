@@ -0,0 +1,171 @@
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "sensor_array.h"
+
+/*
+ * SensorArray with simulated probes on a virtual clock: four DHT11 that
+ * take 23 ms per read and four MQ135 that take none, driven for an hour
+ * by the probe task's loop (poll, sleep dueInMs, wake a tick late).
+ */
+
+#define DHT_READ_MS 23
+#define TICK_MS 1
+#define RUN_MS 3600000
+#define MAX_LATE_MS 2  // A wake is one tick late, one more when two probes are due together
+
+struct ReadEvent {
+  uint32_t startMs;
+  uint32_t endMs;
+  bool slow;
+};
+
+static uint32_t clockMs;
+static std::vector<ReadEvent> events;
+
+class SimulatedProbe : public Probe {
+ public:
+  SimulatedProbe(bool slow, float value) : slow(slow), value(value), failEvery(0), reads(0) {}
+
+  bool read(float* values) override {
+    uint32_t startMs = clockMs;
+    clockMs += slow ? DHT_READ_MS : 0;
+    events.push_back({ startMs, clockMs, slow });
+    reads++;
+    if (failEvery != 0 && reads % failEvery == 0) {
+      return false;
+    }
+    values[0] = value;
+    values[1] = value + 40;
+    return true;
+  }
+
+  bool slow;
+  float value;
+  uint32_t failEvery;
+  uint32_t reads;
+};
+
+static const ProbeSpec ROOM[] = {
+  { "dht-1", PROBE_CLIMATE, 2000 }, { "dht-2", PROBE_CLIMATE, 2000 },
+  { "dht-3", PROBE_CLIMATE, 3000 }, { "dht-4", PROBE_CLIMATE, 5000 },
+  { "mq-1", PROBE_GAS, 250 }, { "mq-2", PROBE_GAS, 250 },
+  { "mq-3", PROBE_GAS, 500 }, { "mq-4", PROBE_GAS, 1000 },
+};
+#define ROOM_PROBES (sizeof(ROOM) / sizeof(ROOM[0]))
+
+static std::vector<SimulatedProbe> probes;
+
+static void addRoom(SensorArray& array) {
+  probes.clear();
+  probes.reserve(ROOM_PROBES);
+  for (size_t i = 0; i < ROOM_PROBES; i++) {
+    probes.emplace_back(ROOM[i].kind == PROBE_CLIMATE, 20.0f + i);
+    TEST_ASSERT_TRUE(array.add(probes.back(), ROOM[i]));
+  }
+}
+
+static void run(SensorArray& array, uint32_t forMs) {
+  uint32_t endMs = clockMs + forMs;
+  while ((int32_t)(clockMs - endMs) < 0) {
+    array.poll(clockMs);
+    clockMs += array.dueInMs(clockMs) + TICK_MS;
+  }
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  return b == 0 ? a : gcd(b, a % b);
+}
+
+void setUp(void) {
+  clockMs = 1000;
+  events.clear();
+}
+
+void tearDown(void) {}
+
+static void test_dht_reads_never_share_a_slot() {
+  SensorArray array;
+  addRoom(array);
+  TEST_ASSERT_EQUAL_UINT32(0, array.collisions());
+
+  // Phases differ modulo the gcd of the periods for every pair of DHTs, so their slots never meet
+  for (size_t i = 0; i < ROOM_PROBES; i++) {
+    for (size_t j = i + 1; j < ROOM_PROBES; j++) {
+      if (ROOM[i].kind == PROBE_CLIMATE && ROOM[j].kind == PROBE_CLIMATE) {
+        uint32_t common = gcd(ROOM[i].periodMs, ROOM[j].periodMs);
+        TEST_ASSERT_TRUE(array.phaseMs(i) % common != array.phaseMs(j) % common);
+      }
+    }
+  }
+
+  // And when run: every DHT read starts at least a slot after the previous one started
+  run(array, RUN_MS);
+  uint32_t dhtReads = 0;
+  uint32_t lastStartMs = 0;
+  for (const ReadEvent& event : events) {
+    if (!event.slow) {
+      continue;
+    }
+    if (dhtReads > 0) {
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(SENSOR_SLOT_MS, event.startMs - lastStartMs);
+    }
+    lastStartMs = event.startMs;
+    dhtReads++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(RUN_MS / 2000 * 2 + RUN_MS / 3000 + RUN_MS / 5000, dhtReads);
+  TEST_ASSERT_EQUAL_UINT32(45120, events.size());
+}
+
+static void test_reads_stay_within_the_late_bound() {
+  SensorArray array;
+  addRoom(array);
+  run(array, RUN_MS);
+  for (size_t i = 0; i < array.count(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_LATE_MS, array.stats(i).maxLateMs);
+    TEST_ASSERT_EQUAL_UINT32(0, array.stats(i).skipped);
+    TEST_ASSERT_EQUAL_UINT32(RUN_MS / array.frame().periodMs[i], array.stats(i).reads);
+  }
+}
+
+static void test_too_many_dhts_are_reported() {
+  SensorArray array;
+  std::vector<SimulatedProbe> dhts(SENSOR_MAX_PROBES + 1, SimulatedProbe(true, 20.0f));
+  for (size_t i = 0; i < SENSOR_MAX_PROBES; i++) {
+    TEST_ASSERT_TRUE(array.add(dhts[i], { "dht", PROBE_CLIMATE, 100 }));  // Two slots for eight probes
+  }
+  TEST_ASSERT_FALSE(array.add(dhts[SENSOR_MAX_PROBES], { "dht", PROBE_CLIMATE, 100 }));
+  TEST_ASSERT_EQUAL_UINT32(12, array.collisions());  // Two groups of four: 2 * (0 + 1 + 2 + 3)
+}
+
+static void test_frame_combines_fresh_probes() {
+  SensorArray array;
+  addRoom(array);
+  probes[1].failEvery = 1;  // dht-2 never answers
+  array.readAll(clockMs);
+
+  RoomValues room;
+  TEST_ASSERT_TRUE(combineFrame(array.frame(), clockMs, room));
+  TEST_ASSERT_EQUAL(3, room.climateProbes);
+  TEST_ASSERT_EQUAL(4, room.gasProbes);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, (20 + 22 + 23) / 3.0f, room.temperature);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, (60 + 62 + 63) / 3.0f, room.humidity);
+  TEST_ASSERT_EQUAL_FLOAT(27.0f, room.gasCode);  // The worst gas probe
+  TEST_ASSERT_TRUE(isnan(array.frame().temperature[1]));
+
+  // Three periods later the 2 s DHTs and every MQ135 are stale, dht-4 (5 s) is left
+  uint32_t laterMs = clockMs + 3 * 3000 + 1;
+  TEST_ASSERT_FALSE(combineFrame(array.frame(), laterMs, room));
+  TEST_ASSERT_EQUAL(1, room.climateProbes);
+  TEST_ASSERT_EQUAL(0, room.gasProbes);
+  TEST_ASSERT_EQUAL_FLOAT(23.0f, room.temperature);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_dht_reads_never_share_a_slot);
+  RUN_TEST(test_reads_stay_within_the_late_bound);
+  RUN_TEST(test_too_many_dhts_are_reported);
+  RUN_TEST(test_frame_combines_fresh_probes);
+  return UNITY_END();
+}
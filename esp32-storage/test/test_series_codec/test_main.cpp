@@ -0,0 +1,184 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "series_codec.h"
+
+/*
+ * Series batches encoded and decoded again: lossless by default, within
+ * the rounding bound with fewer mantissa bits, and damaged batches must
+ * decode without reading out of bounds (run under ASan to see it).
+ */
+
+#define BATCH 24
+#define CAPACITY 4096
+#define GAS_MANTISSA_BITS 16
+#define GAS_MAX_RELATIVE_ERROR 7.7e-6  // 2^-(bits + 1), round to nearest
+#define FUZZ_TRIALS 20000
+
+static uint8_t buffer[CAPACITY];
+static std::mt19937 noise(5);
+
+/* A room sampled every 5 s with a few ms of jitter, gases noisy, one heartbeat row */
+static std::vector<SeriesRow> makeRows(size_t count) {
+  std::normal_distribution<double> gauss(0.0, 1.0);
+  std::uniform_int_distribution<int> jitter(-3, 3);
+  std::vector<SeriesRow> rows;
+  for (size_t i = 0; i < count; i++) {
+    SeriesRow row = {};
+    row.timeMs = 1760000000000LL + i * 5000 + jitter(noise);
+    row.sequence = 1000 + i;
+    row.status = 1;
+    row.values[0] = roundf(24.0f + (i / 10) % 2);
+    row.values[1] = 60.0f;
+    row.values[2] = 420.0 * (1.0 + 0.01 * gauss(noise));
+    row.values[3] = 5.0 * (1.0 + 0.015 * gauss(noise));
+    row.values[4] = 3.0 * (1.0 + 0.01 * gauss(noise));
+    row.values[5] = 2.0 * (1.0 + 0.015 * gauss(noise));
+    row.values[6] = 0.5 * (1.0 + 0.01 * gauss(noise));
+    if (i == count / 2) {
+      row.flags = SERIES_STATUS_ONLY;
+      row.suppressed = 7;
+    }
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+static size_t encode(const std::vector<SeriesRow>& rows, SeriesTimeMode mode, uint8_t gasBits) {
+  SeriesEncoder encoder;
+  TEST_ASSERT_TRUE(encoder.begin(buffer, CAPACITY, mode, "507f1f77bcf86cd799439011", "ESP32_001"));
+  for (uint8_t channel = 2; channel < SERIES_CHANNELS; channel++) {
+    encoder.setPrecision(channel, gasBits);
+  }
+  for (const SeriesRow& row : rows) {
+    TEST_ASSERT_TRUE(encoder.add(row));
+  }
+  return encoder.finish();
+}
+
+void setUp(void) {
+  noise.seed(5);
+}
+
+void tearDown(void) {}
+
+static void test_round_trip_is_lossless() {
+  std::vector<SeriesRow> rows = makeRows(BATCH);
+  rows[3].values[4] = NAN;      // A failed read
+  rows[7].timeMs += 3600000;    // A large jump in time
+  rows[8].sequence += 100000;
+
+  for (SeriesTimeMode mode : { SERIES_TIME_NONE, SERIES_TIME_EPOCH, SERIES_TIME_AGE }) {
+    size_t length = encode(rows, mode, 23);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, length);
+
+    SeriesDecoder decoder;
+    TEST_ASSERT_TRUE(decoder.begin(buffer, length));
+    TEST_ASSERT_EQUAL(mode, decoder.timeMode());
+    TEST_ASSERT_EQUAL(BATCH, decoder.count());
+    TEST_ASSERT_EQUAL_STRING("507f1f77bcf86cd799439011", decoder.farmerId());
+    TEST_ASSERT_EQUAL_STRING("ESP32_001", decoder.deviceId());
+
+    SeriesRow row;
+    for (const SeriesRow& expected : rows) {
+      TEST_ASSERT_TRUE(decoder.next(row));
+      if (mode != SERIES_TIME_NONE) {
+        TEST_ASSERT_TRUE(row.timeMs == expected.timeMs);
+      }
+      TEST_ASSERT_EQUAL_UINT32(expected.sequence, row.sequence);
+      TEST_ASSERT_EQUAL_UINT32(expected.suppressed, row.suppressed);
+      TEST_ASSERT_EQUAL(expected.status, row.status);
+      TEST_ASSERT_EQUAL(expected.flags, row.flags);
+      if (expected.flags & SERIES_STATUS_ONLY) {
+        continue;  // Heartbeats carry no values
+      }
+      TEST_ASSERT_EQUAL(0, memcmp(expected.values, row.values, sizeof(row.values)));
+    }
+    TEST_ASSERT_FALSE(decoder.next(row));
+  }
+}
+
+static void test_fewer_gas_bits_stay_within_rounding() {
+  std::vector<SeriesRow> rows = makeRows(BATCH);
+  size_t lossless = encode(rows, SERIES_TIME_EPOCH, 23);
+  size_t length = encode(rows, SERIES_TIME_EPOCH, GAS_MANTISSA_BITS);
+  TEST_ASSERT_LESS_THAN(lossless, length);
+
+  SeriesDecoder decoder;
+  TEST_ASSERT_TRUE(decoder.begin(buffer, length));
+  SeriesRow row;
+  for (const SeriesRow& expected : rows) {
+    TEST_ASSERT_TRUE(decoder.next(row));
+    if (expected.flags & SERIES_STATUS_ONLY) {
+      continue;
+    }
+    // Temperature and humidity stay lossless
+    TEST_ASSERT_EQUAL(0, memcmp(expected.values, row.values, 2 * sizeof(float)));
+    for (int channel = 2; channel < SERIES_CHANNELS; channel++) {
+      double error = fabs(row.values[channel] - expected.values[channel]) / expected.values[channel];
+      TEST_ASSERT_TRUE(error <= GAS_MAX_RELATIVE_ERROR);
+    }
+  }
+}
+
+static void test_steady_room_is_compact() {
+  // On the sampling grid with a steady DHT11, most rows are a few bytes
+  std::vector<SeriesRow> rows = makeRows(BATCH);
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i].timeMs = 1760000000000LL + i * 5000;
+  }
+  size_t length = encode(rows, SERIES_TIME_EPOCH, GAS_MANTISSA_BITS);
+  TEST_ASSERT_LESS_THAN(BATCH * 20, length);
+}
+
+static void test_full_buffer_is_reported() {
+  std::vector<SeriesRow> rows = makeRows(BATCH);
+  SeriesEncoder encoder;
+  encoder.begin(buffer, 64, SERIES_TIME_EPOCH, "507f1f77bcf86cd799439011", "ESP32_001");
+  bool fits = true;
+  for (const SeriesRow& row : rows) {
+    fits = encoder.add(row) && fits;
+  }
+  TEST_ASSERT_FALSE(fits);
+  TEST_ASSERT_EQUAL(0, encoder.finish());
+}
+
+static void test_damaged_batches_decode_safely() {
+  std::vector<SeriesRow> rows = makeRows(BATCH);
+  size_t length = encode(rows, SERIES_TIME_EPOCH, 23);
+  std::vector<uint8_t> original(buffer, buffer + length);
+
+  // Truncated and bit-flipped copies on the heap, so ASan catches any read past the end
+  uint32_t decodedRows = 0;
+  for (int trial = 0; trial < FUZZ_TRIALS; trial++) {
+    std::vector<uint8_t> damaged(original.begin(), original.begin() + noise() % (length + 1));
+    for (int flip = 0; flip < 3 && !damaged.empty(); flip++) {
+      damaged[noise() % damaged.size()] ^= 1 << (noise() % 8);
+    }
+
+    SeriesDecoder decoder;
+    if (!decoder.begin(damaged.data(), damaged.size())) {
+      continue;
+    }
+    SeriesRow row;
+    uint32_t count = 0;
+    while (decoder.next(row)) {
+      count++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(decoder.count(), count);
+    decodedRows += count;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(0, decodedRows);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_is_lossless);
+  RUN_TEST(test_fewer_gas_bits_stay_within_rounding);
+  RUN_TEST(test_steady_room_is_compact);
+  RUN_TEST(test_full_buffer_is_reported);
+  RUN_TEST(test_damaged_batches_decode_safely);
+  return UNITY_END();
+}
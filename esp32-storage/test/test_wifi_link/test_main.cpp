@@ -0,0 +1,227 @@
+#include <unity.h>
+#include <string.h>
+#include "wifi_link.h"
+
+/*
+ * WifiLink against a fake radio: a full join (scan + DHCP) takes 2.8 s, a
+ * join straight to the cached access point 300 ms and only works while
+ * the cache still matches it. The cache store counts its writes, which
+ * are NVS writes on the device.
+ */
+
+#define FULL_JOIN_MS 2800
+#define CACHED_JOIN_MS 300
+#define POLL_MS 1
+#define ROOM_IP 0x3201A8C0  // 192.168.1.50
+
+class FakeRadio : public WifiRadio {
+ public:
+  void join(const WifiCache* cache) override {
+    joining = true;
+    cached = cache != nullptr;
+    if (cache) {
+      cacheMatches = memcmp(cache->bssid, bssid, sizeof(bssid)) == 0 && cache->channel == channel;
+    }
+    joinStartedMs = nowMs;
+  }
+
+  bool connected() override {
+    if (!apUp) {
+      joining = false;
+      linked = false;
+    }
+    if (joining && (!cached || cacheMatches) && nowMs - joinStartedMs >= (cached ? cachedJoinMs : fullJoinMs)) {
+      joining = false;
+      linked = true;
+    }
+    return linked;
+  }
+
+  bool current(WifiCache& cache) override {
+    if (!linked) {
+      return false;
+    }
+    memcpy(cache.bssid, bssid, sizeof(bssid));
+    cache.channel = channel;
+    cache.ip = ROOM_IP;
+    cache.gateway = 0x0101A8C0;
+    cache.subnet = 0x00FFFFFF;
+    cache.dns = 0x0101A8C0;
+    return true;
+  }
+
+  void cancel() override { joining = false; }
+
+  void drop() { linked = false; }
+
+  uint32_t nowMs = 0;
+  uint32_t fullJoinMs = FULL_JOIN_MS;
+  uint32_t cachedJoinMs = CACHED_JOIN_MS;
+  bool apUp = true;
+  uint8_t bssid[6] = { 0x24, 0x0a, 0xc4, 0x11, 0x22, 0x33 };
+  int32_t channel = 6;
+
+ private:
+  bool joining = false;
+  bool cached = false;
+  bool cacheMatches = false;
+  bool linked = false;
+  uint32_t joinStartedMs = 0;
+};
+
+class CountingStore : public WifiCacheStore {
+ public:
+  bool load(WifiCache& cache) override {
+    if (held) {
+      cache = stored;
+    }
+    return held;
+  }
+
+  bool save(const WifiCache& cache) override {
+    stored = cache;
+    held = true;
+    writes++;
+    return true;
+  }
+
+  WifiCache stored = {};
+  bool held = false;
+  int writes = 0;
+};
+
+static FakeRadio radio;
+static CountingStore store;
+
+/* Polls until the link is up, or for at most limitMs; returns whether it came up */
+static bool pollUntilUp(WifiLink& link, uint32_t limitMs) {
+  for (uint32_t waited = 0; waited <= limitMs; waited += POLL_MS) {
+    if (link.poll(radio.nowMs)) {
+      return true;
+    }
+    radio.nowMs += POLL_MS;
+  }
+  return false;
+}
+
+static void dropAndRejoin(WifiLink& link) {
+  radio.drop();
+  TEST_ASSERT_TRUE(pollUntilUp(link, 120000));
+}
+
+void setUp(void) {
+  radio = FakeRadio();
+  store = CountingStore();
+}
+
+void tearDown(void) {}
+
+static void test_first_boot_scans_then_rejoins_fast() {
+  WifiLink link(radio, store);
+  link.begin();
+  TEST_ASSERT_TRUE(pollUntilUp(link, WIFI_FULL_JOIN_MS));
+  TEST_ASSERT_EQUAL_UINT32(FULL_JOIN_MS, link.stats().lastJoinMs);
+  TEST_ASSERT_EQUAL_UINT32(0, link.stats().fastJoins);
+  TEST_ASSERT_EQUAL(1, store.writes);
+
+  // Dropped links come back on the cached access point, and the unchanged lease is not written again
+  for (int drop = 0; drop < 20; drop++) {
+    radio.nowMs += 60000;
+    link.poll(radio.nowMs);
+    dropAndRejoin(link);
+    TEST_ASSERT_EQUAL(WIFI_UP, link.state());
+    TEST_ASSERT_EQUAL_UINT32(CACHED_JOIN_MS, link.stats().lastJoinMs);
+  }
+  TEST_ASSERT_EQUAL_UINT32(21, link.stats().connects);
+  TEST_ASSERT_EQUAL_UINT32(20, link.stats().fastJoins);
+  TEST_ASSERT_EQUAL_UINT32(20, link.stats().drops);
+  TEST_ASSERT_EQUAL_UINT32(20, link.stats().histogram[1]);  // 250-500 ms
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().histogram[4]);   // 2-5 s
+  TEST_ASSERT_EQUAL(1, store.writes);
+}
+
+static void test_cache_survives_a_reboot() {
+  WifiLink first(radio, store);
+  first.begin();
+  TEST_ASSERT_TRUE(pollUntilUp(first, WIFI_FULL_JOIN_MS));
+
+  radio.drop();
+  WifiLink rebooted(radio, store);
+  rebooted.begin();
+  TEST_ASSERT_TRUE(pollUntilUp(rebooted, WIFI_FAST_JOIN_MS));
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.stats().fastJoins);
+  TEST_ASSERT_EQUAL(1, store.writes);
+}
+
+static void test_moved_access_point_falls_back_to_a_full_join() {
+  WifiLink link(radio, store);
+  link.begin();
+  pollUntilUp(link, WIFI_FULL_JOIN_MS);
+
+  radio.channel = 11;
+  dropAndRejoin(link);
+  // The cached join times out, then scan + DHCP, and the new channel is stored
+  TEST_ASSERT_EQUAL_UINT32(WIFI_FAST_JOIN_MS + FULL_JOIN_MS, link.stats().lastJoinMs);
+  TEST_ASSERT_EQUAL_UINT32(0, link.stats().fastJoins);
+  TEST_ASSERT_EQUAL(2, store.writes);
+  TEST_ASSERT_EQUAL(11, store.stored.channel);
+
+  dropAndRejoin(link);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().fastJoins);
+  TEST_ASSERT_EQUAL_UINT32(CACHED_JOIN_MS, link.stats().lastJoinMs);
+}
+
+static void test_outage_backs_off_and_counts_from_the_drop() {
+  WifiLink link(radio, store);
+  link.begin();
+  pollUntilUp(link, WIFI_FULL_JOIN_MS);
+
+  // 40 s without the access point: fast join, then full joins with 5 s and 10 s of backoff between them
+  uint32_t droppedMs = radio.nowMs;
+  radio.apUp = false;
+  while (radio.nowMs - droppedMs < 40000) {
+    TEST_ASSERT_FALSE(link.poll(radio.nowMs));
+    radio.nowMs += POLL_MS;
+  }
+  radio.apUp = true;
+  TEST_ASSERT_EQUAL_UINT32(2, link.stats().failedJoins);
+  TEST_ASSERT_TRUE(pollUntilUp(link, WIFI_MAX_BACKOFF_MS + WIFI_FULL_JOIN_MS));
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(40000, link.stats().lastJoinMs);
+  TEST_ASSERT_EQUAL_UINT32(radio.nowMs - droppedMs, link.stats().lastJoinMs);
+  TEST_ASSERT_EQUAL_UINT32(link.stats().lastJoinMs, link.stats().maxJoinMs);
+  TEST_ASSERT_EQUAL_UINT32(1, link.stats().histogram[WIFI_HISTOGRAM_BUCKETS - 1]);
+  TEST_ASSERT_EQUAL(1, store.writes);  // Same access point and lease as before
+}
+
+static void test_join_times_land_in_their_buckets() {
+  // Each boundary and the time just below it, on a first-boot full join; >= 10 s is the outage case
+  static const struct {
+    uint32_t joinMs;
+    int bucket;
+  } JOINS[] = {
+    { 1, 0 }, { 249, 0 }, { 250, 1 }, { 499, 1 }, { 500, 2 }, { 999, 2 },
+    { 1000, 3 }, { 1999, 3 }, { 2000, 4 }, { 4999, 4 }, { 5000, 5 }, { 9999, 5 },
+  };
+  for (const auto& join : JOINS) {
+    setUp();
+    radio.fullJoinMs = join.joinMs;
+    WifiLink link(radio, store);
+    link.begin();
+    TEST_ASSERT_TRUE(pollUntilUp(link, WIFI_FULL_JOIN_MS));
+    TEST_ASSERT_EQUAL_UINT32(join.joinMs, link.stats().lastJoinMs);
+    for (int bucket = 0; bucket < WIFI_HISTOGRAM_BUCKETS; bucket++) {
+      TEST_ASSERT_EQUAL_UINT32(bucket == join.bucket ? 1 : 0, link.stats().histogram[bucket]);
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_boot_scans_then_rejoins_fast);
+  RUN_TEST(test_cache_survives_a_reboot);
+  RUN_TEST(test_moved_access_point_falls_back_to_a_full_join);
+  RUN_TEST(test_outage_backs_off_and_counts_from_the_drop);
+  RUN_TEST(test_join_times_land_in_their_buckets);
+  return UNITY_END();
+}
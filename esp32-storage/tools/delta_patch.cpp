@@ -0,0 +1,367 @@
+/*
+ * Builds and applies firmware delta patches on the host.
+ *
+ *   g++ -O2 -std=gnu++17 -Ilib/delta_patch/src tools/delta_patch.cpp lib/delta_patch/src/delta_patch.cpp -o delta_patch
+ *
+ *   delta_patch diff  <old.bin> <new.bin> <patch.hdp>
+ *   delta_patch apply <old.bin> <patch.hdp> <new.bin>
+ *   delta_patch bench <old.bin> <patch.hdp> [rounds]
+ *
+ * old.bin is .pio/build/esp32dev/firmware.bin of the release running on
+ * the devices, new.bin the one they should get. The patch goes to
+ * backend/firmware/<old version>_<new version>.hdp. apply and bench run
+ * the same DeltaPatcher as the device, fed in TCP-segment sized chunks.
+ *
+ * diff is bsdiff 4 (Colin Percival) with its control, difference and extra
+ * streams interleaved per block instead of bzip2'd separately, so the
+ * device can apply it while it downloads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "delta_patch.h"
+
+#define CHUNK_SIZE 1460  // One TCP segment, what the device gets per read
+#define MIN_ZERO_RUN 3   // Shorter zero runs stay inside the literal run around them
+
+typedef std::vector<uint8_t> Bytes;
+
+static bool readFile(const char* path, Bytes& data) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  uint8_t chunk[65536];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    data.insert(data.end(), chunk, chunk + got);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool writeFile(const char* path, const Bytes& data) {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr || fwrite(data.data(), 1, data.size(), file) != data.size()) {
+    perror(path);
+    return false;
+  }
+  return fclose(file) == 0;
+}
+
+static void putVarint(Bytes& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+static void putLe32(Bytes& out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out.push_back((uint8_t)(value >> (8 * i)));
+  }
+}
+
+/* Suffix array by prefix doubling, fine for images of a few MB */
+static std::vector<int32_t> suffixArray(const Bytes& data) {
+  int32_t n = (int32_t)data.size();
+  std::vector<int32_t> order(n), rank(n), next(n);
+  for (int32_t i = 0; i < n; i++) {
+    order[i] = i;
+    rank[i] = data[i];
+  }
+  for (int32_t k = 1; n > 0; k <<= 1) {
+    auto key = [&](int32_t i) { return std::make_pair(rank[i], i + k < n ? rank[i + k] : -1); };
+    std::sort(order.begin(), order.end(), [&](int32_t a, int32_t b) { return key(a) < key(b); });
+    next[order[0]] = 0;
+    for (int32_t i = 1; i < n; i++) {
+      next[order[i]] = next[order[i - 1]] + (key(order[i - 1]) < key(order[i]) ? 1 : 0);
+    }
+    rank.swap(next);
+    if (rank[order[n - 1]] == n - 1) {
+      break;  // All suffixes told apart
+    }
+  }
+  return order;
+}
+
+static int32_t matchLength(const uint8_t* a, int32_t aLength, const uint8_t* b, int32_t bLength) {
+  int32_t i = 0;
+  while (i < aLength && i < bLength && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+/* Longest match of target[0..length) in old, bsdiff's search() */
+static int32_t search(const std::vector<int32_t>& suffixes, const Bytes& old, const uint8_t* target,
+                      int32_t length, int32_t low, int32_t high, int32_t& position) {
+  int32_t n = (int32_t)old.size();
+  if (high - low < 2) {
+    int32_t x = matchLength(old.data() + suffixes[low], n - suffixes[low], target, length);
+    int32_t y = high < n ? matchLength(old.data() + suffixes[high], n - suffixes[high], target, length) : -1;
+    if (x > y) {
+      position = suffixes[low];
+      return x;
+    }
+    position = suffixes[high];
+    return y;
+  }
+  int32_t middle = low + (high - low) / 2;
+  int32_t compared = std::min(n - suffixes[middle], length);
+  if (memcmp(old.data() + suffixes[middle], target, compared) < 0) {
+    return search(suffixes, old, target, length, middle, high, position);
+  }
+  return search(suffixes, old, target, length, low, middle, position);
+}
+
+/* Difference bytes as alternating zero and literal runs */
+static void putDifference(Bytes& out, const uint8_t* difference, int32_t length) {
+  int32_t i = 0;
+  while (i < length) {
+    int32_t zeros = 0;
+    while (i + zeros < length && difference[i + zeros] == 0) {
+      zeros++;
+    }
+    i += zeros;
+
+    int32_t end = i;
+    while (end < length) {
+      int32_t run = 0;
+      while (end + run < length && difference[end + run] == 0) {
+        run++;
+      }
+      if (run >= MIN_ZERO_RUN || end + run == length) {
+        break;
+      }
+      end += run + 1;
+    }
+    putVarint(out, (uint32_t)zeros);
+    putVarint(out, (uint32_t)(end - i));
+    out.insert(out.end(), difference + i, difference + end);
+    i = end;
+  }
+}
+
+static void putBlock(Bytes& out, const Bytes& old, const Bytes& target, int32_t oldStart, int32_t newStart,
+                     int32_t copy, int32_t insert, int32_t seek) {
+  putVarint(out, (uint32_t)copy);
+  putVarint(out, (uint32_t)insert);
+  putVarint(out, ((uint32_t)seek << 1) ^ (uint32_t)(seek >> 31));
+
+  std::vector<uint8_t> difference(copy);
+  for (int32_t i = 0; i < copy; i++) {
+    difference[i] = (uint8_t)(target[newStart + i] - old[oldStart + i]);
+  }
+  putDifference(out, difference.data(), copy);
+  out.insert(out.end(), target.begin() + newStart + copy, target.begin() + newStart + copy + insert);
+}
+
+static Bytes diff(const Bytes& old, const Bytes& target) {
+  Bytes out = { 'H', 'D', DELTA_VERSION, 0 };
+  putLe32(out, (uint32_t)old.size());
+  putLe32(out, deltaCrc32(0, old.data(), old.size()));
+  putLe32(out, (uint32_t)target.size());
+  putLe32(out, deltaCrc32(0, target.data(), target.size()));
+
+  int32_t oldSize = (int32_t)old.size();
+  int32_t newSize = (int32_t)target.size();
+  if (oldSize == 0) {
+    if (newSize > 0) {
+      putBlock(out, old, target, 0, 0, 0, newSize, 0);
+    }
+    return out;
+  }
+  std::vector<int32_t> suffixes = suffixArray(old);
+  const uint8_t* next = target.data();
+
+  int32_t scan = 0, length = 0, position = 0;
+  int32_t lastScan = 0, lastPosition = 0, lastOffset = 0;
+  while (scan < newSize) {
+    int32_t oldScore = 0;
+    int32_t scored = scan += length;
+    for (; scan < newSize; scan++) {
+      length = search(suffixes, old, next + scan, newSize - scan, 0, oldSize - 1, position);
+      for (; scored < scan + length; scored++) {
+        if (scored + lastOffset < oldSize && old[scored + lastOffset] == next[scored]) {
+          oldScore++;
+        }
+      }
+      if ((length == oldScore && length != 0) || length > oldScore + 8) {
+        break;
+      }
+      if (scan + lastOffset < oldSize && old[scan + lastOffset] == next[scan]) {
+        oldScore--;
+      }
+    }
+
+    if (length != oldScore || scan == newSize) {
+      // Extend the previous match forwards and this one backwards as long as mostly equal
+      int32_t score = 0, bestScore = 0, forward = 0;
+      for (int32_t i = 0; lastScan + i < scan && lastPosition + i < oldSize;) {
+        if (old[lastPosition + i] == next[lastScan + i]) {
+          score++;
+        }
+        i++;
+        if (score * 2 - i > bestScore * 2 - forward) {
+          bestScore = score;
+          forward = i;
+        }
+      }
+
+      int32_t backward = 0;
+      if (scan < newSize) {
+        score = 0;
+        bestScore = 0;
+        for (int32_t i = 1; scan >= lastScan + i && position >= i; i++) {
+          if (old[position - i] == next[scan - i]) {
+            score++;
+          }
+          if (score * 2 - i > bestScore * 2 - backward) {
+            bestScore = score;
+            backward = i;
+          }
+        }
+      }
+
+      if (lastScan + forward > scan - backward) {
+        int32_t overlap = (lastScan + forward) - (scan - backward);
+        score = 0;
+        bestScore = 0;
+        int32_t split = 0;
+        for (int32_t i = 0; i < overlap; i++) {
+          if (next[lastScan + forward - overlap + i] == old[lastPosition + forward - overlap + i]) {
+            score++;
+          }
+          if (next[scan - backward + i] == old[position - backward + i]) {
+            score--;
+          }
+          if (score > bestScore) {
+            bestScore = score;
+            split = i + 1;
+          }
+        }
+        forward += split - overlap;
+        backward -= split;
+      }
+
+      putBlock(out, old, target, lastPosition, lastScan, forward, (scan - backward) - (lastScan + forward),
+               (position - backward) - (lastPosition + forward));
+      lastScan = scan - backward;
+      lastPosition = position - backward;
+      lastOffset = position - scan;
+    }
+  }
+  return out;
+}
+
+class FileSource : public DeltaSource {
+ public:
+  explicit FileSource(const Bytes& image) : image(image) {}
+  bool read(uint32_t offset, uint8_t* data, size_t length) override {
+    if (offset + length > image.size()) {
+      return false;
+    }
+    memcpy(data, image.data() + offset, length);
+    reads++;
+    return true;
+  }
+  const Bytes& image;
+  uint32_t reads = 0;
+};
+
+class FileTarget : public DeltaTarget {
+ public:
+  bool open(uint32_t size) override {
+    image.clear();
+    image.reserve(size);
+    return true;
+  }
+  bool write(const uint8_t* data, size_t length) override {
+    image.insert(image.end(), data, data + length);
+    writes++;
+    return true;
+  }
+  Bytes image;
+  uint32_t writes = 0;
+};
+
+static DeltaStatus apply(DeltaPatcher& patcher, FileSource& source, FileTarget& target, const Bytes& patch) {
+  patcher.begin(source, target);
+  for (size_t offset = 0; offset < patch.size(); offset += CHUNK_SIZE) {
+    size_t length = std::min((size_t)CHUNK_SIZE, patch.size() - offset);
+    DeltaStatus status = patcher.write(patch.data() + offset, length);
+    if (status != DELTA_MORE && status != DELTA_DONE) {
+      return status;
+    }
+  }
+  return patcher.finish();
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point started) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+static DeltaPatcher patcher;  // 1.6 KB of buffers, as on the device
+
+int main(int argc, char** argv) {
+  if (argc >= 5 && strcmp(argv[1], "diff") == 0) {
+    Bytes old, target;
+    if (!readFile(argv[2], old) || !readFile(argv[3], target)) {
+      return 1;
+    }
+    auto started = std::chrono::steady_clock::now();
+    Bytes patch = diff(old, target);
+    printf("%zu -> %zu bytes: patch %zu bytes (%.1f%% of the image) in %.2f s\n", old.size(), target.size(),
+           patch.size(), 100.0 * patch.size() / std::max<size_t>(target.size(), 1), secondsSince(started));
+    return writeFile(argv[4], patch) ? 0 : 1;
+  }
+
+  if (argc >= 5 && strcmp(argv[1], "apply") == 0) {
+    Bytes old, patch;
+    if (!readFile(argv[2], old) || !readFile(argv[3], patch)) {
+      return 1;
+    }
+    FileSource source(old);
+    FileTarget target;
+    DeltaStatus status = apply(patcher, source, target, patch);
+    if (status != DELTA_DONE) {
+      fprintf(stderr, "%s after %u of %zu patch bytes\n", deltaStatusName(status), patcher.patchBytes(),
+              patch.size());
+      return 1;
+    }
+    printf("%u bytes written in %u writes, %u source reads\n", patcher.written(), target.writes, source.reads);
+    return writeFile(argv[4], target.image) ? 0 : 1;
+  }
+
+  if (argc >= 4 && strcmp(argv[1], "bench") == 0) {
+    Bytes old, patch;
+    if (!readFile(argv[2], old) || !readFile(argv[3], patch)) {
+      return 1;
+    }
+    int rounds = argc >= 5 ? atoi(argv[4]) : 20;
+    FileSource source(old);
+    FileTarget target;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      if (apply(patcher, source, target, patch) != DELTA_DONE) {
+        fprintf(stderr, "%s\n", deltaStatusName(patcher.status()));
+        return 1;
+      }
+    }
+    double seconds = secondsSince(started) / rounds;
+    printf("%.2f ms per apply (%.1f MB/s of target, source CRC included), %u source reads, %u writes\n",
+           seconds * 1000, patcher.written() / seconds / 1e6, source.reads / rounds, target.writes / rounds);
+    return 0;
+  }
+
+  fprintf(stderr, "usage: %s diff <old> <new> <patch> | apply <old> <patch> <new> | bench <old> <patch> [rounds]\n",
+          argv[0]);
+  return 2;
+}
@@ -0,0 +1,74 @@
+/*
+ * Battery life of the deep sleep duty cycle, on a simulated clock.
+ *
+ *   g++ -O2 -std=gnu++17 -Isrc tools/energy_sim.cpp src/energy_model.cpp -o energy_sim
+ *   energy_sim [capacity mAh]
+ *
+ * Walks one day of timer wakes the way runDeepSleepCycle() spends them
+ * (heater warm-up, one reading, WiFi every flushEvery wakes, sleep for the
+ * rest of the period) and feeds the phase times to the same EnergyMeter
+ * the firmware keeps in RTC memory. Phase durations are nominal; replace
+ * them with the ones a real device prints on its wakes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "energy_model.h"
+
+#define DAY_MS 86400000ULL
+#define MIN_SLEEP_MS 1000     // A wake that overruns its period still sleeps this long
+#define DEFAULT_CAPACITY_MAH 2000
+
+struct Schedule {
+  const char* name;
+  uint32_t periodMs;
+  uint32_t flushEvery;  // Wakes per WiFi upload
+  uint32_t sampleMs;
+  uint32_t heaterMs;    // 0 unless MQ135_HEATER_PIN switches the heater
+  uint32_t connectMs;
+  uint32_t uploadMs;
+};
+
+static const Schedule SCHEDULES[] = {
+  { "60 s, WiFi every 15", 60000, 15, 300, 0, 2500, 400 },
+  { "60 s, 20 s heater", 60000, 15, 300, 20000, 2500, 400 },
+  { "300 s, WiFi every 6", 300000, 6, 300, 0, 2500, 400 },
+  { "5 s, WiFi every wake", 5000, 1, 300, 0, 2500, 400 },
+};
+
+static void simulateDay(const Schedule& schedule, EnergyMeter& meter) {
+  memset(&meter, 0, sizeof(meter));
+  uint64_t nowMs = 0;
+  for (uint32_t wake = 1; nowMs < DAY_MS; wake++) {
+    uint32_t awakeMs = schedule.heaterMs + schedule.sampleMs;
+    meter.add(POWER_HEATER, schedule.heaterMs);
+    meter.add(POWER_SAMPLE, schedule.sampleMs);
+    meter.countReading();
+
+    if (wake % schedule.flushEvery == 0) {
+      meter.add(POWER_WIFI_CONNECT, schedule.connectMs);
+      meter.add(POWER_UPLOAD, schedule.uploadMs);
+      awakeMs += schedule.connectMs + schedule.uploadMs;
+    }
+
+    uint32_t sleepMs = awakeMs + MIN_SLEEP_MS < schedule.periodMs ? schedule.periodMs - awakeMs : MIN_SLEEP_MS;
+    meter.add(POWER_SLEEP, sleepMs);
+    nowMs += awakeMs + sleepMs;
+  }
+}
+
+int main(int argc, char** argv) {
+  float capacityMah = argc > 1 ? atof(argv[1]) : DEFAULT_CAPACITY_MAH;
+
+  printf("%-22s %10s %12s %10s %10s\n", "schedule", "rdg/day", "mJ/reading", "avg mA", "days");
+  for (const Schedule& schedule : SCHEDULES) {
+    EnergyMeter meter;
+    simulateDay(schedule, meter);
+    printf("%-22s %10u %12.1f %10.3f %10.1f\n", schedule.name, meter.readings,
+           meter.millijoulesPerReading(ESP32_WROOM_PROFILE),
+           meter.averageCurrentMa(ESP32_WROOM_PROFILE),
+           meter.batteryDays(ESP32_WROOM_PROFILE, capacityMah));
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * Storage room traces for the host tools: one reading per step with the
+ * seven channels of a Reading.
+ *
+ * The synthetic day is a stable room (24 °C and 60 % with a daily swing
+ * and DHT11 rounding, gases flat with 1-1.5 % sensor noise) that starts to
+ * spoil at 16:00: ethylene doubles every 20 minutes, ammonia every 30
+ * from 16:30, and at 20:00 a CO2 spike of +1080 ppm decays over half an
+ * hour. Seeded, so every run sees the same numbers.
+ *
+ * A recorded trace is a CSV file with the same columns:
+ *   second,temperature,humidity,CO2,ammonia,methane,ethylene,H2S
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+
+#define TRACE_CHANNELS 7
+#define TRACE_DAY_S 86400
+#define TRACE_ETHYLENE_ONSET_S (16 * 3600)
+#define TRACE_AMMONIA_ONSET_S (16 * 3600 + 1800)
+#define TRACE_CO2_SPIKE_S (20 * 3600)
+
+struct TraceRow {
+  uint32_t second;
+  float values[TRACE_CHANNELS];  // temperature, humidity, CO2, ammonia, methane, ethylene, H2S
+};
+
+static const char* const TRACE_CHANNEL_NAMES[TRACE_CHANNELS] = {
+  "temperature", "humidity", "CO2", "ammonia", "methane", "ethylene", "H2S"
+};
+
+/* The synthetic day, one row every stepS seconds */
+inline std::vector<TraceRow> syntheticRoomTrace(uint32_t stepS, uint32_t seed = 3) {
+  std::mt19937 random(seed);
+  std::normal_distribution<double> gauss(0.0, 1.0);
+  std::vector<TraceRow> rows;
+
+  for (uint32_t t = 0; t < TRACE_DAY_S; t += stepS) {
+    double day = 2 * M_PI * t / TRACE_DAY_S;
+    double ethylene = t < TRACE_ETHYLENE_ONSET_S
+        ? 2.0 : fmin(200.0, 2.0 * pow(2.0, (t - TRACE_ETHYLENE_ONSET_S) / 1200.0));
+    double ammonia = t < TRACE_AMMONIA_ONSET_S
+        ? 5.0 : fmin(80.0, 5.0 * pow(2.0, (t - TRACE_AMMONIA_ONSET_S) / 1800.0));
+    double co2 = 420.0;
+    if (t >= TRACE_CO2_SPIKE_S) {
+      double since = t - TRACE_CO2_SPIKE_S;
+      co2 += 1080.0 * fmin(1.0, since / 120.0) * exp(-fmax(0.0, since - 120.0) / 1800.0);
+    }
+
+    TraceRow row;
+    row.second = t;
+    row.values[0] = (float)round(24.0 + 2.0 * sin(day) + 0.3 * gauss(random));  // DHT11: whole degrees
+    row.values[1] = (float)round(60.0 + 5.0 * sin(day + 1.0) + 0.4 * gauss(random));
+    row.values[2] = (float)(co2 * (1.0 + 0.01 * gauss(random)));
+    row.values[3] = (float)(ammonia * (1.0 + 0.015 * gauss(random)));
+    row.values[4] = (float)(3.0 * (1.0 + 0.01 * gauss(random)));
+    row.values[5] = (float)(ethylene * (1.0 + 0.015 * gauss(random)));
+    row.values[6] = (float)(0.5 * (1.0 + 0.01 * gauss(random)));
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+/* A recorded trace, rows whose second is not a multiple of stepS are left out; empty if unreadable */
+inline std::vector<TraceRow> loadRoomTrace(const char* path, uint32_t stepS) {
+  std::vector<TraceRow> rows;
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    perror(path);
+    return rows;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    TraceRow row;
+    float* v = row.values;
+    if (sscanf(line, "%u,%f,%f,%f,%f,%f,%f,%f", &row.second, v, v + 1, v + 2, v + 3, v + 4, v + 5, v + 6) == 8 &&
+        row.second % stepS == 0) {
+      rows.push_back(row);
+    }
+  }
+  fclose(file);
+  return rows;
+}
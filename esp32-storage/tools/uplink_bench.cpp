@@ -0,0 +1,169 @@
+/*
+ * Bytes and CPU time per reading of the uplink encodings.
+ *
+ *   g++ -O2 -std=gnu++17 -Isrc -Ilib/series_codec/src -I.pio/libdeps/esp32dev/ArduinoJson/src \
+ *       tools/uplink_bench.cpp lib/series_codec/src/series_codec.cpp -o uplink_bench
+ *   uplink_bench [trace.csv]
+ *
+ * Batches are built the way sendBatchToBackend() builds them, from the
+ * synthetic room day of room_trace.h or a recorded trace at 5 s: JSON and
+ * MessagePack from a JsonDocument over the same ArenaAllocator (device
+ * fields once, then seq, ts, status and the seven channels per reading),
+ * the series encoding lossless and with the gas channels cut to
+ * SERIES_GAS_MANTISSA_BITS like the firmware does. Encode is document
+ * build plus serialization, decode is parsing the batch back into
+ * readings, both per reading on this machine.
+ */
+
+// Same pool layout as the ESP32 build, so the arena sees the device's allocation sizes
+#define ARDUINOJSON_SLOT_ID_SIZE 2
+#define ARDUINOJSON_POOL_CAPACITY 64
+
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <chrono>
+#include "arena_allocator.h"
+#include "room_trace.h"
+#include "series_codec.h"
+
+#define PAYLOAD_MAX 8192
+#define JSON_ARENA_SIZE 12288
+#define SAMPLE_STEP_S 5
+#define SERIES_GAS_MANTISSA_BITS 16  // As in main.cpp
+#define TRACE_START_MS 1760000000000ULL
+#define ROUNDS 20
+
+static ArenaAllocator<JSON_ARENA_SIZE> arena;
+static uint8_t payload[PAYLOAD_MAX];
+
+enum Encoding { ENCODING_JSON, ENCODING_MSGPACK, ENCODING_SERIES, ENCODING_SERIES_GAS16, ENCODINGS };
+
+static const char* const ENCODING_NAMES[ENCODINGS] = { "JSON", "MsgPack", "series", "series16" };
+
+static size_t encodeSeries(const TraceRow* rows, size_t count, Encoding encoding) {
+  SeriesEncoder encoder;
+  encoder.begin(payload, PAYLOAD_MAX, SERIES_TIME_EPOCH, "507f1f77bcf86cd799439011", "ESP32_001");
+  if (encoding == ENCODING_SERIES_GAS16) {
+    for (uint8_t channel = 2; channel < SERIES_CHANNELS; channel++) {
+      encoder.setPrecision(channel, SERIES_GAS_MANTISSA_BITS);
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    SeriesRow row = {};
+    row.timeMs = TRACE_START_MS + rows[i].second * 1000ULL;
+    row.sequence = rows[i].second / SAMPLE_STEP_S;
+    row.status = 1;
+    for (int channel = 0; channel < TRACE_CHANNELS; channel++) {
+      row.values[channel] = rows[i].values[channel];
+    }
+    encoder.add(row);
+  }
+  return encoder.finish();
+}
+
+static size_t encodeBatch(const TraceRow* rows, size_t count, Encoding encoding) {
+  if (encoding >= ENCODING_SERIES) {
+    return encodeSeries(rows, count, encoding);
+  }
+
+  arena.reset();
+  JsonDocument doc(&arena);
+  doc["farmerId"] = "507f1f77bcf86cd799439011";
+  doc["deviceId"] = "ESP32_001";
+  JsonArray items = doc["readings"].to<JsonArray>();
+  for (size_t i = 0; i < count; i++) {
+    const TraceRow& row = rows[i];
+    JsonObject item = items.add<JsonObject>();
+    item["seq"] = row.second / SAMPLE_STEP_S;
+    item["ts"] = TRACE_START_MS + row.second * 1000ULL;
+    item["status"] = "normal";
+    for (int channel = 0; channel < TRACE_CHANNELS; channel++) {
+      item[TRACE_CHANNEL_NAMES[channel]] = row.values[channel];
+    }
+  }
+  if (doc.overflowed()) {
+    return 0;
+  }
+  return encoding == ENCODING_MSGPACK ? serializeMsgPack(doc, payload, PAYLOAD_MAX)
+                                      : serializeJson(doc, (char*)payload, PAYLOAD_MAX);
+}
+
+/* Parses a batch back, returns the sum of its CO2 values so the work cannot be optimized away */
+static float decodeBatch(const uint8_t* data, size_t length, Encoding encoding) {
+  float sum = 0;
+  if (encoding >= ENCODING_SERIES) {
+    SeriesDecoder decoder;
+    SeriesRow row;
+    decoder.begin(data, length);
+    while (decoder.next(row)) {
+      sum += row.values[2];
+    }
+    return sum;
+  }
+
+  arena.reset();
+  JsonDocument doc(&arena);
+  DeserializationError error = encoding == ENCODING_MSGPACK ? deserializeMsgPack(doc, data, length)
+                                                            : deserializeJson(doc, (const char*)data, length);
+  if (error) {
+    return NAN;
+  }
+  for (JsonObject item : doc["readings"].as<JsonArray>()) {
+    sum += item["CO2"].as<float>();
+  }
+  return sum;
+}
+
+int main(int argc, char** argv) {
+  std::vector<TraceRow> rows = argc > 1 ? loadRoomTrace(argv[1], SAMPLE_STEP_S) : syntheticRoomTrace(SAMPLE_STEP_S);
+  if (rows.size() < 24) {
+    fprintf(stderr, "Trace too short\n");
+    return 1;
+  }
+  printf("%zu readings\n\n", rows.size());
+  printf("batch  encoding  bytes/reading  encode us/reading  decode us/reading\n");
+
+  std::vector<uint8_t> encoded;
+  std::vector<size_t> lengths;
+  for (size_t batch : { (size_t)1, (size_t)12, (size_t)24 }) {
+    for (int e = 0; e < ENCODINGS; e++) {
+      Encoding encoding = (Encoding)e;
+      size_t batches = rows.size() / batch;
+      size_t readings = batches * batch;
+      encoded.clear();
+      lengths.clear();
+
+      auto started = std::chrono::steady_clock::now();
+      for (int round = 0; round < ROUNDS; round++) {
+        for (size_t b = 0; b < batches; b++) {
+          size_t length = encodeBatch(&rows[b * batch], batch, encoding);
+          if (length == 0) {
+            fprintf(stderr, "Batch of %zu does not fit\n", batch);
+            return 1;
+          }
+          if (round == 0) {
+            encoded.insert(encoded.end(), payload, payload + length);
+            lengths.push_back(length);
+          }
+        }
+      }
+      double encodeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+      volatile float sink = 0;
+      started = std::chrono::steady_clock::now();
+      for (int round = 0; round < ROUNDS; round++) {
+        size_t offset = 0;
+        for (size_t length : lengths) {
+          sink = sink + decodeBatch(&encoded[offset], length, encoding);
+          offset += length;
+        }
+      }
+      double decodeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+      printf("%5zu  %-8s  %13.1f  %17.2f  %17.2f\n", batch, ENCODING_NAMES[encoding],
+             (double)encoded.size() / readings, encodeS * 1e6 / (readings * ROUNDS),
+             decodeS * 1e6 / (readings * ROUNDS));
+    }
+  }
+  return 0;
+}